@@ -4,6 +4,9 @@
 #include "BrickGridComponent.h"
 #include "BrickCollisionComponent.generated.h"
 
+// The collision boxes built for a chunk by a worker thread.
+struct FBrickCollisionBuild;
+
 /** Represents collision for a chunk of a BrickGridComponent. */
 UCLASS(hidecategories=(Object,LOD,Physics), editinlinenew, ClassGroup=Collision)
 class BRICKGRID_API UBrickCollisionComponent : public UPrimitiveComponent
@@ -29,12 +32,32 @@ public:
 	virtual class UBodySetup* GetBodySetup() override;
 	// End USceneComponent interface.
 
+	// Begin UObject interface.
+	virtual void BeginDestroy() override;
+	// End UObject interface.
+
+	// Swaps in the collision boxes built by the last collision body update, if the worker thread has finished building them.
+	// The grid calls this every update, and the previous collision body stays in use until then.
+	void FinishCollisionBodyUpdate();
+
 private:
 
 	// Collision body.
 	UPROPERTY(transient, duplicatetransient)
 	class UBodySetup* CollisionBodySetup;
 
-	// Initializes the collision body.
+	// The collision boxes being built by a worker thread, and the event that is triggered when they're done.
+	// Only one build is in flight at a time, so the event is the only one BeginDestroy needs to wait for.
+	TSharedPtr<FBrickCollisionBuild,ESPMode::ThreadSafe> PendingBuild;
+	FGraphEventRef PendingBuildEvent;
+
+	// Whether the body was invalidated while a build was in flight. FinishCollisionBodyUpdate starts another build once the pending one is applied.
+	bool HasPendingRebuild;
+
+	// Starts building the collision body's boxes on a worker thread. The first time the body is built, it waits for them, since there is no previous body to use.
+	// If a build is already in flight, the update is deferred until it finishes.
 	void UpdateCollisionBody();
+
+	// Replaces the collision body's boxes with a finished build, and recreates the physics state.
+	void ApplyCollisionBuild(FBrickCollisionBuild& Build);
 };
@@ -1,11 +1,13 @@
 // Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
 
 #pragma once
+#include "BrickMesher.h"
+#include "BrickGridScheduler.h"
 #include "BrickGridComponent.generated.h"
 
 namespace BrickGridConstants
 {
-	enum { MaxBricksPerRegionAxisLog2 = 7 };
+	enum { MaxBricksPerRegionAxisLog2 = 8 };
 	enum { MaxBricksPerRegionAxis = 1 << MaxBricksPerRegionAxisLog2 };
 };
 
@@ -38,7 +40,11 @@ struct FBrickMaterial
 	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = Bricks)
 	class UMaterialInterface* OverrideTopSurfaceMaterial;
 
-	FBrickMaterial() : SurfaceMaterial(NULL), OverrideTopSurfaceMaterial(NULL) {}
+	// The level of block light emitted by bricks of this material, from 0 to 15. Only used if the grid's EnableLightPropagation is set.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = Bricks,meta=(ClampMin=0,ClampMax=15))
+	int32 LightEmission;
+
+	FBrickMaterial() : SurfaceMaterial(NULL), OverrideTopSurfaceMaterial(NULL), LightEmission(0) {}
 };
 
 /** Information about a brick. */
@@ -77,6 +83,8 @@ struct FInt3
 
 	operator FIntVector() const { return FIntVector(X,Y,Z); }
 	FVector ToFloat() const { return FVector(X,Y,Z); }
+	int32& operator[](int32 Axis) { return (&X)[Axis]; }
+	int32 operator[](int32 Axis) const { return (&X)[Axis]; }
 	int32 SumComponents() const { return X + Y + Z; }
 
 	friend uint32 GetTypeHash(const FInt3& Coordinates)
@@ -160,7 +168,35 @@ struct FBrickRegion
 	TArray<uint8> BrickContents;
 
 	// Contains the occupied brick with highest Z in this region for each XY coordinate in the region. -1 means no non-empty bricks in this region at that XY.
-	TArray<int8> MaxNonEmptyBrickRegionZs;
+	TArray<int16> MaxNonEmptyBrickRegionZs;
+
+	// The number of non-empty and opaque bricks in each render chunk of this region, indexed by (Y * ChunksX + X) * ChunksZ + Z.
+	TArray<uint32> RenderChunkNonEmptyBrickCounts;
+	TArray<uint32> RenderChunkOpaqueBrickCounts;
+
+	// The fraction of the columns within the ambient occlusion blur radius of each brick whose highest non-empty brick is below it, scaled to 0-255.
+	// Indexed the same as BrickContents, and updated in the columns around each edit so render chunks can sample it instead of computing it.
+	TArray<uint8> BlurredSkyVisibility;
+
+	// The propagated light of each brick, indexed the same as BrickContents: sky light in the low 4 bits, and block light in the high 4 bits.
+	// Only maintained if the grid's EnableLightPropagation is set.
+	TArray<uint8> Light;
+
+	// Whether Light has been computed for this region. Regions without valid light block light propagation.
+	bool IsLightValid;
+
+	FBrickRegion() : IsLightValid(false) {}
+};
+
+/** Classifies a box of render chunks by whether meshing it could produce any faces. */
+enum class EBrickChunkSummary : uint8
+{
+	// All bricks are empty.
+	Empty,
+	// All bricks, and all bricks adjacent to them, are opaque.
+	Buried,
+	// Anything else.
+	Mixed
 };
 
 /** The parameters for a BrickGridComponent. */
@@ -197,10 +233,55 @@ struct FBrickGridParameters
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Regions)
 	FInt3 MaxRegionCoordinates;
 
+	// The number of reduced resolution levels of detail that distant render chunks may use. Each level halves the resolution of the previous level.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	int32 MaxRenderChunkLOD;
+
+	// The distance in bricks from the viewer beyond which render chunks use LOD 1. Each subsequent LOD starts at twice the distance of the previous one.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	float RenderChunkLODDistance;
+
+	// How far in bricks past an LOD distance a render chunk must be to switch to the coarser LOD, or within it to switch back to the finer LOD.
+	// This keeps a viewer near an LOD distance from remeshing the chunks there every update.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	float RenderChunkLODHysteresis;
+
+	// The number of render chunks along each axis of a super chunk is 2^RenderChunksPerSuperChunkLog2
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	FInt3 RenderChunksPerSuperChunkLog2;
+
+	// The distance in bricks from the viewer beyond which render chunks are merged into super chunks, which draw all their chunks with a single mesh.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	float SuperChunkDistance;
+
+	// Whether render chunks keep a CPU copy of their vertices after uploading them to the GPU.
+	// This costs memory, but lets ambient occlusion changes update a chunk's vertex colors instead of rebuilding it.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	bool KeepRenderChunkVertices;
+
+	// Whether to cull render chunks that can't be seen from the viewer's chunk through a path of connected non-opaque bricks.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Chunks)
+	bool EnableCaveCulling;
+
 	// The radius in bricks of the blur applied to the ambient occlusion.
 	UPROPERTY(EditAnywhere,BlueprintReadOnly,Category=Lighting)
 	int32 AmbientOcclusionBlurRadius;
 
+	// Whether to propagate sky light and the light emitted by bricks through the grid, and use it to shade the chunks instead of the height map ambient occlusion.
+	// Costs a byte of memory per brick, and makes editing bricks slower.
+	UPROPERTY(EditAnywhere,BlueprintReadOnly,Category=Lighting)
+	bool EnableLightPropagation;
+
+	// Whether the grid is only used for gameplay, so it only creates collision chunks, and skips the render chunks, ambient occlusion, and light.
+	// Always set on dedicated servers.
+	UPROPERTY(EditAnywhere,BlueprintReadOnly,Category=Chunks)
+	bool Headless;
+
+	// How many seconds ahead to predict each viewer's movement from its recent velocity. Regions and collision chunks along the predicted path are
+	// created ahead of the viewer, with the ones it will reach first initialized first. 0 only creates them around the viewer's current position.
+	UPROPERTY(EditAnywhere,BlueprintReadOnly,Category=Regions)
+	float PrefetchLookAheadTime;
+
 	FBrickGridParameters();
 };
 
@@ -218,6 +299,60 @@ struct FBrickGridData
 // The type of OnInitRegion delegates.
 DECLARE_DYNAMIC_DELEGATE_OneParam(FBrickGrid_InitRegion,FInt3,RegionCoordinates);
 
+/** A viewer that the grid initializes regions and creates collision chunks around. */
+struct FBrickGridViewer
+{
+	// The viewer's position in the grid's local space, and how far from it regions and collision chunks are needed, in bricks.
+	FVector LocalPosition;
+	float LocalMaxRegionDistance;
+	float LocalMaxCollisionDistance;
+
+	// The viewer's share of the time spent initializing regions, relative to the other viewers.
+	float Priority;
+
+	// The viewer's smoothed velocity in bricks per second, estimated from its movement, and the time it was last moved. LastMoveTime is negative until it has moved.
+	FVector LocalVelocity;
+	double LastMoveTime;
+
+	// The current and predicted positions the viewer's interest was computed for. It includes everything needed within a slack distance of the path between them,
+	// so it only needs to be recomputed when either position moves further than that.
+	FVector InterestPosition;
+	FVector InterestPredictedPosition;
+	bool IsInterestValid;
+
+	// The collision chunks the viewer needs, and the regions it needs that haven't been initialized yet, sorted from farthest to nearest.
+	TArray<FInt3> InterestCollisionChunks;
+	TArray<FInt3> PendingRegions;
+
+	// The time spent initializing regions for the viewer divided by its priority. The viewer with the least is served first.
+	double WeightedInitTime;
+
+	FBrickGridViewer()
+	: LocalPosition(FVector::ZeroVector)
+	, LocalMaxRegionDistance(0.0f)
+	, LocalMaxCollisionDistance(0.0f)
+	, Priority(1.0f)
+	, LocalVelocity(FVector::ZeroVector)
+	, LastMoveTime(-1.0)
+	, InterestPosition(FVector::ZeroVector)
+	, InterestPredictedPosition(FVector::ZeroVector)
+	, IsInterestValid(false)
+	, WeightedInitTime(0.0)
+	{}
+};
+
+/** The bricks adjacent to one side of a render chunk that are drawn by a lower resolution render chunk or super chunk. */
+struct FBrickRenderSeam
+{
+	// The side of the chunk, and the box of adjacent bricks drawn by the neighbor.
+	uint32 FaceIndex;
+	FInt3 MinBrickCoordinates;
+	FInt3 MaxBrickCoordinates;
+
+	// The neighbor's LOD.
+	int32 LOD;
+};
+
 /** A 3D grid of bricks. */
 UCLASS(hidecategories=(Object,LOD, Physics), editinlinenew, meta=(BlueprintSpawnableComponent), ClassGroup=Rendering)
 class BRICKGRID_API UBrickGridComponent : public USceneComponent
@@ -245,23 +380,73 @@ public:
 	void GetBrickMaterialArray(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,TArray<uint8>& OutBrickMaterials) const;
 	void SetBrickMaterialArray(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,const TArray<uint8>& BrickMaterials);
 
+	// Sets every brick in a region to the same material. Returns false if the region doesn't exist.
+	bool FillRegion(const FInt3& RegionCoordinates,uint8 MaterialIndex);
+
 	// Returns a height-map containing the non-empty brick with greatest Z for each XY in the rectangle bounded by MinBrickCoordinates.XY-MaxBrickCoordinates.XY.
 	// The returned heights are relative to MinBrickCoordinates.Z, but MaxBrickCoordinates.Z is ignored.
-	// OutHeightmap should be allocated by the caller to contain an int8 for each XY in the rectangle, and is indexed by OutHeightMap[Y * SizeX + X].
-	void GetMaxNonEmptyBrickZ(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,TArray<int8>& OutHeightMap) const;
+	// OutHeightmap should be allocated by the caller to contain an int16 for each XY in the rectangle, and is indexed by OutHeightMap[Y * SizeX + X].
+	void GetMaxNonEmptyBrickZ(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,TArray<int16>& OutHeightMap) const;
 
 	// Writes the brick at the given coordinates.
 	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
 	bool SetBrick(const FInt3& BrickCoordinates,int32 MaterialIndex);
 
+	// Returns whether any brick overlapping a world space box is solid: non-empty, or outside the grid other than above it.
+	// Bricks in regions that haven't been created are also solid, so pawns don't fall through the grid before it is initialized around them.
+	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
+	bool OverlapBox(const FBox& WorldBox) const;
+
+	// Moves a world space box by a delta, one axis at a time in the order Z, X, Y, and stops it against solid bricks. This only reads the bricks,
+	// so it doesn't need the collision chunks' physics bodies. The grid must not be rotated.
+	// Returns the delta the box could move. OutHitNormal has a component for each axis the box was stopped along, or is zero if it wasn't stopped.
+	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
+	FVector SweepBox(const FBox& WorldBox,const FVector& WorldDelta,FVector& OutHitNormal) const;
+
 	// Invalidates the chunk components for a range of brick coordinates.
 	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
 	void InvalidateChunkComponents(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates);
 
-	// Updates the visible chunks for a given view position.
+	// Returns the lowest LOD of the render chunks and super chunks drawing any of the given bricks, or DefaultLOD if none of them are drawn.
+	int32 GetMinRenderLOD(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,int32 DefaultLOD) const;
+
+	// Finds the bricks adjacent to a render chunk or super chunk that are drawn by neighbors with a higher LOD.
+	void GetLowerResolutionSeams(const class UBrickRenderComponent* RenderComponent,TArray<FBrickRenderSeam>& OutSeams) const;
+
+	// Reads the blurred sky visibility of a box of bricks into an array indexed by (Y * SizeX + X) * SizeZ + Z, where Size = Max - Min + 1.
+	// Returns false if some of the bricks are in a region that hasn't been created.
+	bool GetBlurredSkyVisibility(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,TArray<uint8>& OutBlurredSkyVisibility) const;
+
+	// Reads the propagated light of a box of bricks into an array indexed by (Y * SizeX + X) * SizeZ + Z, where Size = Max - Min + 1.
+	// Bricks in regions without valid light are fully sky lit, unless they are below the grid.
+	void GetBrickLightArray(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates,TArray<uint8>& OutBrickLight) const;
+
+	// Computes the light of whole regions from scratch, processing the regions in parallel, then propagates it into their neighbors.
+	// Light that the regions previously propagated into their neighbors isn't removed, so this is only meant for regions whose light isn't valid yet,
+	// or for relighting every region at once.
+	void RelightRegions(const TArray<FInt3>& RegionCoordinates);
+
+	// Summarizes the bricks in a box of render chunks from the per-chunk brick counts, without reading the bricks.
+	EBrickChunkSummary GetRenderChunkSummary(const FInt3& MinRenderChunkCoordinates,const FInt3& MaxRenderChunkCoordinates) const;
+
+	// Updates the visible chunks for a given view position. Regions and collision chunks are also created around the registered viewers,
+	// and the time spent initializing regions is shared between the view position and the registered viewers in proportion to their priorities.
 	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
 	void Update(const FVector& WorldViewPosition,float MaxDrawDistance,float MaxCollisionDistance,float MaxDesiredUpdateTime,FBrickGrid_InitRegion InitRegion);
 
+	// Registers a viewer that Update should initialize regions and create collision chunks around, such as another player or an AI, and returns its ID.
+	// Only Update's view position creates render chunks, and only if the grid isn't headless. The view position passed to Update has a priority of 1.
+	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
+	int32 RegisterViewer(const FVector& WorldPosition,float MaxRegionDistance,float MaxCollisionDistance,float Priority = 1.0f);
+
+	// Moves a registered viewer.
+	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
+	void UpdateViewer(int32 ViewerId,const FVector& WorldPosition);
+
+	// Unregisters a viewer, and destroys the collision chunks that only it needed.
+	UFUNCTION(BlueprintCallable,Category = "Brick Grid")
+	void UnregisterViewer(int32 ViewerId);
+
 	// The parameters for the grid.
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = "Brick Grid")
 	FBrickGridParameters Parameters;
@@ -287,6 +472,12 @@ public:
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = "Brick Grid")
 	FInt3 MaxBrickCoordinates;
 
+	// The mesher's classification of each material, derived from its surface material's blend mode.
+	TArray<EBrickClass> BrickClassByMaterial;
+
+	// Admits the work Update starts to its time budget, and measures the cost of the work the chunks do on worker threads.
+	FBrickGridWorkScheduler WorkScheduler;
+
 	inline FInt3 BrickToRenderChunkCoordinates(const FInt3& BrickCoordinates) const
 	{
 		return FInt3::SignedShiftRight(BrickCoordinates,BricksPerRenderChunkLog2);
@@ -315,8 +506,22 @@ private:
 	// Transient maps to help lookup regions and chunks by coordinates.
 	TMap<FInt3,int32> RegionCoordinatesToIndex;
 	TMap<FInt3,class UBrickRenderComponent*> RenderChunkCoordinatesToComponent;
+	TMap<FInt3,class UBrickRenderComponent*> SuperChunkCoordinatesToComponent;
+
 	TMap<FInt3,class UBrickCollisionComponent*> CollisionChunkCoordinatesToComponent;
 
+	// The viewers that regions and collision chunks are created around, including the one for Update's view position.
+	TMap<int32,FBrickGridViewer> Viewers;
+	int32 NextViewerId;
+	int32 UpdateViewerId;
+
+	// The number of viewers that need each collision chunk. A collision chunk exists while any viewer needs it.
+	TMap<FInt3,int32> CollisionChunkInterestCounts;
+
+	// Guards the regions against being changed by the game thread while render chunk tasks are reading them.
+	// The game thread is the only writer, so it only locks it around the writes themselves, and never while invalidating components or relighting.
+	mutable FCriticalSection RegionsCriticalSection;
+
 	// Initializes the derived constants from the properties they are derived from.
 	void ComputeDerivedConstants();
 
@@ -326,6 +531,57 @@ private:
 	// Creates a region for the given coordinates.
 	void CreateRegion(const FInt3& Coordinates,FBrickGrid_InitRegion OnInitRegion);
 
+	// The distance a viewer may move before its interest is recomputed.
+	inline float GetViewerInterestSlack() const
+	{
+		return BricksPerCollisionChunk.ToFloat().GetMin();
+	}
+
+	// Moves a viewer, and invalidates its interest if its distances changed.
+	void MoveViewer(FBrickGridViewer& Viewer,const FVector& WorldPosition,float MaxRegionDistance,float MaxCollisionDistance) const;
+
+	// Moves a viewer to a new position, and updates its estimated velocity.
+	void SetViewerPosition(FBrickGridViewer& Viewer,const FVector& WorldPosition) const;
+
+	// Predicts where a viewer will be after the prefetch look-ahead time.
+	FVector GetViewerPredictedPosition(const FBrickGridViewer& Viewer) const;
+
+	// Recomputes the regions and collision chunks a viewer needs, and creates or destroys collision chunks that it's the first to need or the last to stop needing.
+	void UpdateViewerInterest(FBrickGridViewer& Viewer);
+
+	// Adds or removes a viewer's interest in a collision chunk.
+	void AddCollisionChunkInterest(const FInt3& ChunkCoordinates);
+	void RemoveCollisionChunkInterest(const FInt3& ChunkCoordinates);
+
+	// Initializes the regions the viewers need while the work scheduler admits them, serving the viewer with the least weighted initialization time first.
+	void InitViewerRegions(FBrickGrid_InitRegion OnInitRegion);
+
+	// Creates, destroys, and changes the LOD of render chunks and super chunks for the view position, and culls them.
+	void UpdateRenderChunks(const FVector& LocalViewPosition,float LocalMaxDrawDistance);
+
+	// Returns the LOD a render chunk should use at the given distance from the viewer, given its current LOD or INDEX_NONE for a new chunk.
+	int32 GetRenderChunkLODForDistance(float LocalDistance,int32 CurrentLOD) const;
+
+	// Culls the render chunks that can't be seen from the viewer's chunk, by walking the chunks' face connectivity outward from the viewer.
+	void UpdateCaveCulling(const FVector& LocalViewPosition,const FInt3& MinVisibleChunkCoordinates,const FInt3& MaxVisibleChunkCoordinates);
+
+	// Invalidates the neighbors of a render chunk or super chunk whose meshes depend on its LOD after it changed: the neighbors that seal
+	// or unseal their sides facing it, and the higher resolution neighbors that mesh their sides against its downsampled bricks.
+	// PreviousLOD is INDEX_NONE if the component was just created.
+	void UpdateRenderChunkSeams(const class UBrickRenderComponent* RenderComponent,int32 PreviousLOD);
+
+	// Maps brick coordinates to the coordinates of the super chunk containing them.
+	FInt3 BrickToSuperChunkCoordinates(const FInt3& BrickCoordinates) const;
+
+	// Computes the 2D distance from the viewer to a super chunk.
+	float ComputeSuperChunkSquaredDistance(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition) const;
+
+	// Returns whether a super chunk is far enough from the viewer to merge its render chunks.
+	bool IsSuperChunkMerged(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition) const;
+
+	// Returns whether the render chunks that replace an unmerged super chunk within the draw distance have all been created and meshed.
+	bool AreSuperChunkRenderChunksBuilt(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition,float LocalMaxDrawDistance) const;
+
 	// Maps brick coordinates within a region to a brick index.
 	inline uint32 SubregionBrickCoordinatesToRegionBrickIndex(const FInt3 SubregionBrickCoordinates) const
 	{
@@ -337,6 +593,26 @@ private:
 		
 	}
 
+	// Returns whether any brick in a box is solid, as defined by OverlapBox.
+	bool IsAnyBrickSolid(const FInt3& MinBrickCoordinates,const FInt3& MaxBrickCoordinates) const;
+
+	// Transforms a world space box to an axis-aligned box in the grid's local space, where bricks are unit cubes.
+	FBox WorldToLocalBox(const FBox& WorldBox) const;
+
 	// Updates the non-empty height map for a single region.
 	void UpdateMaxNonEmptyBrickMap(FBrickRegion& Region,const FInt3 MinDirtyBrickCoordinates,const FInt3 MaxDirtyBrickCoordinates) const;
+
+	// Removes and repropagates the light affected by changing the bricks in a box.
+	void UpdateLight(const FInt3& MinDirtyBrickCoordinates,const FInt3& MaxDirtyBrickCoordinates);
+
+	// Flags the render chunks that include any of a box of bricks whose light changed for an ambient occlusion update.
+	void InvalidateLitChunkComponents(const FInt3& MinLitBrickCoordinates,const FInt3& MaxLitBrickCoordinates);
+
+	friend class FBrickLightEngine;
+
+	// Recomputes the blurred sky visibility of the bricks in a box from the non-empty height maps.
+	void UpdateBlurredSkyVisibility(const FInt3 MinDirtyBrickCoordinates,const FInt3 MaxDirtyBrickCoordinates);
+
+	// Recounts the non-empty and opaque bricks of the render chunks in a region that overlap a box of dirty bricks.
+	void UpdateRenderChunkBrickCounts(FBrickRegion& Region,const FInt3 MinDirtyRegionBrickCoordinates,const FInt3 MaxDirtyRegionBrickCoordinates) const;
 };
@@ -0,0 +1,48 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#pragma once
+#include "GameFramework/PawnMovementComponent.h"
+#include "BrickGridMovementComponent.generated.h"
+
+/**
+ * Moves a pawn by walking, jumping, and falling through a BrickGridComponent, colliding with the grid's bricks directly instead of its collision chunks.
+ * The updated component's bounding box is used as the pawn's shape, and the grid must not be rotated.
+ * Pawns that only move with this don't need the grid to create collision chunks around them, so the grid can be updated with a MaxCollisionDistance of 0.
+ */
+UCLASS(ClassGroup=Movement,meta=(BlueprintSpawnableComponent))
+class BRICKGRID_API UBrickGridMovementComponent : public UPawnMovementComponent
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	// The grid the pawn moves through.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = BrickGridMovement)
+	class UBrickGridComponent* Grid;
+
+	// The horizontal speed the pawn walks at with full input.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = BrickGridMovement)
+	float MaxWalkSpeed;
+
+	// The vertical speed the pawn jumps with when it has upward input while standing on the ground.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = BrickGridMovement)
+	float JumpZVelocity;
+
+	// The height of the tallest ledge the pawn will step onto while walking.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = BrickGridMovement)
+	float MaxStepHeight;
+
+	// Whether the pawn was standing on a solid brick at the end of its last move.
+	UPROPERTY(VisibleInstanceOnly,BlueprintReadOnly,Category = BrickGridMovement)
+	bool IsOnGround;
+
+	// UActorComponent interface.
+	virtual void TickComponent(float DeltaTime,enum ELevelTick TickType,FActorComponentTickFunction* ThisTickFunction) override;
+
+	// UMovementComponent interface.
+	virtual float GetMaxSpeed() const override { return MaxWalkSpeed; }
+
+	// UPawnMovementComponent interface.
+	virtual bool IsMovingOnGround() const override { return IsOnGround; }
+	virtual bool IsFalling() const override { return !IsOnGround; }
+};
@@ -4,6 +4,9 @@
 #include "BrickGridComponent.h"
 #include "BrickRenderComponent.generated.h"
 
+struct FBrickAmbientOcclusionUpdate;
+struct FBrickChunkMeshBuild;
+
 /** Represents rendering for a chunk of a BrickGridComponent. */
 UCLASS(hidecategories=(Object,LOD,Physics), editinlinenew, ClassGroup=Rendering)
 class BRICKGRID_API UBrickRenderComponent : public UPrimitiveComponent
@@ -20,10 +23,56 @@ public:
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = Chunk)
 	class UBrickGridComponent* Grid;
 
+	// The log2 of the number of render chunks along each axis that this component merges into a single mesh. Zero for a regular render chunk.
+	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = Chunk)
+	FInt3 MergedChunksLog2;
+
+	// The level of detail this chunk is meshed at. At LOD N, each meshed brick covers 2^N bricks along each axis.
+	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = Chunk)
+	int32 LOD;
+
 	// Whether this chunk has a low-priority update pending (e.g. ambient occlusion). These updates are spread over multiple frames.
 	UPROPERTY()
 	bool HasLowPriorityUpdatePending;
 
+	// Whether this component needs its geometry rebuilt, but the rebuild is deferred so that rebuilds of distant super chunks are spread over multiple frames.
+	UPROPERTY()
+	bool HasDeferredRebuildPending;
+
+	// Whether the grid's cave culling found that this chunk can't be seen from the viewer.
+	UPROPERTY(Transient)
+	bool IsCaveCulled;
+
+	// Whether a mesh build for this chunk has completed, so it can replace the render chunks or super chunk that drew its bricks before it was created.
+	UPROPERTY(Transient)
+	bool IsMeshBuilt;
+
+	// Which pairs of this chunk's faces are connected through non-opaque bricks, as a mask of BrickMesher::GetFacePairBit bits.
+	// Computed by the mesh build task, and applied by FinishMeshBuild. Until the chunk is meshed, all faces are assumed to be connected.
+	uint32 FaceConnectivity;
+
+	// Returns the number of bricks along each axis covered by this component.
+	FInt3 GetBricksDim() const;
+
+	// Returns the coordinates of the brick at the minimum corner of this component.
+	FInt3 GetMinBrickCoordinates() const;
+
+	// Applies the results of the chunk's mesh build task to the component if it has completed.
+	void FinishMeshBuild();
+
+	// Recomputes the ambient occlusion for the chunk's existing vertices on a worker thread, without rebuilding the chunk's geometry.
+	// FinishAmbientOcclusionUpdate uploads it once the task completes.
+	void UpdateAmbientOcclusion();
+
+	// Uploads the ambient occlusion computed by an UpdateAmbientOcclusion task if it has completed.
+	void FinishAmbientOcclusionUpdate();
+
+	// Whether an UpdateAmbientOcclusion task is still computing. Another update isn't started until it finishes.
+	bool IsAmbientOcclusionUpdateInFlight() const { return PendingAmbientOcclusionUpdateEvent.IsValid(); }
+
+	// Sets whether the chunk is culled by the grid's cave culling, and passes it on to the scene proxy.
+	void SetCaveCulled(bool InIsCaveCulled);
+
 	// Begin UPrimitiveComponent interface.
 	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
 	virtual void GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials,bool bGetDebugMaterials) const override;
@@ -32,4 +81,21 @@ public:
 	// Begin USceneComponent interface.
 	virtual FBoxSphereBounds CalcBounds(const FTransform & LocalToWorld) const override;
 	// End USceneComponent interface.
+
+	// Begin UObject interface.
+	virtual void BeginDestroy() override;
+	// End UObject interface.
+
+private:
+
+	// The results of the mesh build task for the current scene proxy, and the task's completion event.
+	TSharedPtr<FBrickChunkMeshBuild,ESPMode::ThreadSafe> PendingMeshBuild;
+	FGraphEventRef PendingMeshBuildEvent;
+
+	// The completion events of mesh build tasks for previous scene proxies that may still be running. BeginDestroy waits for them.
+	FGraphEventArray SupersededMeshBuildEvents;
+
+	// The ambient occlusion being computed by a worker task, and the task's completion event.
+	TSharedPtr<FBrickAmbientOcclusionUpdate,ESPMode::ThreadSafe> PendingAmbientOcclusionUpdate;
+	FGraphEventRef PendingAmbientOcclusionUpdateEvent;
 };
@@ -3,6 +3,7 @@
 #include "BrickGridPluginPrivatePCH.h"
 #include "BrickCollisionComponent.h"
 #include "BrickGridComponent.h"
+#include "BrickMesher.h"
 #include "PhysicsEngine/BodySetup.h"
 
 UBrickCollisionComponent::UBrickCollisionComponent( const FObjectInitializer& Initializer)
@@ -11,6 +12,7 @@ UBrickCollisionComponent::UBrickCollisionComponent( const FObjectInitializer& In
 	PrimaryComponentTick.bCanEverTick = false;
 	bVisible = true;
 	bAutoRegister = false;
+	HasPendingRebuild = false;
 	
 	SetCollisionProfileName(UCollisionProfile::BlockAllDynamic_ProfileName);
 }
@@ -40,76 +42,140 @@ class UBodySetup* UBrickCollisionComponent::GetBodySetup()
 	return CollisionBodySetup;
 }
 
+void UBrickCollisionComponent::BeginDestroy()
+{
+	Super::BeginDestroy();
+
+	// Don't let a worker thread read the grid after it's destroyed.
+	if(PendingBuildEvent.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(PendingBuildEvent);
+		PendingBuildEvent = NULL;
+	}
+	PendingBuild.Reset();
+	HasPendingRebuild = false;
+}
+
+struct FBrickCollisionBuild
+{
+	TArray<FKBoxElem> BoxElems;
+	uint32 NumSurfaceBricks;
+	float BuildMilliseconds;
+
+	FBrickCollisionBuild(): NumSurfaceBricks(0), BuildMilliseconds(0.0f) {}
+
+	// Builds the collision boxes for a collision chunk. Only reads the grid's bricks, so it may be called from any thread.
+	void Build(const UBrickGridComponent* Grid,const FInt3 Coordinates,const FVector NonUniformScale3D)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+
+		const FInt3 MinBrickCoordinates = Coordinates << Grid->BricksPerCollisionChunkLog2;
+		const FInt3 LocalBrickExpansion = FInt3::Scalar(1);
+		const FInt3 MinLocalBrickCoordinates = MinBrickCoordinates - LocalBrickExpansion;
+
+		// Read the brick materials for all the bricks that affect this chunk.
+		const FInt3 LocalBricksDim = Grid->BricksPerCollisionChunk + LocalBrickExpansion * FInt3::Scalar(2);
+		TArray<uint8> LocalBrickMaterials;
+		LocalBrickMaterials.SetNumUninitialized(LocalBricksDim.X * LocalBricksDim.Y * LocalBricksDim.Z);
+		Grid->GetBrickMaterialArray(MinLocalBrickCoordinates,MinLocalBrickCoordinates + LocalBricksDim - FInt3::Scalar(1),LocalBrickMaterials);
+
+		// Cover the non-empty bricks that are adjacent to an empty brick with as few boxes as possible.
+		BrickMesher::FCollisionBoxMerger BoxMerger;
+		std::vector<BrickMesher::FBrickBox> Boxes;
+		NumSurfaceBricks = BoxMerger.Merge(
+			LocalBrickMaterials.GetData(),
+			BrickMesher::FSize3(Grid->BricksPerCollisionChunk.X,Grid->BricksPerCollisionChunk.Y,Grid->BricksPerCollisionChunk.Z),
+			Grid->Parameters.EmptyMaterialIndex,
+			Boxes
+			);
+
+		BoxElems.Reset(Boxes.size());
+		for(const BrickMesher::FBrickBox& Box : Boxes)
+		{
+			const FVector BoxMin(Box.Min.X,Box.Min.Y,Box.Min.Z);
+			const FVector BoxMax(Box.Max.X,Box.Max.Y,Box.Max.Z);
+
+			// Set the box center and size.
+			FKBoxElem& BoxElement = *new(BoxElems) FKBoxElem;
+			BoxElement.Center = (BoxMin + BoxMax) * 0.5f * NonUniformScale3D;
+			BoxElement.X = (BoxMax.X - BoxMin.X) * NonUniformScale3D.X;
+			BoxElement.Y = (BoxMax.Y - BoxMin.Y) * NonUniformScale3D.Y;
+			BoxElement.Z = (BoxMax.Z - BoxMin.Z) * NonUniformScale3D.Z;
+		}
+
+		BuildMilliseconds = 1000.0f * float(FPlatformTime::Seconds() - StartTime);
+	}
+};
+
 void UBrickCollisionComponent::UpdateCollisionBody()
 {
-	const double StartTime = FPlatformTime::Seconds();
-	
+	// Physics bodies are uniformly scaled by the minimum component of the 3D scale.
+	// Compute the non-uniform scaling components to apply to the box center/extent.
+	const FVector AbsScale3D = ComponentToWorld.GetScale3D().GetAbs();
+	const FVector NonUniformScale3D = AbsScale3D / AbsScale3D.GetMin();
+
 	if (!CollisionBodySetup)
 	{
 		CollisionBodySetup = NewObject<UBodySetup>(this);
 		CollisionBodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
-	}
-
-	CollisionBodySetup->AggGeom.BoxElems.Reset();
 
-	const FInt3 MinBrickCoordinates = Coordinates << Grid->BricksPerCollisionChunkLog2;
-	const FInt3 MaxBrickCoordinates = MinBrickCoordinates + Grid->BricksPerCollisionChunk - FInt3::Scalar(1);
-	const FInt3 LocalBrickExpansion = FInt3::Scalar(1);
-	const FInt3 MinLocalBrickCoordinates = MinBrickCoordinates - LocalBrickExpansion;
-
-	// Read the brick materials for all the bricks that affect this chunk.
-	const FInt3 LocalBricksDim = Grid->BricksPerCollisionChunk + LocalBrickExpansion * FInt3::Scalar(2);
-	TArray<uint8> LocalBrickMaterials;
-	LocalBrickMaterials.SetNumUninitialized(LocalBricksDim.X * LocalBricksDim.Y * LocalBricksDim.Z);
-	Grid->GetBrickMaterialArray(MinLocalBrickCoordinates,MinLocalBrickCoordinates + LocalBricksDim - FInt3::Scalar(1),LocalBrickMaterials);
+		// There's no previous body to keep using while the boxes are built, so build them immediately.
+		FBrickCollisionBuild Build;
+		Build.Build(Grid,Coordinates,NonUniformScale3D);
+		ApplyCollisionBuild(Build);
+	}
+	else if(PendingBuildEvent.IsValid())
+	{
+		// The build in flight may not include the latest changes, so build the boxes again once it's applied.
+		HasPendingRebuild = true;
+	}
+	else
+	{
+		// Build the boxes on a worker thread, and keep using the current body until FinishCollisionBodyUpdate swaps them in.
+		const TSharedPtr<FBrickCollisionBuild,ESPMode::ThreadSafe> Build = MakeShareable(new FBrickCollisionBuild);
+		UBrickGridComponent* LocalGrid = Grid;
+		const FInt3 LocalCoordinates = Coordinates;
+		PendingBuild = Build;
+		Grid->WorkScheduler.BeginWorkerTask(EBrickGridWork::CollisionBuild);
+		PendingBuildEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([=]()
+		{
+			FBrickGridScopedWorkerTask ScopedWorkerTask(LocalGrid->WorkScheduler,EBrickGridWork::CollisionBuild);
+			Build->Build(LocalGrid,LocalCoordinates,NonUniformScale3D);
+		},
+		TStatId(),NULL);
+	}
+}
 
-	// Iterate over each brick in the chunk.
-	const int32 EmptyMaterialIndex = Grid->Parameters.EmptyMaterialIndex;
-	for(int32 Y = MinBrickCoordinates.Y; Y <= MaxBrickCoordinates.Y; ++Y)
+void UBrickCollisionComponent::FinishCollisionBodyUpdate()
+{
+	if(PendingBuildEvent.IsValid() && PendingBuildEvent->IsComplete())
 	{
-		for(int32 X = MinBrickCoordinates.X; X <= MaxBrickCoordinates.X; ++X)
+		const TSharedPtr<FBrickCollisionBuild,ESPMode::ThreadSafe> Build = PendingBuild;
+		PendingBuild.Reset();
+		PendingBuildEvent = NULL;
+		ApplyCollisionBuild(*Build);
+
+		if(HasPendingRebuild)
 		{
-			for(int32 Z = MinBrickCoordinates.Z; Z <= MaxBrickCoordinates.Z; ++Z)
-			{
-				const FInt3 BrickCoordinates(X,Y,Z);
-				const FInt3 LocalBrickCoordinates = BrickCoordinates - MinLocalBrickCoordinates;
-				// Only create collision boxes for bricks that aren't empty.
-				const int32 BrickMaterial = LocalBrickMaterials[(LocalBrickCoordinates.Y * LocalBricksDim.X + LocalBrickCoordinates.X) * LocalBricksDim.Z + LocalBrickCoordinates.Z];
-				if (BrickMaterial != EmptyMaterialIndex)
-				{
-					// Only create collision boxes for bricks that are adjacent to an empty brick.
-					bool HasEmptyNeighbor = false;
-					for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
-					{
-						const FInt3 FacingLocalBrickCoordinates = LocalBrickCoordinates + FaceNormals[FaceIndex];
-						if(LocalBrickMaterials[(FacingLocalBrickCoordinates.Y * LocalBricksDim.X + FacingLocalBrickCoordinates.X) * LocalBricksDim.Z + FacingLocalBrickCoordinates.Z] == EmptyMaterialIndex)
-						{
-							HasEmptyNeighbor = true;
-							break;
-						}
-					}
-					if(HasEmptyNeighbor)
-					{
-						FKBoxElem& BoxElement = *new(CollisionBodySetup->AggGeom.BoxElems) FKBoxElem;
-
-						// Physics bodies are uniformly scaled by the minimum component of the 3D scale.
-						// Compute the non-uniform scaling components to apply to the box center/extent.
-						const FVector AbsScale3D = ComponentToWorld.GetScale3D().GetAbs();
-						const FVector NonUniformScale3D = AbsScale3D / AbsScale3D.GetMin();
-
-						// Set the box center and size.
-						BoxElement.Center = ((BrickCoordinates - MinBrickCoordinates).ToFloat() + FVector(0.5f)) * NonUniformScale3D;
-						BoxElement.X = NonUniformScale3D.X;
-						BoxElement.Y = NonUniformScale3D.Y;
-						BoxElement.Z = NonUniformScale3D.Z;
-					}
-				}
-			}
+			HasPendingRebuild = false;
+			UpdateCollisionBody();
 		}
 	}
+}
+
+void UBrickCollisionComponent::ApplyCollisionBuild(FBrickCollisionBuild& Build)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	CollisionBodySetup->AggGeom.BoxElems = MoveTemp(Build.BoxElems);
 
 	// Recreate the physics state, which includes an Face of the CollisionBodySetup.
 	RecreatePhysicsState();
 
-	UE_LOG(LogStats,Log,TEXT("UBrickCollisionComponent::UpdateCollisionBody took %fms to create %u boxes"),1000.0f * float(FPlatformTime::Seconds() - StartTime),CollisionBodySetup->AggGeom.BoxElems.Num());
+	UE_LOG(LogStats,Log,TEXT("UBrickCollisionComponent::UpdateCollisionBody took %fms to build %u boxes for %u surface bricks, and %fms to recreate the physics state"),
+		Build.BuildMilliseconds,
+		CollisionBodySetup->AggGeom.BoxElems.Num(),
+		Build.NumSurfaceBricks,
+		1000.0f * float(FPlatformTime::Seconds() - StartTime)
+		);
 }
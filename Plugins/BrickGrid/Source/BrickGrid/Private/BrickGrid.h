@@ -2,4 +2,13 @@
 
 #include "BrickGridComponent.h"
 
-extern const FInt3 FaceNormals[6];
\ No newline at end of file
+extern const FInt3 FaceNormals[6];
+
+// Computes the layer of bricks adjacent to one face of a box of bricks.
+inline void GetFaceAdjacentBricks(const FInt3& MinBoxBrickCoordinates,const FInt3& MaxBoxBrickCoordinates,uint32 FaceIndex,FInt3& OutMinBrickCoordinates,FInt3& OutMaxBrickCoordinates)
+{
+	const FInt3 FaceAxisMask = FaceNormals[FaceIndex] * FaceNormals[FaceIndex];
+	const FInt3 LayerBrickCoordinates = FaceNormals[FaceIndex].SumComponents() > 0 ? MaxBoxBrickCoordinates + FaceNormals[FaceIndex] : MinBoxBrickCoordinates + FaceNormals[FaceIndex];
+	OutMinBrickCoordinates = MinBoxBrickCoordinates * (FInt3::Scalar(1) - FaceAxisMask) + LayerBrickCoordinates * FaceAxisMask;
+	OutMaxBrickCoordinates = MaxBoxBrickCoordinates * (FInt3::Scalar(1) - FaceAxisMask) + LayerBrickCoordinates * FaceAxisMask;
+}
@@ -13,7 +13,7 @@ void UBrickGridComponent::Init(const FBrickGridParameters& InParameters)
 	// Validate the empty material index.
 	Parameters.EmptyMaterialIndex = FMath::Clamp<int32>(Parameters.EmptyMaterialIndex, 0, Parameters.Materials.Num() - 1);
 
-	// Limit each region to 128x128x128 bricks, which is the largest power of 2 size that can be rendered using 8-bit relative vertex positions.
+	// Limit each region to 256x256x256 bricks. Render chunks larger than 128 bricks along any axis are rendered using 16-bit relative vertex positions.
 	Parameters.BricksPerRegionLog2 = FInt3::Clamp(Parameters.BricksPerRegionLog2, FInt3::Scalar(0), FInt3::Scalar(BrickGridConstants::MaxBricksPerRegionAxisLog2));
 
 	// Don't allow fractional chunks/region, or chunks smaller than one brick.
@@ -36,13 +36,52 @@ void UBrickGridComponent::Init(const FBrickGridParameters& InParameters)
 	MinBrickCoordinates = Parameters.MinRegionCoordinates * BricksPerRegion;
 	MaxBrickCoordinates = Parameters.MaxRegionCoordinates * BricksPerRegion + BricksPerRegion - FInt3::Scalar(1);
 
+	// Don't allow LODs that would make a render chunk smaller than one brick along any axis.
+	Parameters.MaxRenderChunkLOD = FMath::Clamp(Parameters.MaxRenderChunkLOD,0,FMath::Min(BricksPerRenderChunkLog2.X,FMath::Min(BricksPerRenderChunkLog2.Y,BricksPerRenderChunkLog2.Z)));
+	Parameters.RenderChunkLODDistance = FMath::Max(1.0f,Parameters.RenderChunkLODDistance);
+	Parameters.RenderChunkLODHysteresis = FMath::Clamp(Parameters.RenderChunkLODHysteresis,0.0f,Parameters.RenderChunkLODDistance / 2.0f);
+
+	// Limit super chunks to 256 bricks along each axis, to bound the memory needed to mesh them.
+	Parameters.RenderChunksPerSuperChunkLog2 = FInt3::Clamp(Parameters.RenderChunksPerSuperChunkLog2,FInt3::Scalar(0),FInt3::Scalar(BrickGridConstants::MaxBricksPerRegionAxisLog2) - BricksPerRenderChunkLog2);
+	Parameters.SuperChunkDistance = FMath::Max(0.0f,Parameters.SuperChunkDistance);
+
+	// Don't predict the viewers' movement backward in time.
+	Parameters.PrefetchLookAheadTime = FMath::Max(0.0f,Parameters.PrefetchLookAheadTime);
+
+	// Dedicated servers never draw the grid. Headless grids don't need light, since it's only used to shade render chunks.
+	Parameters.Headless = Parameters.Headless || IsRunningDedicatedServer();
+	Parameters.EnableLightPropagation = Parameters.EnableLightPropagation && !Parameters.Headless;
+
 	// Limit the ambient occlusion blur radius to be a positive value.
 	Parameters.AmbientOcclusionBlurRadius = FMath::Max(0,Parameters.AmbientOcclusionBlurRadius);
 
+	// Classify the materials for the mesher. Materials without a surface material are drawn with the default material, which is opaque.
+	BrickClassByMaterial.Empty(Parameters.Materials.Num());
+	for(int32 MaterialIndex = 0;MaterialIndex < Parameters.Materials.Num();++MaterialIndex)
+	{
+		const UMaterialInterface* SurfaceMaterial = Parameters.Materials[MaterialIndex].SurfaceMaterial;
+		if(MaterialIndex == Parameters.EmptyMaterialIndex)
+		{
+			BrickClassByMaterial.Add(EBrickClass::Empty);
+		}
+		else if(SurfaceMaterial && SurfaceMaterial->GetBlendMode() != EBlendMode::BLEND_Opaque)
+		{
+			BrickClassByMaterial.Add(EBrickClass::Translucent);
+		}
+		else
+		{
+			BrickClassByMaterial.Add(EBrickClass::Opaque);
+		}
+	}
+
 	// Reset the regions and reregister the component.
+	// Destroying the chunk components waits for their mesh tasks, which may need the regions lock, so only hold it while clearing the regions.
 	FComponentReregisterContext ReregisterContext(this);
-	Regions.Empty();
-	RegionCoordinatesToIndex.Empty();
+	{
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		Regions.Empty();
+		RegionCoordinatesToIndex.Empty();
+	}
 	for(auto ChunkIt = RenderChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
 	{
 		ChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
@@ -53,8 +92,23 @@ void UBrickGridComponent::Init(const FBrickGridParameters& InParameters)
 		ChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
 		ChunkIt.Value()->DestroyComponent();
 	}
+	for(auto ChunkIt = SuperChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
+	{
+		ChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
+		ChunkIt.Value()->DestroyComponent();
+	}
 	RenderChunkCoordinatesToComponent.Empty();
+	SuperChunkCoordinatesToComponent.Empty();
 	CollisionChunkCoordinatesToComponent.Empty();
+
+	// Keep the viewers, but recompute their interest on the next update.
+	CollisionChunkInterestCounts.Empty();
+	for(auto ViewerIt = Viewers.CreateIterator();ViewerIt;++ViewerIt)
+	{
+		ViewerIt.Value().InterestCollisionChunks.Empty();
+		ViewerIt.Value().PendingRegions.Empty();
+		ViewerIt.Value().IsInterestValid = false;
+	}
 }
 
 FBrickGridData UBrickGridComponent::GetData() const
@@ -67,15 +121,38 @@ FBrickGridData UBrickGridComponent::GetData() const
 void UBrickGridComponent::SetData(const FBrickGridData& Data)
 {
 	Init(Parameters);
-	Regions = Data.Regions;
 
-	for(auto RegionIt = Regions.CreateIterator();RegionIt;++RegionIt)
 	{
-		// Compute the max non-empty brick map for the new regions.
-		UpdateMaxNonEmptyBrickMap(*RegionIt,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		Regions = Data.Regions;
+
+		for(auto RegionIt = Regions.CreateIterator();RegionIt;++RegionIt)
+		{
+			// Compute the max non-empty brick map and render chunk brick counts for the new regions.
+			UpdateMaxNonEmptyBrickMap(*RegionIt,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+			UpdateRenderChunkBrickCounts(*RegionIt,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+
+			// The regions' light is recomputed below.
+			RegionIt->Light.Empty();
+			RegionIt->IsLightValid = false;
+
+			// Recreate the region coordinate to index map.
+			RegionCoordinatesToIndex.Add(RegionIt->Coordinates,RegionIt.GetIndex());
+		}
+	}
+
+	// Compute the blurred sky visibility once all the height maps it depends on are known.
+	for(auto RegionIt = Regions.CreateConstIterator();RegionIt;++RegionIt)
+	{
+		UpdateBlurredSkyVisibility(RegionIt->Coordinates * BricksPerRegion,RegionIt->Coordinates * BricksPerRegion + BricksPerRegion - FInt3::Scalar(1));
+	}
 
-		// Recreate the region coordinate to index map.
-		RegionCoordinatesToIndex.Add(RegionIt->Coordinates,RegionIt.GetIndex());
+	// Light all the regions at once.
+	if(Parameters.EnableLightPropagation)
+	{
+		TArray<FInt3> AllRegionCoordinates;
+		RegionCoordinatesToIndex.GenerateKeyArray(AllRegionCoordinates);
+		RelightRegions(AllRegionCoordinates);
 	}
 }
 
@@ -97,6 +174,7 @@ FBrick UBrickGridComponent::GetBrick(const FInt3& BrickCoordinates) const
 
 void UBrickGridComponent::GetBrickMaterialArray(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,TArray<uint8>& OutBrickMaterials) const
 {
+	FScopeLock RegionsLock(&RegionsCriticalSection);
 	const FInt3 OutputSize = GetMaxBrickCoordinates - GetMinBrickCoordinates + FInt3::Scalar(1);
 	const FInt3 GetMinRegionCoordinates = BrickToRegionCoordinates(GetMinBrickCoordinates);
 	const FInt3 GetMaxRegionCoordinates = BrickToRegionCoordinates(GetMaxBrickCoordinates);
@@ -141,30 +219,33 @@ void UBrickGridComponent::SetBrickMaterialArray(const FInt3& SetMinBrickCoordina
 	const FInt3 InputSize = SetMaxBrickCoordinates - SetMinBrickCoordinates + FInt3::Scalar(1);
 	const FInt3 SetMinRegionCoordinates = BrickToRegionCoordinates(SetMinBrickCoordinates);
 	const FInt3 SetMaxRegionCoordinates = BrickToRegionCoordinates(SetMaxBrickCoordinates);
-	for(int32 RegionY = SetMinRegionCoordinates.Y;RegionY <= SetMaxRegionCoordinates.Y;++RegionY)
 	{
-		for(int32 RegionX = SetMinRegionCoordinates.X;RegionX <= SetMaxRegionCoordinates.X;++RegionX)
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		for(int32 RegionY = SetMinRegionCoordinates.Y;RegionY <= SetMaxRegionCoordinates.Y;++RegionY)
 		{
-			for(int32 RegionZ = SetMinRegionCoordinates.Z;RegionZ <= SetMaxRegionCoordinates.Z;++RegionZ)
+			for(int32 RegionX = SetMinRegionCoordinates.X;RegionX <= SetMaxRegionCoordinates.X;++RegionX)
 			{
-				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
-				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
-				const FInt3 MinRegionBrickCoordinates = FInt3(RegionX,RegionY,RegionZ) * BricksPerRegion;
-				const FInt3 MinInputRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),SetMinBrickCoordinates - MinRegionBrickCoordinates);
-				const FInt3 MaxInputRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),SetMaxBrickCoordinates - MinRegionBrickCoordinates);
-				for(int32 RegionBrickY = MinInputRegionBrickCoordinates.Y;RegionBrickY <= MaxInputRegionBrickCoordinates.Y;++RegionBrickY)
+				for(int32 RegionZ = SetMinRegionCoordinates.Z;RegionZ <= SetMaxRegionCoordinates.Z;++RegionZ)
 				{
-					for(int32 RegionBrickX = MinInputRegionBrickCoordinates.X;RegionBrickX <= MaxInputRegionBrickCoordinates.X;++RegionBrickX)
+					const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+					const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+					const FInt3 MinRegionBrickCoordinates = FInt3(RegionX,RegionY,RegionZ) * BricksPerRegion;
+					const FInt3 MinInputRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),SetMinBrickCoordinates - MinRegionBrickCoordinates);
+					const FInt3 MaxInputRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),SetMaxBrickCoordinates - MinRegionBrickCoordinates);
+					for(int32 RegionBrickY = MinInputRegionBrickCoordinates.Y;RegionBrickY <= MaxInputRegionBrickCoordinates.Y;++RegionBrickY)
 					{
-						const int32 InputX = MinRegionBrickCoordinates.X + RegionBrickX - SetMinBrickCoordinates.X;
-						const int32 InputY = MinRegionBrickCoordinates.Y + RegionBrickY - SetMinBrickCoordinates.Y;
-						const int32 InputMinZ = MinRegionBrickCoordinates.Z + MinInputRegionBrickCoordinates.Z - SetMinBrickCoordinates.Z;
-						const int32 InputSizeZ = MaxInputRegionBrickCoordinates.Z - MinInputRegionBrickCoordinates.Z + 1;
-						const uint32 InputBaseBrickIndex = (InputY * InputSize.X + InputX) * InputSize.Z + InputMinZ;
-						const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinInputRegionBrickCoordinates.Z;
-						if(RegionIndex)
+						for(int32 RegionBrickX = MinInputRegionBrickCoordinates.X;RegionBrickX <= MaxInputRegionBrickCoordinates.X;++RegionBrickX)
 						{
-							FMemory::Memcpy(&Regions[*RegionIndex].BrickContents[RegionBaseBrickIndex],&BrickMaterials[InputBaseBrickIndex],InputSizeZ * sizeof(uint8));
+							const int32 InputX = MinRegionBrickCoordinates.X + RegionBrickX - SetMinBrickCoordinates.X;
+							const int32 InputY = MinRegionBrickCoordinates.Y + RegionBrickY - SetMinBrickCoordinates.Y;
+							const int32 InputMinZ = MinRegionBrickCoordinates.Z + MinInputRegionBrickCoordinates.Z - SetMinBrickCoordinates.Z;
+							const int32 InputSizeZ = MaxInputRegionBrickCoordinates.Z - MinInputRegionBrickCoordinates.Z + 1;
+							const uint32 InputBaseBrickIndex = (InputY * InputSize.X + InputX) * InputSize.Z + InputMinZ;
+							const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinInputRegionBrickCoordinates.Z;
+							if(RegionIndex)
+							{
+								FMemory::Memcpy(&Regions[*RegionIndex].BrickContents[RegionBaseBrickIndex],&BrickMaterials[InputBaseBrickIndex],InputSizeZ * sizeof(uint8));
+							}
 						}
 					}
 				}
@@ -175,6 +256,38 @@ void UBrickGridComponent::SetBrickMaterialArray(const FInt3& SetMinBrickCoordina
 	InvalidateChunkComponents(SetMinBrickCoordinates,SetMaxBrickCoordinates);
 }
 
+bool UBrickGridComponent::FillRegion(const FInt3& RegionCoordinates,uint8 MaterialIndex)
+{
+	const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+	if(!RegionIndex)
+	{
+		return false;
+	}
+	FBrickRegion& Region = Regions[*RegionIndex];
+
+	// New regions are filled with the empty material, so there's nothing to change if the region's non-empty height map says it's still empty.
+	if(MaterialIndex == Parameters.EmptyMaterialIndex)
+	{
+		bool IsEmpty = true;
+		for(int32 ColumnIndex = 0;ColumnIndex < Region.MaxNonEmptyBrickRegionZs.Num() && IsEmpty;++ColumnIndex)
+		{
+			IsEmpty = Region.MaxNonEmptyBrickRegionZs[ColumnIndex] < 0;
+		}
+		if(IsEmpty)
+		{
+			return true;
+		}
+	}
+	{
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		FMemory::Memset(Region.BrickContents.GetData(),MaterialIndex,Region.BrickContents.Num() * sizeof(uint8));
+	}
+
+	const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+	InvalidateChunkComponents(MinRegionBrickCoordinates,MinRegionBrickCoordinates + BricksPerRegion - FInt3::Scalar(1));
+	return true;
+}
+
 bool UBrickGridComponent::SetBrick(const FInt3& BrickCoordinates, int32 MaterialIndex)
 {
 	if(FInt3::All(BrickCoordinates >= MinBrickCoordinates) && FInt3::All(BrickCoordinates <= MaxBrickCoordinates) && MaterialIndex < Parameters.Materials.Num())
@@ -184,8 +297,10 @@ bool UBrickGridComponent::SetBrick(const FInt3& BrickCoordinates, int32 Material
 		if (RegionIndex != NULL)
 		{
 			const uint32 BrickIndex = BrickCoordinatesToRegionBrickIndex(RegionCoordinates,BrickCoordinates);
-			FBrickRegion& Region = Regions[*RegionIndex];
-			Region.BrickContents[BrickIndex] = MaterialIndex;
+			{
+				FScopeLock RegionsLock(&RegionsCriticalSection);
+				Regions[*RegionIndex].BrickContents[BrickIndex] = MaterialIndex;
+			}
 			InvalidateChunkComponents(BrickCoordinates,BrickCoordinates);
 			return true;
 		}
@@ -215,13 +330,230 @@ void UBrickGridComponent::UpdateMaxNonEmptyBrickMap(FBrickRegion& Region,const F
 					break;
 				}
 			}
-			Region.MaxNonEmptyBrickRegionZs[(RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX] = (int8)MaxNonEmptyRegionBrickZ;
+			Region.MaxNonEmptyBrickRegionZs[(RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX] = (int16)MaxNonEmptyRegionBrickZ;
+		}
+	}
+}
+
+void UBrickGridComponent::UpdateRenderChunkBrickCounts(FBrickRegion& Region,const FInt3 MinDirtyRegionBrickCoordinates,const FInt3 MaxDirtyRegionBrickCoordinates) const
+{
+	// Headless grids don't have render chunks.
+	if(Parameters.Headless)
+	{
+		return;
+	}
+
+	// Allocate the counts.
+	const int32 NumRenderChunks = RenderChunksPerRegion.X * RenderChunksPerRegion.Y * RenderChunksPerRegion.Z;
+	if(Region.RenderChunkNonEmptyBrickCounts.Num() != NumRenderChunks)
+	{
+		Region.RenderChunkNonEmptyBrickCounts.SetNumZeroed(NumRenderChunks);
+		Region.RenderChunkOpaqueBrickCounts.SetNumZeroed(NumRenderChunks);
+	}
+
+	// Recount the bricks in each render chunk overlapping the dirty box.
+	const FInt3 MinDirtyChunkCoordinates = FInt3::SignedShiftRight(MinDirtyRegionBrickCoordinates,BricksPerRenderChunkLog2);
+	const FInt3 MaxDirtyChunkCoordinates = FInt3::SignedShiftRight(MaxDirtyRegionBrickCoordinates,BricksPerRenderChunkLog2);
+	for(int32 ChunkY = MinDirtyChunkCoordinates.Y;ChunkY <= MaxDirtyChunkCoordinates.Y;++ChunkY)
+	{
+		for(int32 ChunkX = MinDirtyChunkCoordinates.X;ChunkX <= MaxDirtyChunkCoordinates.X;++ChunkX)
+		{
+			for(int32 ChunkZ = MinDirtyChunkCoordinates.Z;ChunkZ <= MaxDirtyChunkCoordinates.Z;++ChunkZ)
+			{
+				const FInt3 MinChunkRegionBrickCoordinates = FInt3(ChunkX,ChunkY,ChunkZ) * BricksPerRenderChunk;
+				uint32 NumNonEmptyBricks = 0;
+				uint32 NumOpaqueBricks = 0;
+				for(int32 RegionBrickY = MinChunkRegionBrickCoordinates.Y;RegionBrickY < MinChunkRegionBrickCoordinates.Y + BricksPerRenderChunk.Y;++RegionBrickY)
+				{
+					for(int32 RegionBrickX = MinChunkRegionBrickCoordinates.X;RegionBrickX < MinChunkRegionBrickCoordinates.X + BricksPerRenderChunk.X;++RegionBrickX)
+					{
+						const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinChunkRegionBrickCoordinates.Z;
+						for(int32 ChunkBrickZ = 0;ChunkBrickZ < BricksPerRenderChunk.Z;++ChunkBrickZ)
+						{
+							const EBrickClass BrickClass = BrickClassByMaterial[Region.BrickContents[RegionBaseBrickIndex + ChunkBrickZ]];
+							NumNonEmptyBricks += BrickClass != EBrickClass::Empty ? 1 : 0;
+							NumOpaqueBricks += BrickClass == EBrickClass::Opaque ? 1 : 0;
+						}
+					}
+				}
+				const uint32 ChunkIndex = (ChunkY * RenderChunksPerRegion.X + ChunkX) * RenderChunksPerRegion.Z + ChunkZ;
+				Region.RenderChunkNonEmptyBrickCounts[ChunkIndex] = NumNonEmptyBricks;
+				Region.RenderChunkOpaqueBrickCounts[ChunkIndex] = NumOpaqueBricks;
+			}
+		}
+	}
+}
+
+void UBrickGridComponent::UpdateBlurredSkyVisibility(const FInt3 MinDirtyBrickCoordinates,const FInt3 MaxDirtyBrickCoordinates)
+{
+	// The blurred sky visibility is only used to shade render chunks.
+	if(Parameters.Headless)
+	{
+		return;
+	}
+
+	const FInt3 MinBlurBrickCoordinates(MinDirtyBrickCoordinates.X,MinDirtyBrickCoordinates.Y,FMath::Max(MinDirtyBrickCoordinates.Z,MinBrickCoordinates.Z));
+	const FInt3 MaxBlurBrickCoordinates(MaxDirtyBrickCoordinates.X,MaxDirtyBrickCoordinates.Y,FMath::Min(MaxDirtyBrickCoordinates.Z,MaxBrickCoordinates.Z));
+	if(FInt3::Any(MinBlurBrickCoordinates > MaxBlurBrickCoordinates))
+	{
+		return;
+	}
+
+	// Read the height map for the dirty columns and the columns within the blur radius of them.
+	const FInt3 BlurExpansionExtent(Parameters.AmbientOcclusionBlurRadius,Parameters.AmbientOcclusionBlurRadius,0);
+	const FInt3 MinLocalBrickCoordinates = MinBlurBrickCoordinates - BlurExpansionExtent;
+	const FInt3 LocalBricksDim = MaxBlurBrickCoordinates - MinBlurBrickCoordinates + FInt3::Scalar(1) + BlurExpansionExtent * FInt3::Scalar(2);
+	TArray<int16> MaxNonEmptyBrickLocalZs;
+	MaxNonEmptyBrickLocalZs.SetNumUninitialized(LocalBricksDim.X * LocalBricksDim.Y);
+	GetMaxNonEmptyBrickZ(MinLocalBrickCoordinates,MinLocalBrickCoordinates + LocalBricksDim - FInt3::Scalar(1),MaxNonEmptyBrickLocalZs);
+
+	// Blur the sky visibility implied by the height map.
+	const FInt3 BlurredBricksDim = MaxBlurBrickCoordinates - MinBlurBrickCoordinates + FInt3::Scalar(1);
+	TArray<uint8> LocalBlurredSkyVisibility;
+	LocalBlurredSkyVisibility.SetNumUninitialized(BlurredBricksDim.X * BlurredBricksDim.Y * BlurredBricksDim.Z);
+	BrickMesher::ComputeBlurredSkyVisibility(
+		MaxNonEmptyBrickLocalZs.GetData(),
+		BrickMesher::FSize3(LocalBricksDim.X,LocalBricksDim.Y,LocalBricksDim.Z),
+		Parameters.AmbientOcclusionBlurRadius,
+		LocalBlurredSkyVisibility.GetData()
+		);
+
+	// Copy the blurred sky visibility into the regions.
+	FScopeLock RegionsLock(&RegionsCriticalSection);
+	const FInt3 MinRegionCoordinates = BrickToRegionCoordinates(MinBlurBrickCoordinates);
+	const FInt3 MaxRegionCoordinates = BrickToRegionCoordinates(MaxBlurBrickCoordinates);
+	for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y;++RegionY)
+	{
+		for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X;++RegionX)
+		{
+			for(int32 RegionZ = MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z;++RegionZ)
+			{
+				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+				if(!RegionIndex)
+				{
+					continue;
+				}
+				FBrickRegion& Region = Regions[*RegionIndex];
+				if(!Region.BlurredSkyVisibility.Num())
+				{
+					Region.BlurredSkyVisibility.SetNumZeroed(Region.BrickContents.Num());
+				}
+				const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+				const FInt3 MinInputRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),MinBlurBrickCoordinates - MinRegionBrickCoordinates);
+				const FInt3 MaxInputRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),MaxBlurBrickCoordinates - MinRegionBrickCoordinates);
+				for(int32 RegionBrickY = MinInputRegionBrickCoordinates.Y;RegionBrickY <= MaxInputRegionBrickCoordinates.Y;++RegionBrickY)
+				{
+					for(int32 RegionBrickX = MinInputRegionBrickCoordinates.X;RegionBrickX <= MaxInputRegionBrickCoordinates.X;++RegionBrickX)
+					{
+						const int32 InputX = MinRegionBrickCoordinates.X + RegionBrickX - MinBlurBrickCoordinates.X;
+						const int32 InputY = MinRegionBrickCoordinates.Y + RegionBrickY - MinBlurBrickCoordinates.Y;
+						const int32 InputMinZ = MinRegionBrickCoordinates.Z + MinInputRegionBrickCoordinates.Z - MinBlurBrickCoordinates.Z;
+						const int32 InputSizeZ = MaxInputRegionBrickCoordinates.Z - MinInputRegionBrickCoordinates.Z + 1;
+						const uint32 InputBaseBrickIndex = (InputY * BlurredBricksDim.X + InputX) * BlurredBricksDim.Z + InputMinZ;
+						const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinInputRegionBrickCoordinates.Z;
+						FMemory::Memcpy(&Region.BlurredSkyVisibility[RegionBaseBrickIndex],&LocalBlurredSkyVisibility[InputBaseBrickIndex],InputSizeZ * sizeof(uint8));
+					}
+				}
+			}
+		}
+	}
+}
+
+bool UBrickGridComponent::GetBlurredSkyVisibility(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,TArray<uint8>& OutBlurredSkyVisibility) const
+{
+	FScopeLock RegionsLock(&RegionsCriticalSection);
+	const FInt3 OutputSize = GetMaxBrickCoordinates - GetMinBrickCoordinates + FInt3::Scalar(1);
+	const FInt3 GetMinRegionCoordinates = BrickToRegionCoordinates(GetMinBrickCoordinates);
+	const FInt3 GetMaxRegionCoordinates = BrickToRegionCoordinates(GetMaxBrickCoordinates);
+	const uint8 FullBlurredSkyVisibility = BrickMesher::GetFullBlurredSkyVisibility(Parameters.AmbientOcclusionBlurRadius);
+	for(int32 RegionY = GetMinRegionCoordinates.Y;RegionY <= GetMaxRegionCoordinates.Y;++RegionY)
+	{
+		for(int32 RegionX = GetMinRegionCoordinates.X;RegionX <= GetMaxRegionCoordinates.X;++RegionX)
+		{
+			for(int32 RegionZ = GetMinRegionCoordinates.Z;RegionZ <= GetMaxRegionCoordinates.Z;++RegionZ)
+			{
+				// Bricks below the grid can't see the sky, and bricks above it see all of it.
+				// Bricks in regions that haven't been created can see the sky through any region above them, so they can't be filled in here.
+				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+				const bool IsBelowGrid = RegionZ < Parameters.MinRegionCoordinates.Z;
+				const bool IsAboveGrid = RegionZ > Parameters.MaxRegionCoordinates.Z;
+				if(!RegionIndex && !IsBelowGrid && !IsAboveGrid)
+				{
+					return false;
+				}
+				const FInt3 MinRegionBrickCoordinates = FInt3(RegionX,RegionY,RegionZ) * BricksPerRegion;
+				const FInt3 MinOutputRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),GetMinBrickCoordinates - MinRegionBrickCoordinates);
+				const FInt3 MaxOutputRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),GetMaxBrickCoordinates - MinRegionBrickCoordinates);
+				for(int32 RegionBrickY = MinOutputRegionBrickCoordinates.Y;RegionBrickY <= MaxOutputRegionBrickCoordinates.Y;++RegionBrickY)
+				{
+					for(int32 RegionBrickX = MinOutputRegionBrickCoordinates.X;RegionBrickX <= MaxOutputRegionBrickCoordinates.X;++RegionBrickX)
+					{
+						const int32 OutputX = MinRegionBrickCoordinates.X + RegionBrickX - GetMinBrickCoordinates.X;
+						const int32 OutputY = MinRegionBrickCoordinates.Y + RegionBrickY - GetMinBrickCoordinates.Y;
+						const int32 OutputMinZ = MinRegionBrickCoordinates.Z + MinOutputRegionBrickCoordinates.Z - GetMinBrickCoordinates.Z;
+						const int32 OutputSizeZ = MaxOutputRegionBrickCoordinates.Z - MinOutputRegionBrickCoordinates.Z + 1;
+						const uint32 OutputBaseBrickIndex = (OutputY * OutputSize.X + OutputX) * OutputSize.Z + OutputMinZ;
+						const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinOutputRegionBrickCoordinates.Z;
+						if(RegionIndex)
+						{
+							FMemory::Memcpy(&OutBlurredSkyVisibility[OutputBaseBrickIndex],&Regions[*RegionIndex].BlurredSkyVisibility[RegionBaseBrickIndex],OutputSizeZ * sizeof(uint8));
+						}
+						else
+						{
+							FMemory::Memset(&OutBlurredSkyVisibility[OutputBaseBrickIndex],IsBelowGrid ? 0 : FullBlurredSkyVisibility,OutputSizeZ * sizeof(uint8));
+						}
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+EBrickChunkSummary UBrickGridComponent::GetRenderChunkSummary(const FInt3& MinRenderChunkCoordinates,const FInt3& MaxRenderChunkCoordinates) const
+{
+	// The chunks are empty if none of them contain non-empty bricks, and buried if they and all chunks adjacent to them are entirely opaque.
+	// Chunks outside of any region are empty, just as GetBrickMaterialArray treats them.
+	const uint32 NumBricksPerRenderChunk = BricksPerRenderChunk.X * BricksPerRenderChunk.Y * BricksPerRenderChunk.Z;
+	const FInt3 MinExpandedChunkCoordinates = MinRenderChunkCoordinates - FInt3::Scalar(1);
+	const FInt3 MaxExpandedChunkCoordinates = MaxRenderChunkCoordinates + FInt3::Scalar(1);
+	bool bEmpty = true;
+	bool bBuried = true;
+	for(int32 ChunkY = MinExpandedChunkCoordinates.Y;ChunkY <= MaxExpandedChunkCoordinates.Y && (bEmpty || bBuried);++ChunkY)
+	{
+		for(int32 ChunkX = MinExpandedChunkCoordinates.X;ChunkX <= MaxExpandedChunkCoordinates.X && (bEmpty || bBuried);++ChunkX)
+		{
+			for(int32 ChunkZ = MinExpandedChunkCoordinates.Z;ChunkZ <= MaxExpandedChunkCoordinates.Z && (bEmpty || bBuried);++ChunkZ)
+			{
+				const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
+				const FInt3 RegionCoordinates = FInt3::SignedShiftRight(ChunkCoordinates,Parameters.RenderChunksPerRegionLog2);
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+				uint32 NumNonEmptyBricks = 0;
+				uint32 NumOpaqueBricks = 0;
+				if(RegionIndex)
+				{
+					const FBrickRegion& Region = Regions[*RegionIndex];
+					const FInt3 RegionChunkCoordinates = ChunkCoordinates - RegionCoordinates * RenderChunksPerRegion;
+					const uint32 ChunkIndex = (RegionChunkCoordinates.Y * RenderChunksPerRegion.X + RegionChunkCoordinates.X) * RenderChunksPerRegion.Z + RegionChunkCoordinates.Z;
+					NumNonEmptyBricks = Region.RenderChunkNonEmptyBrickCounts[ChunkIndex];
+					NumOpaqueBricks = Region.RenderChunkOpaqueBrickCounts[ChunkIndex];
+				}
+				bBuried &= NumOpaqueBricks == NumBricksPerRenderChunk;
+				if(FInt3::All(ChunkCoordinates >= MinRenderChunkCoordinates) && FInt3::All(ChunkCoordinates <= MaxRenderChunkCoordinates))
+				{
+					bEmpty &= NumNonEmptyBricks == 0;
+				}
+			}
 		}
 	}
+	return bEmpty ? EBrickChunkSummary::Empty : bBuried ? EBrickChunkSummary::Buried : EBrickChunkSummary::Mixed;
 }
 
-void UBrickGridComponent::GetMaxNonEmptyBrickZ(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,TArray<int8>& OutHeightMap) const
+void UBrickGridComponent::GetMaxNonEmptyBrickZ(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,TArray<int16>& OutHeightMap) const
 {
+	FScopeLock RegionsLock(&RegionsCriticalSection);
 	const FInt3 OutputSize = GetMaxBrickCoordinates - GetMinBrickCoordinates + FInt3::Scalar(1);
 	const FInt3 MinRegionCoordinates = BrickToRegionCoordinates(GetMinBrickCoordinates);
 	const FInt3 MaxRegionCoordinates = BrickToRegionCoordinates(GetMaxBrickCoordinates);
@@ -252,7 +584,7 @@ void UBrickGridComponent::GetMaxNonEmptyBrickZ(const FInt3& GetMinBrickCoordinat
 					for(int32 RegionZIndex = ZRegions.Num() - 1;RegionZIndex >= 0;--RegionZIndex)
 					{
 						const FBrickRegion& Region = *ZRegions[RegionZIndex];
-						const int8 RegionMaxNonEmptyZ = Region.MaxNonEmptyBrickRegionZs[(RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX];
+						const int16 RegionMaxNonEmptyZ = Region.MaxNonEmptyBrickRegionZs[(RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX];
 						if(RegionMaxNonEmptyZ != -1)
 						{
 							MaxNonEmptyBrickZ = Region.Coordinates.Z * BricksPerRegion.Z + (int32)RegionMaxNonEmptyZ;
@@ -262,7 +594,7 @@ void UBrickGridComponent::GetMaxNonEmptyBrickZ(const FInt3& GetMinBrickCoordinat
 
 					const int32 OutputX = MinRegionBrickCoordinates.X + RegionBrickX - GetMinBrickCoordinates.X;
 					const int32 OutputY = MinRegionBrickCoordinates.Y + RegionBrickY - GetMinBrickCoordinates.Y;
-					OutHeightMap[OutputY * OutputSize.X + OutputX] = (int8)FMath::Clamp(MaxNonEmptyBrickZ - GetMinBrickCoordinates.Z,-1,127);
+					OutHeightMap[OutputY * OutputSize.X + OutputX] = (int16)FMath::Clamp(MaxNonEmptyBrickZ - GetMinBrickCoordinates.Z,-1,32767);
 				}
 			}
 		}
@@ -274,31 +606,71 @@ void UBrickGridComponent::InvalidateChunkComponents(const FInt3& GetMinBrickCoor
 	// Expand the brick box by 1 brick so that bricks facing the one being invalidated are also updated.
 	const FInt3 FacingExpansionExtent = FInt3::Scalar(1);
 
-	// Update the region non-empty brick max Z maps.
+	// Render chunks read the bricks beyond their sides downsampled to the LOD of the chunk or neighbor, so expand the render chunk box
+	// by the largest downsampled brick instead.
+	const FInt3 DownsampledFacingExpansionExtent = FInt3::Scalar(1 << Parameters.MaxRenderChunkLOD);
+
+	// Update the region non-empty brick max Z maps and render chunk brick counts.
 	const FInt3 MinRegionCoordinates = BrickToRegionCoordinates(GetMinBrickCoordinates);
 	const FInt3 MaxRegionCoordinates = BrickToRegionCoordinates(GetMaxBrickCoordinates);
-	for(int32 RegionZ = Parameters.MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z;++RegionZ)
+	const FInt3 MinColumnBrickCoordinates(GetMinBrickCoordinates.X,GetMinBrickCoordinates.Y,MinBrickCoordinates.Z);
+	const FInt3 MaxColumnBrickCoordinates(GetMaxBrickCoordinates.X,GetMaxBrickCoordinates.Y,MinBrickCoordinates.Z);
+	TArray<int16> PreviousHeightMap;
+	PreviousHeightMap.SetNumUninitialized((GetMaxBrickCoordinates.X - GetMinBrickCoordinates.X + 1) * (GetMaxBrickCoordinates.Y - GetMinBrickCoordinates.Y + 1));
+	GetMaxNonEmptyBrickZ(MinColumnBrickCoordinates,MaxColumnBrickCoordinates,PreviousHeightMap);
 	{
-		for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y;++RegionY)
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		for(int32 RegionZ = Parameters.MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z;++RegionZ)
 		{
-			for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X;++RegionX)
+			for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y;++RegionY)
 			{
-				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
-				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
-				if(RegionIndex)
+				for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X;++RegionX)
 				{
-					const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
-					const FInt3 MinDirtyRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),GetMinBrickCoordinates - MinRegionBrickCoordinates);
-					const FInt3 MaxDirtyRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),GetMaxBrickCoordinates - MinRegionBrickCoordinates);
-					UpdateMaxNonEmptyBrickMap(Regions[*RegionIndex],MinDirtyRegionBrickCoordinates,MaxDirtyRegionBrickCoordinates);
+					const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+					const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+					if(RegionIndex)
+					{
+						const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+						const FInt3 MinDirtyRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),GetMinBrickCoordinates - MinRegionBrickCoordinates);
+						const FInt3 MaxDirtyRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),GetMaxBrickCoordinates - MinRegionBrickCoordinates);
+						UpdateMaxNonEmptyBrickMap(Regions[*RegionIndex],MinDirtyRegionBrickCoordinates,MaxDirtyRegionBrickCoordinates);
+						UpdateRenderChunkBrickCounts(Regions[*RegionIndex],MinDirtyRegionBrickCoordinates,MaxDirtyRegionBrickCoordinates);
+					}
 				}
 			}
 		}
 	}
 
+	// A column's sky visibility only changes between its previous and new heights, so only update the blurred sky visibility of the bricks in that range
+	// that are within the blur radius of a column whose height changed.
+	TArray<int16> HeightMap;
+	HeightMap.SetNumUninitialized(PreviousHeightMap.Num());
+	GetMaxNonEmptyBrickZ(MinColumnBrickCoordinates,MaxColumnBrickCoordinates,HeightMap);
+	int32 MinDirtyLocalZ = INT_MAX;
+	int32 MaxDirtyLocalZ = INT_MIN;
+	for(int32 ColumnIndex = 0;ColumnIndex < HeightMap.Num();++ColumnIndex)
+	{
+		if(HeightMap[ColumnIndex] != PreviousHeightMap[ColumnIndex])
+		{
+			MinDirtyLocalZ = FMath::Min(MinDirtyLocalZ,FMath::Min<int32>(HeightMap[ColumnIndex],PreviousHeightMap[ColumnIndex]) + 1);
+			MaxDirtyLocalZ = FMath::Max(MaxDirtyLocalZ,FMath::Max<int32>(HeightMap[ColumnIndex],PreviousHeightMap[ColumnIndex]));
+		}
+	}
+	if(MinDirtyLocalZ <= MaxDirtyLocalZ)
+	{
+		const FInt3 BlurExpansionExtent(Parameters.AmbientOcclusionBlurRadius,Parameters.AmbientOcclusionBlurRadius,0);
+		UpdateBlurredSkyVisibility(
+			FInt3(GetMinBrickCoordinates.X,GetMinBrickCoordinates.Y,MinBrickCoordinates.Z + MinDirtyLocalZ) - BlurExpansionExtent,
+			FInt3(GetMaxBrickCoordinates.X,GetMaxBrickCoordinates.Y,MinBrickCoordinates.Z + MaxDirtyLocalZ) + BlurExpansionExtent
+			);
+	}
+
+	// Repropagate the light around the changed bricks. This flags the render chunks whose light changed for an update.
+	UpdateLight(GetMinBrickCoordinates,GetMaxBrickCoordinates);
+
 	// Invalidate render components. Note that because of ambient occlusion, the render chunks need to be invalidated all the way to the bottom of the grid!
 	const FInt3 AmbientOcclusionExpansionExtent = FInt3::Scalar(Parameters.AmbientOcclusionBlurRadius);
-	const FInt3 RenderExpansionExtent = AmbientOcclusionExpansionExtent + FacingExpansionExtent;
+	const FInt3 RenderExpansionExtent = AmbientOcclusionExpansionExtent + DownsampledFacingExpansionExtent;
 	const FInt3 MinRenderChunkCoordinates = BrickToRenderChunkCoordinates(GetMinBrickCoordinates - RenderExpansionExtent);
 	const FInt3 MaxRenderChunkCoordinates = BrickToRenderChunkCoordinates(GetMaxBrickCoordinates + RenderExpansionExtent);
 	for(int32 ChunkX = MinRenderChunkCoordinates.X;ChunkX <= MaxRenderChunkCoordinates.X;++ChunkX)
@@ -324,6 +696,31 @@ void UBrickGridComponent::InvalidateChunkComponents(const FInt3& GetMinBrickCoor
 		}
 	}
 
+	// Invalidate super chunks. Their rebuilds are deferred and spread over multiple frames, since they are far from the viewer.
+	const FInt3 MinSuperChunkCoordinates = BrickToSuperChunkCoordinates(GetMinBrickCoordinates - RenderExpansionExtent);
+	const FInt3 MaxSuperChunkCoordinates = BrickToSuperChunkCoordinates(GetMaxBrickCoordinates + RenderExpansionExtent);
+	for(int32 SuperChunkX = MinSuperChunkCoordinates.X;SuperChunkX <= MaxSuperChunkCoordinates.X;++SuperChunkX)
+	{
+		for(int32 SuperChunkY = MinSuperChunkCoordinates.Y;SuperChunkY <= MaxSuperChunkCoordinates.Y;++SuperChunkY)
+		{
+			for(int32 SuperChunkZ = BrickToSuperChunkCoordinates(MinBrickCoordinates).Z;SuperChunkZ <= MaxSuperChunkCoordinates.Z;++SuperChunkZ)
+			{
+				UBrickRenderComponent* SuperChunkComponent = SuperChunkCoordinatesToComponent.FindRef(FInt3(SuperChunkX,SuperChunkY,SuperChunkZ));
+				if(SuperChunkComponent)
+				{
+					if(SuperChunkZ >= MinSuperChunkCoordinates.Z)
+					{
+						SuperChunkComponent->HasDeferredRebuildPending = true;
+					}
+					else
+					{
+						SuperChunkComponent->HasLowPriorityUpdatePending = true;
+					}
+				}
+			}
+		}
+	}
+
 	// Invalidate collision components.
 	const FInt3 MinCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(GetMinBrickCoordinates - FacingExpansionExtent);
 	const FInt3 MaxCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(GetMaxBrickCoordinates + FacingExpansionExtent);
@@ -347,53 +744,55 @@ void UBrickGridComponent::Update(const FVector& WorldViewPosition,float MaxDrawD
 {
 	const FVector LocalViewPosition = GetComponentTransform().InverseTransformPosition(WorldViewPosition);
 	const float LocalMaxDrawDistance = FMath::Max(0.0f,MaxDrawDistance / GetComponentTransform().GetScale3D().GetMin());
-	const float LocalMaxCollisionDistance = FMath::Max(0.0f,MaxCollisionDistance / GetComponentTransform().GetScale3D().GetMin());
-	const float LocalMaxDrawAndCollisionDistance = FMath::Max(LocalMaxDrawDistance,LocalMaxCollisionDistance);
 
-	const double StartTime = FPlatformTime::Seconds();
+	// Budget the update's work for the game thread, and for the same amount of time on each worker thread.
+	WorkScheduler.BeginUpdate(MaxDesiredUpdateTime,MaxDesiredUpdateTime * FTaskGraphInterface::Get().GetNumWorkerThreads());
 
-	// Initialize any regions that are closer to the viewer than the draw or collision distance.
-	// Include an additional ring of regions around what is being drawn or colliding so it has plenty of frames to spread initialization over before the data is needed.r
-	const FInt3 MinInitRegionCoordinates = FInt3::Max(Parameters.MinRegionCoordinates,BrickToRegionCoordinates(FInt3::Floor(LocalViewPosition - FVector(LocalMaxDrawAndCollisionDistance))) - FInt3::Scalar(1));
-	const FInt3 MaxInitRegionCoordinates = FInt3::Min(Parameters.MaxRegionCoordinates,BrickToRegionCoordinates(FInt3::Ceil(LocalViewPosition + FVector(LocalMaxDrawAndCollisionDistance))) + FInt3::Scalar(1));
-	const float RegionExpansionRadius = BricksPerRegion.ToFloat().GetMin();
-	for(int32 RegionZ = MinInitRegionCoordinates.Z;RegionZ <= MaxInitRegionCoordinates.Z && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++RegionZ)
+	// Move the viewer for the view position, and recompute the interest of any viewers that have moved too far from where it was last computed.
+	if(UpdateViewerId == INDEX_NONE)
+	{
+		UpdateViewerId = NextViewerId++;
+		Viewers.Add(UpdateViewerId,FBrickGridViewer());
+	}
+	// A headless grid only needs regions for gameplay, so it doesn't initialize them out to the draw distance.
+	MoveViewer(Viewers.FindChecked(UpdateViewerId),WorldViewPosition,Parameters.Headless ? 0.0f : MaxDrawDistance,MaxCollisionDistance);
+	const float InterestSlack = GetViewerInterestSlack();
+	for(auto ViewerIt = Viewers.CreateIterator();ViewerIt;++ViewerIt)
 	{
-		for(int32 RegionY = MinInitRegionCoordinates.Y;RegionY <= MaxInitRegionCoordinates.Y && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++RegionY)
+		FBrickGridViewer& Viewer = ViewerIt.Value();
+		if(	!Viewer.IsInterestValid
+		||	FVector::DistSquared(Viewer.LocalPosition,Viewer.InterestPosition) > FMath::Square(InterestSlack)
+		||	FVector::DistSquared(GetViewerPredictedPosition(Viewer),Viewer.InterestPredictedPosition) > FMath::Square(InterestSlack))
 		{
-			for(int32 RegionX = MinInitRegionCoordinates.X;RegionX <= MaxInitRegionCoordinates.X && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++RegionX)
-			{
-				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
-				const FBox RegionBounds((RegionCoordinates * BricksPerRegion).ToFloat(),((RegionCoordinates + FInt3::Scalar(1)) * BricksPerRegion).ToFloat());
-				if(RegionBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) < FMath::Square(LocalMaxDrawAndCollisionDistance + RegionExpansionRadius))
-				{
-					if(!RegionCoordinatesToIndex.Find(RegionCoordinates))
-					{
-						const int32 RegionIndex = Regions.Num();
-						FBrickRegion& Region = *new(Regions) FBrickRegion;
-						Region.Coordinates = RegionCoordinates;
-
-						// Initialize the region's bricks to the empty material.
-						Region.BrickContents.Init(Parameters.EmptyMaterialIndex, 1 << Parameters.BricksPerRegionLog2.SumComponents());
+			UpdateViewerInterest(Viewer);
+		}
+	}
 
-						// Compute the region's non-empty height map.
-						UpdateMaxNonEmptyBrickMap(Region,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+	// Initialize the regions the viewers need, sharing the time budget between them.
+	InitViewerRegions(OnInitRegion);
 
-						// Add the region to the coordinate map.
-						RegionCoordinatesToIndex.Add(RegionCoordinates,RegionIndex);
+	// Create and destroy the render chunks around the view position, unless the grid is headless.
+	if(!Parameters.Headless)
+	{
+		UpdateRenderChunks(LocalViewPosition,LocalMaxDrawDistance);
+	}
 
-						// Call the InitRegion delegate for the new region.
-						OnInitRegion.Execute(RegionCoordinates);
-					}
-				}
-			}
-		}
+	// The viewers' interest creates and destroys the collision components, so just finish the collision body updates that have been built since the last update.
+	for(auto ChunkIt = CollisionChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
+	{
+		ChunkIt.Value()->FinishCollisionBodyUpdate();
 	}
+}
 
+void UBrickGridComponent::UpdateRenderChunks(const FVector& LocalViewPosition,float LocalMaxDrawDistance)
+{
 	// Create render components for any chunks closer to the viewer than the draw distance, and destroy any that are no longer inside the draw distance.
 	// Do this visibility check in 2D so the chunks underneath those on the horizon are also drawn even if they are too far.
 	const FInt3 MinRenderChunkCoordinates = BrickToRenderChunkCoordinates(FInt3::Max(MinBrickCoordinates, FInt3::Floor(LocalViewPosition - FVector(LocalMaxDrawDistance))));
 	const FInt3 MaxRenderChunkCoordinates = BrickToRenderChunkCoordinates(FInt3::Min(MaxBrickCoordinates, FInt3::Ceil(LocalViewPosition + FVector(LocalMaxDrawDistance))));
+
+	// Render chunks and super chunks that replace each other are both kept until the replacement's mesh has been built, so there's no gap in between.
+	TArray<const UBrickRenderComponent*> ReplacementComponents;
 	for (auto ChunkIt = RenderChunkCoordinatesToComponent.CreateIterator(); ChunkIt; ++ChunkIt)
 	{
 		const FInt3 MinChunkBrickCoordinates = ChunkIt.Key() * BricksPerRenderChunk;
@@ -402,18 +801,56 @@ void UBrickGridComponent::Update(const FVector& WorldViewPosition,float MaxDrawD
 			FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MinBrickCoordinates.Z).ToFloat(),
 			FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MaxBrickCoordinates.Z).ToFloat()
 			);
-		if(ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) > FMath::Square(LocalMaxDrawDistance))
+		// A chunk whose super chunk has merged keeps drawing until the super chunk's mesh has been built to replace it.
+		const FInt3 SuperChunkCoordinates = BrickToSuperChunkCoordinates(MinChunkBrickCoordinates);
+		const UBrickRenderComponent* SuperChunkComponent = SuperChunkCoordinatesToComponent.FindRef(SuperChunkCoordinates);
+		const bool IsReplaced = IsSuperChunkMerged(SuperChunkCoordinates,LocalViewPosition) && SuperChunkComponent && SuperChunkComponent->IsMeshBuilt;
+		if(ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) > FMath::Square(LocalMaxDrawDistance) || IsReplaced)
 		{
 			ChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
 			ChunkIt.Value()->DestroyComponent();
 			ChunkIt.RemoveCurrent();
+			if(IsReplaced)
+			{
+				ReplacementComponents.AddUnique(SuperChunkComponent);
+			}
+		}
+	}
+	for (auto SuperChunkIt = SuperChunkCoordinatesToComponent.CreateIterator(); SuperChunkIt; ++SuperChunkIt)
+	{
+		// An unmerged super chunk keeps drawing until the meshes of all its render chunks in the draw distance have been built to replace it.
+		const bool IsReplaced = !IsSuperChunkMerged(SuperChunkIt.Key(),LocalViewPosition) && AreSuperChunkRenderChunksBuilt(SuperChunkIt.Key(),LocalViewPosition,LocalMaxDrawDistance);
+		if(ComputeSuperChunkSquaredDistance(SuperChunkIt.Key(),LocalViewPosition) > FMath::Square(LocalMaxDrawDistance) || IsReplaced)
+		{
+			SuperChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
+			SuperChunkIt.Value()->DestroyComponent();
+			SuperChunkIt.RemoveCurrent();
+			if(IsReplaced)
+			{
+				const FInt3 MinChunkCoordinates = SuperChunkIt.Key() << Parameters.RenderChunksPerSuperChunkLog2;
+				const FInt3 MaxChunkCoordinates = MinChunkCoordinates + FInt3::Exp2(Parameters.RenderChunksPerSuperChunkLog2) - FInt3::Scalar(1);
+				for(auto ChunkIt = RenderChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
+				{
+					if(FInt3::All(ChunkIt.Key() >= MinChunkCoordinates) && FInt3::All(ChunkIt.Key() <= MaxChunkCoordinates))
+					{
+						ReplacementComponents.AddUnique(ChunkIt.Value());
+					}
+				}
+			}
 		}
 	}
-	for(int32 ChunkZ = BrickToRenderChunkCoordinates(MinBrickCoordinates).Z;ChunkZ <= BrickToRenderChunkCoordinates(MaxBrickCoordinates).Z && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++ChunkZ)
+
+	// The neighbors of the destroyed components now face their replacements, so update the seams between them.
+	for(const UBrickRenderComponent* ReplacementComponent : ReplacementComponents)
+	{
+		UpdateRenderChunkSeams(ReplacementComponent,INDEX_NONE);
+	}
+	// Visit every chunk in the draw distance, but only create and rebuild chunks while the work scheduler admits it. The rest is left for later updates.
+	for(int32 ChunkZ = BrickToRenderChunkCoordinates(MinBrickCoordinates).Z;ChunkZ <= BrickToRenderChunkCoordinates(MaxBrickCoordinates).Z;++ChunkZ)
 	{
-		for(int32 ChunkY = MinRenderChunkCoordinates.Y;ChunkY <= MaxRenderChunkCoordinates.Y && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++ChunkY)
+		for(int32 ChunkY = MinRenderChunkCoordinates.Y;ChunkY <= MaxRenderChunkCoordinates.Y;++ChunkY)
 		{
-			for(int32 ChunkX = MinRenderChunkCoordinates.X;ChunkX <= MaxRenderChunkCoordinates.X && (FPlatformTime::Seconds() - StartTime) < MaxDesiredUpdateTime;++ChunkX)
+			for(int32 ChunkX = MinRenderChunkCoordinates.X;ChunkX <= MaxRenderChunkCoordinates.X;++ChunkX)
 			{
 				const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
 				const FInt3 MinChunkBrickCoordinates = ChunkCoordinates * BricksPerRenderChunk;
@@ -422,81 +859,796 @@ void UBrickGridComponent::Update(const FVector& WorldViewPosition,float MaxDrawD
 					FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MinBrickCoordinates.Z).ToFloat(),
 					FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MaxBrickCoordinates.Z).ToFloat()
 					);
-				if(ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) < FMath::Square(LocalMaxDrawDistance))
+				const float ChunkDistanceSquared = ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition);
+				if(ChunkDistanceSquared < FMath::Square(LocalMaxDrawDistance))
 				{
-					UBrickRenderComponent* RenderComponent = RenderChunkCoordinatesToComponent.FindRef(ChunkCoordinates);
+					// Distant chunks are drawn by the super chunk that merges them with their neighbors.
+					const FInt3 SuperChunkCoordinates = BrickToSuperChunkCoordinates(MinChunkBrickCoordinates);
+					const bool IsMerged = IsSuperChunkMerged(SuperChunkCoordinates,LocalViewPosition);
+					const FInt3 ComponentCoordinates = IsMerged ? SuperChunkCoordinates : ChunkCoordinates;
+					TMap<FInt3,UBrickRenderComponent*>& CoordinatesToComponent = IsMerged ? SuperChunkCoordinatesToComponent : RenderChunkCoordinatesToComponent;
+
+					const float ComponentDistance = IsMerged ? FMath::Sqrt(ComputeSuperChunkSquaredDistance(SuperChunkCoordinates,LocalViewPosition)) : FMath::Sqrt(ChunkDistanceSquared);
+					const EBrickGridWork MeshBuildWork = IsMerged ? EBrickGridWork::SuperChunkMeshBuild : EBrickGridWork::RenderChunkMeshBuild;
+					UBrickRenderComponent* RenderComponent = CoordinatesToComponent.FindRef(ComponentCoordinates);
+					const int32 DesiredLOD = GetRenderChunkLODForDistance(ComponentDistance,RenderComponent ? RenderComponent->LOD : INDEX_NONE);
 					if(!RenderComponent)
 					{
+						double CreationChargedSeconds = 0.0;
+						if(!WorkScheduler.Admit(EBrickGridWork::RenderChunkCreation,MeshBuildWork,&CreationChargedSeconds))
+						{
+							continue;
+						}
+
 						// Initialize a new chunk component.
+						const double CreationStartTime = FPlatformTime::Seconds();
 						RenderComponent = NewObject<UBrickRenderComponent>(GetOwner());
 						RenderComponent->Grid = this;
-						RenderComponent->Coordinates = ChunkCoordinates;
+						RenderComponent->Coordinates = ComponentCoordinates;
+						RenderComponent->MergedChunksLog2 = IsMerged ? Parameters.RenderChunksPerSuperChunkLog2 : FInt3::Scalar(0);
+						RenderComponent->LOD = DesiredLOD;
 
 						// Set the component transform and register it.
-						RenderComponent->SetRelativeLocation((ChunkCoordinates * BricksPerRenderChunk).ToFloat());
+						RenderComponent->SetRelativeLocation(RenderComponent->GetMinBrickCoordinates().ToFloat());
 						RenderComponent->AttachToComponent(this,FAttachmentTransformRules(EAttachmentRule::KeepRelative,false));
 						RenderComponent->RegisterComponent();
 
 						// Add the chunk to the coordinate map and visible chunk array.
-						RenderChunkCoordinatesToComponent.Add(ChunkCoordinates,RenderComponent);
+						CoordinatesToComponent.Add(ComponentCoordinates,RenderComponent);
+						UpdateRenderChunkSeams(RenderComponent,INDEX_NONE);
+						WorkScheduler.ReportGameThreadCost(EBrickGridWork::RenderChunkCreation,CreationChargedSeconds,FPlatformTime::Seconds() - CreationStartTime);
+					}
+					else if(RenderComponent->LOD != DesiredLOD && WorkScheduler.Admit(MeshBuildWork))
+					{
+						// Remesh the chunk at its new LOD.
+						const int32 PreviousLOD = RenderComponent->LOD;
+						RenderComponent->LOD = DesiredLOD;
+						RenderComponent->MarkRenderStateDirty();
+						UpdateRenderChunkSeams(RenderComponent,PreviousLOD);
 					}
 
-					// Flush low-priority pending updates to render components.
-					if(RenderComponent->HasLowPriorityUpdatePending)
+					// Rebuild the super chunks whose merged chunks have changed as the worker budget allows.
+					if(RenderComponent->HasDeferredRebuildPending && !RenderComponent->IsRenderStateDirty() && WorkScheduler.Admit(MeshBuildWork))
 					{
 						RenderComponent->MarkRenderStateDirty();
-						RenderComponent->HasLowPriorityUpdatePending = false;
+						RenderComponent->HasDeferredRebuildPending = false;
+					}
+
+					// Flush low-priority pending updates to render components. These only change ambient occlusion, so they don't need to rebuild the chunk's geometry.
+					// If the render state is already dirty, the chunk's geometry will be rebuilt anyway, and that will also update its ambient occlusion.
+					// The ambient occlusion is computed on a worker thread, and uploaded by a later update once it's done.
+					RenderComponent->FinishMeshBuild();
+					RenderComponent->FinishAmbientOcclusionUpdate();
+					if(	RenderComponent->HasLowPriorityUpdatePending
+					&&	!RenderComponent->IsRenderStateDirty()
+					&&	!RenderComponent->IsAmbientOcclusionUpdateInFlight()
+					&&	WorkScheduler.Admit(EBrickGridWork::AmbientOcclusionUpdate))
+					{
+						RenderComponent->UpdateAmbientOcclusion();
 					}
 				}
 			}
 		}
 	}
 
-	// Create collision components for any chunks closer to the viewer than the collision distance, and destroy any that are no longer inside the draw distance.
-	const FInt3 MinCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(FInt3::Max(MinBrickCoordinates, FInt3::Floor(LocalViewPosition - FVector(LocalMaxCollisionDistance))));
-	const FInt3 MaxCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(FInt3::Min(MaxBrickCoordinates, FInt3::Ceil(LocalViewPosition + FVector(LocalMaxCollisionDistance))));
-	const float LocalCollisionChunkRadius = BricksPerCollisionChunk.ToFloat().Size();
-	for (auto ChunkIt = CollisionChunkCoordinatesToComponent.CreateIterator(); ChunkIt; ++ChunkIt)
+	// Cull the render chunks that can't be seen from the viewer's chunk.
+	UpdateCaveCulling(LocalViewPosition,FInt3(MinRenderChunkCoordinates.X,MinRenderChunkCoordinates.Y,BrickToRenderChunkCoordinates(MinBrickCoordinates).Z),FInt3(MaxRenderChunkCoordinates.X,MaxRenderChunkCoordinates.Y,BrickToRenderChunkCoordinates(MaxBrickCoordinates).Z));
+}
+
+int32 UBrickGridComponent::RegisterViewer(const FVector& WorldPosition,float MaxRegionDistance,float MaxCollisionDistance,float Priority)
+{
+	const int32 ViewerId = NextViewerId++;
+	FBrickGridViewer& Viewer = Viewers.Add(ViewerId,FBrickGridViewer());
+	Viewer.Priority = FMath::Max(KINDA_SMALL_NUMBER,Priority);
+	MoveViewer(Viewer,WorldPosition,MaxRegionDistance,MaxCollisionDistance);
+	return ViewerId;
+}
+
+void UBrickGridComponent::UpdateViewer(int32 ViewerId,const FVector& WorldPosition)
+{
+	FBrickGridViewer* Viewer = ViewerId != UpdateViewerId ? Viewers.Find(ViewerId) : NULL;
+	if(Viewer)
 	{
-		const FBox ChunkBounds((ChunkIt.Key() * BricksPerCollisionChunk).ToFloat(),((ChunkIt.Key() + FInt3::Scalar(1)) * BricksPerCollisionChunk).ToFloat());
-		if(	FInt3::Any(ChunkIt.Key() < MinCollisionChunkCoordinates)
-		||	FInt3::Any(ChunkIt.Key() > MaxCollisionChunkCoordinates)
-		||	ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) > FMath::Square(LocalMaxCollisionDistance))
-		{
-			ChunkIt.Value()->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
-			ChunkIt.Value()->DestroyComponent();
-			ChunkIt.RemoveCurrent();
-		}
+		SetViewerPosition(*Viewer,WorldPosition);
 	}
-	for(int32 ChunkZ = MinCollisionChunkCoordinates.Z;ChunkZ <= MaxCollisionChunkCoordinates.Z;++ChunkZ)
-	{
-		for(int32 ChunkY = MinCollisionChunkCoordinates.Y;ChunkY <= MaxCollisionChunkCoordinates.Y;++ChunkY)
+}
+
+void UBrickGridComponent::UnregisterViewer(int32 ViewerId)
+{
+	FBrickGridViewer* Viewer = ViewerId != UpdateViewerId ? Viewers.Find(ViewerId) : NULL;
+	if(Viewer)
+	{
+		for(const FInt3& ChunkCoordinates : Viewer->InterestCollisionChunks)
+		{
+			RemoveCollisionChunkInterest(ChunkCoordinates);
+		}
+		Viewers.Remove(ViewerId);
+	}
+}
+
+void UBrickGridComponent::MoveViewer(FBrickGridViewer& Viewer,const FVector& WorldPosition,float MaxRegionDistance,float MaxCollisionDistance) const
+{
+	const float LocalMaxRegionDistance = FMath::Max(0.0f,MaxRegionDistance / GetComponentTransform().GetScale3D().GetMin());
+	const float LocalMaxCollisionDistance = FMath::Max(0.0f,MaxCollisionDistance / GetComponentTransform().GetScale3D().GetMin());
+	if(LocalMaxRegionDistance != Viewer.LocalMaxRegionDistance || LocalMaxCollisionDistance != Viewer.LocalMaxCollisionDistance)
+	{
+		Viewer.LocalMaxRegionDistance = LocalMaxRegionDistance;
+		Viewer.LocalMaxCollisionDistance = LocalMaxCollisionDistance;
+		Viewer.IsInterestValid = false;
+	}
+	SetViewerPosition(Viewer,WorldPosition);
+}
+
+void UBrickGridComponent::SetViewerPosition(FBrickGridViewer& Viewer,const FVector& WorldPosition) const
+{
+	const FVector LocalPosition = GetComponentTransform().InverseTransformPosition(WorldPosition);
+	const UWorld* World = GetWorld();
+	const double Time = World ? World->GetTimeSeconds() : FPlatformTime::Seconds();
+
+	// Estimate the viewer's velocity from its movement since it was last moved, smoothed over a fraction of a second so a single jittery frame doesn't
+	// swing the prediction. Ignore moves that happen without any time passing, such as several moves in one frame.
+	const double DeltaTime = Time - Viewer.LastMoveTime;
+	if(Viewer.LastMoveTime >= 0.0 && DeltaTime > SMALL_NUMBER)
+	{
+		const float VelocitySmoothingTime = 0.25f;
+		const FVector InstantVelocity = (LocalPosition - Viewer.LocalPosition) / DeltaTime;
+		Viewer.LocalVelocity = FMath::Lerp(Viewer.LocalVelocity,InstantVelocity,1.0f - FMath::Exp(-DeltaTime / VelocitySmoothingTime));
+	}
+	if(Viewer.LastMoveTime < 0.0 || DeltaTime > SMALL_NUMBER)
+	{
+		Viewer.LastMoveTime = Time;
+	}
+	Viewer.LocalPosition = LocalPosition;
+}
+
+FVector UBrickGridComponent::GetViewerPredictedPosition(const FBrickGridViewer& Viewer) const
+{
+	// Don't predict further than the viewer's region distance, so a teleport doesn't make it prefetch across the whole grid.
+	const float MaxPredictionDistance = FMath::Max(Viewer.LocalMaxRegionDistance,Viewer.LocalMaxCollisionDistance);
+	return Viewer.LocalPosition + (Viewer.LocalVelocity * Parameters.PrefetchLookAheadTime).GetClampedToMaxSize(MaxPredictionDistance);
+}
+
+// The path a viewer is predicted to follow during the prefetch look-ahead time, sampled at points spaced no further apart than the interest slack,
+// so a box near any point of the path is also near one of the samples.
+struct FBrickViewerPath
+{
+	FVector Start;
+	FVector Delta;
+	int32 NumSamples;
+
+	FBrickViewerPath(const FVector& InStart,const FVector& End,float MaxSampleSpacing)
+	: Start(InStart)
+	, Delta(End - InStart)
+	{
+		const int32 MaxSamples = 64;
+		NumSamples = FMath::Clamp(FMath::CeilToInt(Delta.Size() / MaxSampleSpacing) + 1,1,MaxSamples);
+	}
+
+	// Returns the distance from a box to the nearest sample of the path. Boxes further along the path are penalized by half the distance along the path to
+	// their nearest sample, so the regions the viewer is about to reach are ranked ahead of the regions it's moving away from, but behind those it's in.
+	float ComputeDistance(const FBox& Bounds,float& OutRankingDistance) const
+	{
+		float MinDistance = FLT_MAX;
+		OutRankingDistance = FLT_MAX;
+		const float PathLength = Delta.Size();
+		for(int32 SampleIndex = 0;SampleIndex < NumSamples;++SampleIndex)
+		{
+			const float Fraction = NumSamples > 1 ? float(SampleIndex) / float(NumSamples - 1) : 0.0f;
+			const float Distance = FMath::Sqrt(Bounds.ComputeSquaredDistanceToPoint(Start + Delta * Fraction));
+			MinDistance = FMath::Min(MinDistance,Distance);
+			OutRankingDistance = FMath::Min(OutRankingDistance,Distance + 0.5f * Fraction * PathLength);
+		}
+		return MinDistance;
+	}
+
+	// Returns the bounds of the points within a distance of the path.
+	FBox GetBounds(float Distance) const
+	{
+		const FVector End = Start + Delta;
+		return FBox(Start.ComponentMin(End) - FVector(Distance),Start.ComponentMax(End) + FVector(Distance));
+	}
+};
+
+void UBrickGridComponent::UpdateViewerInterest(FBrickGridViewer& Viewer)
+{
+	// Compute the interest for distances expanded by the slack, so it stays valid until the viewer moves further than the slack from this position.
+	// The interest also covers the path the viewer is predicted to follow, so a fast moving viewer's regions and collision chunks are created before it reaches them.
+	const float InterestSlack = GetViewerInterestSlack();
+	const FVector LocalPosition = Viewer.LocalPosition;
+	Viewer.InterestPosition = LocalPosition;
+	Viewer.InterestPredictedPosition = GetViewerPredictedPosition(Viewer);
+	Viewer.IsInterestValid = true;
+	const FBrickViewerPath Path(LocalPosition,Viewer.InterestPredictedPosition,InterestSlack);
+
+	// Find the regions that are closer to the viewer's path than its region or collision distance and haven't been initialized yet.
+	// Include an additional ring of regions around what is needed so there are plenty of frames to spread initialization over before the data is needed.
+	struct FPendingRegion
+	{
+		FInt3 Coordinates;
+		float RankingDistance;
+	};
+	TArray<FPendingRegion> PendingRegions;
+	const float RegionExpansionRadius = BricksPerRegion.ToFloat().GetMin();
+	const float LocalRegionDistance = FMath::Max(Viewer.LocalMaxRegionDistance,Viewer.LocalMaxCollisionDistance) + InterestSlack;
+	const FBox RegionPathBounds = Path.GetBounds(LocalRegionDistance);
+	const FInt3 MinInitRegionCoordinates = FInt3::Max(Parameters.MinRegionCoordinates,BrickToRegionCoordinates(FInt3::Floor(RegionPathBounds.Min)) - FInt3::Scalar(1));
+	const FInt3 MaxInitRegionCoordinates = FInt3::Min(Parameters.MaxRegionCoordinates,BrickToRegionCoordinates(FInt3::Ceil(RegionPathBounds.Max)) + FInt3::Scalar(1));
+	for(int32 RegionZ = MinInitRegionCoordinates.Z;RegionZ <= MaxInitRegionCoordinates.Z;++RegionZ)
+	{
+		for(int32 RegionY = MinInitRegionCoordinates.Y;RegionY <= MaxInitRegionCoordinates.Y;++RegionY)
+		{
+			for(int32 RegionX = MinInitRegionCoordinates.X;RegionX <= MaxInitRegionCoordinates.X;++RegionX)
+			{
+				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+				const FBox RegionBounds((RegionCoordinates * BricksPerRegion).ToFloat(),((RegionCoordinates + FInt3::Scalar(1)) * BricksPerRegion).ToFloat());
+				if(!RegionCoordinatesToIndex.Find(RegionCoordinates))
+				{
+					FPendingRegion PendingRegion;
+					PendingRegion.Coordinates = RegionCoordinates;
+					if(Path.ComputeDistance(RegionBounds,PendingRegion.RankingDistance) < LocalRegionDistance + RegionExpansionRadius)
+					{
+						PendingRegions.Add(PendingRegion);
+					}
+				}
+			}
+		}
+	}
+
+	// Sort the regions from last to first needed, so the first needed can be popped off the end first.
+	PendingRegions.Sort([](const FPendingRegion& A,const FPendingRegion& B) { return A.RankingDistance > B.RankingDistance; });
+	Viewer.PendingRegions.Reset(PendingRegions.Num());
+	for(const FPendingRegion& PendingRegion : PendingRegions)
+	{
+		Viewer.PendingRegions.Add(PendingRegion.Coordinates);
+	}
+
+	// Find the collision chunks that are closer to the viewer's path than its collision distance.
+	TArray<FInt3> InterestCollisionChunks;
+	const float LocalCollisionDistance = Viewer.LocalMaxCollisionDistance + InterestSlack;
+	const FBox CollisionPathBounds = Path.GetBounds(LocalCollisionDistance);
+	const FInt3 MinCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(FInt3::Max(MinBrickCoordinates,FInt3::Floor(CollisionPathBounds.Min)));
+	const FInt3 MaxCollisionChunkCoordinates = BrickToCollisionChunkCoordinates(FInt3::Min(MaxBrickCoordinates,FInt3::Ceil(CollisionPathBounds.Max)));
+	if(Viewer.LocalMaxCollisionDistance > 0.0f)
+	{
+		for(int32 ChunkZ = MinCollisionChunkCoordinates.Z;ChunkZ <= MaxCollisionChunkCoordinates.Z;++ChunkZ)
+		{
+			for(int32 ChunkY = MinCollisionChunkCoordinates.Y;ChunkY <= MaxCollisionChunkCoordinates.Y;++ChunkY)
+			{
+				for(int32 ChunkX = MinCollisionChunkCoordinates.X;ChunkX <= MaxCollisionChunkCoordinates.X;++ChunkX)
+				{
+					const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
+					const FBox ChunkBounds((ChunkCoordinates * BricksPerCollisionChunk).ToFloat(),((ChunkCoordinates + FInt3::Scalar(1)) * BricksPerCollisionChunk).ToFloat());
+					float RankingDistance;
+					if(Path.ComputeDistance(ChunkBounds,RankingDistance) < LocalCollisionDistance)
+					{
+						InterestCollisionChunks.Add(ChunkCoordinates);
+					}
+				}
+			}
+		}
+	}
+
+	// Add the new interest before removing the old, so the chunks the viewer still needs aren't destroyed and recreated.
+	for(const FInt3& ChunkCoordinates : InterestCollisionChunks)
+	{
+		AddCollisionChunkInterest(ChunkCoordinates);
+	}
+	for(const FInt3& ChunkCoordinates : Viewer.InterestCollisionChunks)
+	{
+		RemoveCollisionChunkInterest(ChunkCoordinates);
+	}
+	Viewer.InterestCollisionChunks = MoveTemp(InterestCollisionChunks);
+}
+
+void UBrickGridComponent::AddCollisionChunkInterest(const FInt3& ChunkCoordinates)
+{
+	int32& InterestCount = CollisionChunkInterestCounts.FindOrAdd(ChunkCoordinates);
+	if(InterestCount++ == 0)
+	{
+		// Collision chunks are needed for gameplay, so they're always created immediately, but their cost is charged to the update's budget.
+		const double CreationStartTime = FPlatformTime::Seconds();
+
+		// Initialize a new chunk component.
+		UBrickCollisionComponent* Chunk = NewObject<UBrickCollisionComponent>(GetOwner());
+		Chunk->Grid = this;
+		Chunk->Coordinates = ChunkCoordinates;
+
+		// Set the component transform and register it.
+		Chunk->SetRelativeLocation((ChunkCoordinates * BricksPerCollisionChunk).ToFloat());
+		Chunk->AttachToComponent(this,FAttachmentTransformRules(EAttachmentRule::KeepRelative,false));
+		Chunk->RegisterComponent();
+
+		// Add the chunk to the coordinate map.
+		CollisionChunkCoordinatesToComponent.Add(ChunkCoordinates,Chunk);
+		WorkScheduler.ReportGameThreadCost(EBrickGridWork::CollisionChunkCreation,0.0,FPlatformTime::Seconds() - CreationStartTime);
+	}
+}
+
+void UBrickGridComponent::RemoveCollisionChunkInterest(const FInt3& ChunkCoordinates)
+{
+	int32* InterestCount = CollisionChunkInterestCounts.Find(ChunkCoordinates);
+	check(InterestCount && *InterestCount > 0);
+	if(--*InterestCount == 0)
+	{
+		CollisionChunkInterestCounts.Remove(ChunkCoordinates);
+
+		UBrickCollisionComponent* Chunk = CollisionChunkCoordinatesToComponent.FindRef(ChunkCoordinates);
+		if(Chunk)
+		{
+			Chunk->DetachFromComponent(FDetachmentTransformRules(EDetachmentRule::KeepRelative,false));
+			Chunk->DestroyComponent();
+			CollisionChunkCoordinatesToComponent.Remove(ChunkCoordinates);
+		}
+	}
+}
+
+void UBrickGridComponent::InitViewerRegions(FBrickGrid_InitRegion OnInitRegion)
+{
+	// Rebase the weighted initialization times so the viewers that are waiting for regions start from zero, and the idle viewers are reset to zero.
+	// This keeps a viewer from banking time while it's idle, and then starving the others when it starts waiting for regions.
+	double MinWeightedInitTime = DBL_MAX;
+	for(auto ViewerIt = Viewers.CreateConstIterator();ViewerIt;++ViewerIt)
+	{
+		if(ViewerIt.Value().PendingRegions.Num())
+		{
+			MinWeightedInitTime = FMath::Min(MinWeightedInitTime,ViewerIt.Value().WeightedInitTime);
+		}
+	}
+	for(auto ViewerIt = Viewers.CreateIterator();ViewerIt;++ViewerIt)
+	{
+		FBrickGridViewer& Viewer = ViewerIt.Value();
+		Viewer.WeightedInitTime = Viewer.PendingRegions.Num() ? Viewer.WeightedInitTime - MinWeightedInitTime : 0.0;
+	}
+
+	while(true)
+	{
+		// Find the waiting viewer that has been served the least.
+		FBrickGridViewer* NextViewer = NULL;
+		for(auto ViewerIt = Viewers.CreateIterator();ViewerIt;++ViewerIt)
+		{
+			FBrickGridViewer& Viewer = ViewerIt.Value();
+			if(Viewer.PendingRegions.Num() && (!NextViewer || Viewer.WeightedInitTime < NextViewer->WeightedInitTime))
+			{
+				NextViewer = &Viewer;
+			}
+		}
+		if(!NextViewer)
+		{
+			break;
+		}
+
+		// Initialize its nearest pending region, unless another viewer already needed it, and charge it for the time.
+		// Stop once the work scheduler predicts that another region won't fit in the update's budget.
+		const FInt3 RegionCoordinates = NextViewer->PendingRegions.Last();
+		if(!RegionCoordinatesToIndex.Find(RegionCoordinates))
+		{
+			double RegionChargedSeconds = 0.0;
+			if(!WorkScheduler.Admit(EBrickGridWork::RegionInit,&RegionChargedSeconds))
+			{
+				break;
+			}
+			const double RegionStartTime = FPlatformTime::Seconds();
+			CreateRegion(RegionCoordinates,OnInitRegion);
+			const double RegionSeconds = FPlatformTime::Seconds() - RegionStartTime;
+			WorkScheduler.ReportGameThreadCost(EBrickGridWork::RegionInit,RegionChargedSeconds,RegionSeconds);
+			NextViewer->WeightedInitTime += RegionSeconds / NextViewer->Priority;
+		}
+		NextViewer->PendingRegions.Pop(false);
+	}
+}
+
+void UBrickGridComponent::CreateRegion(const FInt3& RegionCoordinates,FBrickGrid_InitRegion OnInitRegion)
+{
+	{
+		// Adding the region may reallocate the region array, so don't let any render chunk tasks read it until the region is added.
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		const int32 RegionIndex = Regions.Num();
+		FBrickRegion& Region = *new(Regions) FBrickRegion;
+		Region.Coordinates = RegionCoordinates;
+
+		// Initialize the region's bricks to the empty material.
+		Region.BrickContents.Init(Parameters.EmptyMaterialIndex, 1 << Parameters.BricksPerRegionLog2.SumComponents());
+
+		// Compute the region's non-empty height map and render chunk brick counts.
+		UpdateMaxNonEmptyBrickMap(Region,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+		UpdateRenderChunkBrickCounts(Region,FInt3::Scalar(0),BricksPerRegion - FInt3::Scalar(1));
+
+		// Add the region to the coordinate map.
+		RegionCoordinatesToIndex.Add(RegionCoordinates,RegionIndex);
+	}
+
+	// Compute the region's blurred sky visibility. The region is empty, so it doesn't change the sky visibility of any other region.
+	UpdateBlurredSkyVisibility(RegionCoordinates * BricksPerRegion,RegionCoordinates * BricksPerRegion + BricksPerRegion - FInt3::Scalar(1));
+
+	// Call the InitRegion delegate for the new region.
+	OnInitRegion.Execute(RegionCoordinates);
+
+	// Light the region once its bricks are initialized.
+	if(Parameters.EnableLightPropagation)
+	{
+		TArray<FInt3> NewRegionCoordinates;
+		NewRegionCoordinates.Add(RegionCoordinates);
+		RelightRegions(NewRegionCoordinates);
+	}
+}
+
+FBox UBrickGridComponent::WorldToLocalBox(const FBox& WorldBox) const
+{
+	const FVector LocalCornerA = GetComponentTransform().InverseTransformPosition(WorldBox.Min);
+	const FVector LocalCornerB = GetComponentTransform().InverseTransformPosition(WorldBox.Max);
+	return FBox(LocalCornerA.ComponentMin(LocalCornerB),LocalCornerA.ComponentMax(LocalCornerB));
+}
+
+bool UBrickGridComponent::IsAnyBrickSolid(const FInt3& QueryMinBrickCoordinates,const FInt3& QueryMaxBrickCoordinates) const
+{
+	// Bricks above the grid are empty, and bricks below it or beyond its sides are solid.
+	const FInt3 ClampedMaxBrickCoordinates(QueryMaxBrickCoordinates.X,QueryMaxBrickCoordinates.Y,FMath::Min(QueryMaxBrickCoordinates.Z,MaxBrickCoordinates.Z));
+	if(FInt3::Any(QueryMinBrickCoordinates > ClampedMaxBrickCoordinates))
+	{
+		return false;
+	}
+	if(FInt3::Any(QueryMinBrickCoordinates < MinBrickCoordinates) || FInt3::Any(ClampedMaxBrickCoordinates > MaxBrickCoordinates))
+	{
+		return true;
+	}
+
+	const FInt3 MinRegionCoordinates = BrickToRegionCoordinates(QueryMinBrickCoordinates);
+	const FInt3 MaxRegionCoordinates = BrickToRegionCoordinates(ClampedMaxBrickCoordinates);
+	for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y;++RegionY)
+	{
+		for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X;++RegionX)
 		{
-			for(int32 ChunkX = MinCollisionChunkCoordinates.X;ChunkX <= MaxCollisionChunkCoordinates.X;++ChunkX)
+			for(int32 RegionZ = MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z;++RegionZ)
+			{
+				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+				if(!RegionIndex)
+				{
+					return true;
+				}
+				const FBrickRegion& Region = Regions[*RegionIndex];
+				const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+				const FInt3 MinQueryRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),QueryMinBrickCoordinates - MinRegionBrickCoordinates);
+				const FInt3 MaxQueryRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),ClampedMaxBrickCoordinates - MinRegionBrickCoordinates);
+				for(int32 RegionBrickY = MinQueryRegionBrickCoordinates.Y;RegionBrickY <= MaxQueryRegionBrickCoordinates.Y;++RegionBrickY)
+				{
+					for(int32 RegionBrickX = MinQueryRegionBrickCoordinates.X;RegionBrickX <= MaxQueryRegionBrickCoordinates.X;++RegionBrickX)
+					{
+						const uint32 RegionBaseBrickIndex = SubregionBrickCoordinatesToRegionBrickIndex(FInt3(RegionBrickX,RegionBrickY,MinQueryRegionBrickCoordinates.Z));
+						for(int32 RegionBrickZ = MinQueryRegionBrickCoordinates.Z;RegionBrickZ <= MaxQueryRegionBrickCoordinates.Z;++RegionBrickZ)
+						{
+							if(Region.BrickContents[RegionBaseBrickIndex + RegionBrickZ - MinQueryRegionBrickCoordinates.Z] != Parameters.EmptyMaterialIndex)
+							{
+								return true;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+// The tolerance used to decide whether a box overlaps a brick, in bricks. Boxes that only touch a brick's face don't overlap it.
+static const float BrickOverlapTolerance = 0.0001f;
+
+// The distance a swept box is kept from the brick faces it is stopped against, in bricks. It must be larger than BrickOverlapTolerance.
+static const float BrickSweepSkinWidth = 0.001f;
+
+bool UBrickGridComponent::OverlapBox(const FBox& WorldBox) const
+{
+	const FBox LocalBox = WorldToLocalBox(WorldBox);
+	return IsAnyBrickSolid(
+		FInt3::Floor(LocalBox.Min + FVector(BrickOverlapTolerance)),
+		FInt3::Ceil(LocalBox.Max - FVector(BrickOverlapTolerance)) - FInt3::Scalar(1)
+		);
+}
+
+FVector UBrickGridComponent::SweepBox(const FBox& WorldBox,const FVector& WorldDelta,FVector& OutHitNormal) const
+{
+	FBox LocalBox = WorldToLocalBox(WorldBox);
+	const FVector LocalDelta = GetComponentTransform().InverseTransformVector(WorldDelta);
+	FVector LocalMovedDelta = FVector::ZeroVector;
+	FVector LocalHitNormal = FVector::ZeroVector;
+
+	// Move along Z first, so a box moving down onto the ground doesn't catch on the bricks beside it.
+	const int32 AxisOrder[3] = { 2, 0, 1 };
+	for(const int32 Axis : AxisOrder)
+	{
+		float AxisDelta = LocalDelta[Axis];
+		if(AxisDelta == 0.0f)
+		{
+			continue;
+		}
+
+		// Step through the layers of bricks that the leading face of the box enters, and stop at the first layer with a solid brick in the box's cross section.
+		FInt3 MinLayerBrickCoordinates = FInt3::Floor(LocalBox.Min + FVector(BrickOverlapTolerance));
+		FInt3 MaxLayerBrickCoordinates = FInt3::Ceil(LocalBox.Max - FVector(BrickOverlapTolerance)) - FInt3::Scalar(1);
+		const bool IsPositive = AxisDelta > 0.0f;
+		const int32 FirstLayer = IsPositive ? FMath::CeilToInt(LocalBox.Max[Axis] - BrickOverlapTolerance) : FMath::FloorToInt(LocalBox.Min[Axis] + BrickOverlapTolerance) - 1;
+		const int32 LastLayer = IsPositive ? FMath::CeilToInt(LocalBox.Max[Axis] + AxisDelta) - 1 : FMath::FloorToInt(LocalBox.Min[Axis] + AxisDelta);
+		const int32 LayerStep = IsPositive ? 1 : -1;
+		for(int32 Layer = FirstLayer;IsPositive ? Layer <= LastLayer : Layer >= LastLayer;Layer += LayerStep)
+		{
+			MinLayerBrickCoordinates[Axis] = MaxLayerBrickCoordinates[Axis] = Layer;
+			if(IsAnyBrickSolid(MinLayerBrickCoordinates,MaxLayerBrickCoordinates))
+			{
+				AxisDelta = IsPositive
+					? FMath::Max(0.0f,Layer - BrickSweepSkinWidth - LocalBox.Max[Axis])
+					: FMath::Min(0.0f,Layer + 1 + BrickSweepSkinWidth - LocalBox.Min[Axis]);
+				LocalHitNormal[Axis] = IsPositive ? -1.0f : +1.0f;
+				break;
+			}
+		}
+
+		LocalBox.Min[Axis] += AxisDelta;
+		LocalBox.Max[Axis] += AxisDelta;
+		LocalMovedDelta[Axis] = AxisDelta;
+	}
+
+	OutHitNormal = GetComponentTransform().TransformVectorNoScale(LocalHitNormal);
+	return GetComponentTransform().TransformVector(LocalMovedDelta);
+}
+
+int32 UBrickGridComponent::GetMinRenderLOD(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,int32 DefaultLOD) const
+{
+	int32 MinLOD = INT_MAX;
+	const FInt3 MinChunkCoordinates = BrickToRenderChunkCoordinates(GetMinBrickCoordinates);
+	const FInt3 MaxChunkCoordinates = BrickToRenderChunkCoordinates(GetMaxBrickCoordinates);
+	for(int32 ChunkY = MinChunkCoordinates.Y;ChunkY <= MaxChunkCoordinates.Y;++ChunkY)
+	{
+		for(int32 ChunkX = MinChunkCoordinates.X;ChunkX <= MaxChunkCoordinates.X;++ChunkX)
+		{
+			for(int32 ChunkZ = MinChunkCoordinates.Z;ChunkZ <= MaxChunkCoordinates.Z;++ChunkZ)
 			{
 				const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
-				const FBox ChunkBounds((ChunkCoordinates * BricksPerCollisionChunk).ToFloat(),((ChunkCoordinates + FInt3::Scalar(1)) * BricksPerCollisionChunk).ToFloat());
-				if(ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) < FMath::Square(LocalMaxCollisionDistance))
+				const UBrickRenderComponent* RenderComponent = RenderChunkCoordinatesToComponent.FindRef(ChunkCoordinates);
+				if(!RenderComponent)
+				{
+					RenderComponent = SuperChunkCoordinatesToComponent.FindRef(FInt3::SignedShiftRight(ChunkCoordinates,Parameters.RenderChunksPerSuperChunkLog2));
+				}
+				if(RenderComponent)
+				{
+					MinLOD = FMath::Min(MinLOD,RenderComponent->LOD);
+				}
+			}
+		}
+	}
+	return MinLOD == INT_MAX ? DefaultLOD : MinLOD;
+}
+
+void UBrickGridComponent::GetLowerResolutionSeams(const UBrickRenderComponent* RenderComponent,TArray<FBrickRenderSeam>& OutSeams) const
+{
+	const FInt3 MinComponentBrickCoordinates = RenderComponent->GetMinBrickCoordinates();
+	const FInt3 MaxComponentBrickCoordinates = MinComponentBrickCoordinates + RenderComponent->GetBricksDim() - FInt3::Scalar(1);
+	for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+	{
+		// Find the chunks covering the layer of bricks adjacent to this side of the component. A super chunk covers several of them, but only adds one seam.
+		FInt3 MinNeighborBrickCoordinates;
+		FInt3 MaxNeighborBrickCoordinates;
+		GetFaceAdjacentBricks(MinComponentBrickCoordinates,MaxComponentBrickCoordinates,FaceIndex,MinNeighborBrickCoordinates,MaxNeighborBrickCoordinates);
+		const FInt3 MinNeighborChunkCoordinates = BrickToRenderChunkCoordinates(MinNeighborBrickCoordinates);
+		const FInt3 MaxNeighborChunkCoordinates = BrickToRenderChunkCoordinates(MaxNeighborBrickCoordinates);
+		TArray<const UBrickRenderComponent*,TInlineAllocator<4>> FaceNeighborComponents;
+		for(int32 ChunkY = MinNeighborChunkCoordinates.Y;ChunkY <= MaxNeighborChunkCoordinates.Y;++ChunkY)
+		{
+			for(int32 ChunkX = MinNeighborChunkCoordinates.X;ChunkX <= MaxNeighborChunkCoordinates.X;++ChunkX)
+			{
+				for(int32 ChunkZ = MinNeighborChunkCoordinates.Z;ChunkZ <= MaxNeighborChunkCoordinates.Z;++ChunkZ)
 				{
-					if(!CollisionChunkCoordinatesToComponent.FindRef(ChunkCoordinates))
+					const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
+					const UBrickRenderComponent* NeighborComponent = RenderChunkCoordinatesToComponent.FindRef(ChunkCoordinates);
+					if(!NeighborComponent)
 					{
-						// Initialize a new chunk component.
-						UBrickCollisionComponent* Chunk = NewObject<UBrickCollisionComponent>(GetOwner());
-						Chunk->Grid = this;
-						Chunk->Coordinates = ChunkCoordinates;
+						NeighborComponent = SuperChunkCoordinatesToComponent.FindRef(FInt3::SignedShiftRight(ChunkCoordinates,Parameters.RenderChunksPerSuperChunkLog2));
+					}
+					if(NeighborComponent && NeighborComponent->LOD > RenderComponent->LOD && !FaceNeighborComponents.Contains(NeighborComponent))
+					{
+						FaceNeighborComponents.Add(NeighborComponent);
+						const FInt3 MinNeighborComponentBrickCoordinates = NeighborComponent->GetMinBrickCoordinates();
+						FBrickRenderSeam& Seam = *new(OutSeams) FBrickRenderSeam;
+						Seam.FaceIndex = FaceIndex;
+						Seam.MinBrickCoordinates = FInt3::Max(MinNeighborBrickCoordinates,MinNeighborComponentBrickCoordinates);
+						Seam.MaxBrickCoordinates = FInt3::Min(MaxNeighborBrickCoordinates,MinNeighborComponentBrickCoordinates + NeighborComponent->GetBricksDim() - FInt3::Scalar(1));
+						Seam.LOD = NeighborComponent->LOD;
+					}
+				}
+			}
+		}
+	}
+}
 
-						// Set the component transform and register it.
-						Chunk->SetRelativeLocation((ChunkCoordinates * BricksPerCollisionChunk).ToFloat());
-						Chunk->AttachToComponent(this,FAttachmentTransformRules(EAttachmentRule::KeepRelative,false));
-						Chunk->RegisterComponent();
+void UBrickGridComponent::UpdateCaveCulling(const FVector& LocalViewPosition,const FInt3& MinVisibleChunkCoordinates,const FInt3& MaxVisibleChunkCoordinates)
+{
+	if(!Parameters.EnableCaveCulling)
+	{
+		for(auto ChunkIt = RenderChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
+		{
+			ChunkIt.Value()->SetCaveCulled(false);
+		}
+		return;
+	}
 
-						// Add the chunk to the coordinate map and visible chunk array.
-						CollisionChunkCoordinatesToComponent.Add(ChunkCoordinates,Chunk);
+	// Walk the chunks breadth-first from the viewer's chunk. A chunk may be left through a face if the chunk's connectivity joins it to the face it was entered through,
+	// and the walk never steps in the opposite direction of a step it has already taken, so it only moves away from the viewer.
+	// If the viewer is above or below the grid, start from the whole layer of chunks nearest to it.
+	struct FCaveCullingStep
+	{
+		FInt3 ChunkCoordinates;
+		int32 EntryFaceIndex;
+		uint32 TraveledFaceMask;
+	};
+	const FInt3 VisibleChunksDim = MaxVisibleChunkCoordinates - MinVisibleChunkCoordinates + FInt3::Scalar(1);
+	TArray<bool> VisitedChunks;
+	VisitedChunks.SetNumZeroed(VisibleChunksDim.X * VisibleChunksDim.Y * VisibleChunksDim.Z);
+	TArray<FCaveCullingStep> Queue;
+	const FInt3 ViewChunkCoordinates = BrickToRenderChunkCoordinates(FInt3::Floor(LocalViewPosition));
+	const FInt3 StartChunkCoordinates = FInt3::Clamp(ViewChunkCoordinates,MinVisibleChunkCoordinates,MaxVisibleChunkCoordinates);
+	const bool IsViewerOutsideGrid = ViewChunkCoordinates.Z != StartChunkCoordinates.Z;
+	for(int32 ChunkY = IsViewerOutsideGrid ? MinVisibleChunkCoordinates.Y : StartChunkCoordinates.Y;ChunkY <= (IsViewerOutsideGrid ? MaxVisibleChunkCoordinates.Y : StartChunkCoordinates.Y);++ChunkY)
+	{
+		for(int32 ChunkX = IsViewerOutsideGrid ? MinVisibleChunkCoordinates.X : StartChunkCoordinates.X;ChunkX <= (IsViewerOutsideGrid ? MaxVisibleChunkCoordinates.X : StartChunkCoordinates.X);++ChunkX)
+		{
+			const FInt3 ChunkCoordinates(ChunkX,ChunkY,StartChunkCoordinates.Z);
+			const FInt3 VisibleChunkCoordinates = ChunkCoordinates - MinVisibleChunkCoordinates;
+			VisitedChunks[(VisibleChunkCoordinates.Y * VisibleChunksDim.X + VisibleChunkCoordinates.X) * VisibleChunksDim.Z + VisibleChunkCoordinates.Z] = true;
+			Queue.Add({ChunkCoordinates,INDEX_NONE,0});
+		}
+	}
+	for(int32 QueueIndex = 0;QueueIndex < Queue.Num();++QueueIndex)
+	{
+		const FCaveCullingStep Step = Queue[QueueIndex];
+
+		// Chunks that don't have a render component yet, or are drawn by a super chunk, are assumed to connect all their faces.
+		const UBrickRenderComponent* RenderComponent = RenderChunkCoordinatesToComponent.FindRef(Step.ChunkCoordinates);
+		const uint32 FaceConnectivity = RenderComponent ? RenderComponent->FaceConnectivity : BrickMesher::AllFacesConnected;
+
+		for(int32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+		{
+			const FInt3 NeighborChunkCoordinates = Step.ChunkCoordinates + FaceNormals[FaceIndex];
+			if(	(Step.TraveledFaceMask & (1 << (FaceIndex ^ 1)))
+			||	FInt3::Any(NeighborChunkCoordinates < MinVisibleChunkCoordinates)
+			||	FInt3::Any(NeighborChunkCoordinates > MaxVisibleChunkCoordinates)
+			||	(Step.EntryFaceIndex != INDEX_NONE && (FaceIndex == Step.EntryFaceIndex || !(FaceConnectivity & BrickMesher::GetFacePairBit(Step.EntryFaceIndex,FaceIndex)))))
+			{
+				continue;
+			}
+
+			const FInt3 VisibleNeighborCoordinates = NeighborChunkCoordinates - MinVisibleChunkCoordinates;
+			bool& IsNeighborVisited = VisitedChunks[(VisibleNeighborCoordinates.Y * VisibleChunksDim.X + VisibleNeighborCoordinates.X) * VisibleChunksDim.Z + VisibleNeighborCoordinates.Z];
+			if(!IsNeighborVisited)
+			{
+				IsNeighborVisited = true;
+				Queue.Add({NeighborChunkCoordinates,FaceIndex ^ 1,Step.TraveledFaceMask | (1 << FaceIndex)});
+			}
+		}
+	}
+
+	// Cull the render chunks that weren't reached.
+	for(auto ChunkIt = RenderChunkCoordinatesToComponent.CreateConstIterator();ChunkIt;++ChunkIt)
+	{
+		const FInt3 VisibleChunkCoordinates = ChunkIt.Key() - MinVisibleChunkCoordinates;
+		const bool IsVisible =
+				FInt3::Any(ChunkIt.Key() < MinVisibleChunkCoordinates)
+			||	FInt3::Any(ChunkIt.Key() > MaxVisibleChunkCoordinates)
+			||	VisitedChunks[(VisibleChunkCoordinates.Y * VisibleChunksDim.X + VisibleChunkCoordinates.X) * VisibleChunksDim.Z + VisibleChunkCoordinates.Z];
+		ChunkIt.Value()->SetCaveCulled(!IsVisible);
+	}
+}
+
+int32 UBrickGridComponent::GetRenderChunkLODForDistance(float LocalDistance,int32 CurrentLOD) const
+{
+	int32 LOD = 0;
+	for(float LODDistance = Parameters.RenderChunkLODDistance;LOD < Parameters.MaxRenderChunkLOD;LODDistance *= 2.0f)
+	{
+		// The chunk uses a coarser LOD than LOD beyond LODDistance. Move the distance out by the hysteresis if the chunk is currently at LOD or finer,
+		// and in by the hysteresis if it's currently coarser, so it has to move past the distance by the hysteresis to switch.
+		const float Hysteresis = CurrentLOD == INDEX_NONE ? 0.0f : CurrentLOD > LOD ? -Parameters.RenderChunkLODHysteresis : Parameters.RenderChunkLODHysteresis;
+		if(LocalDistance <= LODDistance + Hysteresis)
+		{
+			break;
+		}
+		++LOD;
+	}
+	return LOD;
+}
+
+void UBrickGridComponent::UpdateRenderChunkSeams(const UBrickRenderComponent* RenderComponent,int32 PreviousLOD)
+{
+	// Render chunks seal the sides that face a neighbor with a lower LOD, and mesh the sides that face a neighbor with a higher LOD against the neighbor's
+	// downsampled bricks. All six sides are considered: the chunks in a column are at the same distance, but with LOD hysteresis a chunk created later may pick a different LOD than the rest of its column.
+	const FInt3 MinComponentBrickCoordinates = RenderComponent->GetMinBrickCoordinates();
+	const FInt3 MaxComponentBrickCoordinates = MinComponentBrickCoordinates + RenderComponent->GetBricksDim() - FInt3::Scalar(1);
+	for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+	{
+		// Find the chunks covering the layer of bricks adjacent to this side of the component.
+		FInt3 MinNeighborBrickCoordinates;
+		FInt3 MaxNeighborBrickCoordinates;
+		GetFaceAdjacentBricks(MinComponentBrickCoordinates,MaxComponentBrickCoordinates,FaceIndex,MinNeighborBrickCoordinates,MaxNeighborBrickCoordinates);
+		const FInt3 MinNeighborChunkCoordinates = BrickToRenderChunkCoordinates(MinNeighborBrickCoordinates);
+		const FInt3 MaxNeighborChunkCoordinates = BrickToRenderChunkCoordinates(MaxNeighborBrickCoordinates);
+		for(int32 ChunkY = MinNeighborChunkCoordinates.Y;ChunkY <= MaxNeighborChunkCoordinates.Y;++ChunkY)
+		{
+			for(int32 ChunkX = MinNeighborChunkCoordinates.X;ChunkX <= MaxNeighborChunkCoordinates.X;++ChunkX)
+			{
+				for(int32 ChunkZ = MinNeighborChunkCoordinates.Z;ChunkZ <= MaxNeighborChunkCoordinates.Z;++ChunkZ)
+				{
+					const FInt3 ChunkCoordinates(ChunkX,ChunkY,ChunkZ);
+					UBrickRenderComponent* NeighborComponent = RenderChunkCoordinatesToComponent.FindRef(ChunkCoordinates);
+					if(!NeighborComponent)
+					{
+						NeighborComponent = SuperChunkCoordinatesToComponent.FindRef(FInt3::SignedShiftRight(ChunkCoordinates,Parameters.RenderChunksPerSuperChunkLog2));
+					}
+					if(NeighborComponent && NeighborComponent != RenderComponent)
+					{
+						// A higher resolution neighbor depends on this component's exact LOD, while a lower resolution neighbor only depends on whether it's sealed.
+						const bool WasLowerResolution = PreviousLOD != INDEX_NONE && PreviousLOD > NeighborComponent->LOD;
+						const bool IsLowerResolution = RenderComponent->LOD > NeighborComponent->LOD;
+						const bool WasSealed = PreviousLOD != INDEX_NONE && PreviousLOD < NeighborComponent->LOD;
+						const bool IsSealed = RenderComponent->LOD < NeighborComponent->LOD;
+						if(WasLowerResolution || IsLowerResolution || WasSealed != IsSealed)
+						{
+							NeighborComponent->MarkRenderStateDirty();
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+FInt3 UBrickGridComponent::BrickToSuperChunkCoordinates(const FInt3& BrickCoordinates) const
+{
+	return FInt3::SignedShiftRight(BrickCoordinates,BricksPerRenderChunkLog2 + Parameters.RenderChunksPerSuperChunkLog2);
+}
+
+float UBrickGridComponent::ComputeSuperChunkSquaredDistance(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition) const
+{
+	// Like render chunks, super chunks are culled in 2D so the chunks underneath those on the horizon are also drawn.
+	const FInt3 BricksPerSuperChunk = FInt3::Exp2(BricksPerRenderChunkLog2 + Parameters.RenderChunksPerSuperChunkLog2);
+	const FInt3 MinSuperChunkBrickCoordinates = SuperChunkCoordinates * BricksPerSuperChunk;
+	const FInt3 MaxSuperChunkBrickCoordinates = MinSuperChunkBrickCoordinates + BricksPerSuperChunk;
+	const FBox SuperChunkBounds(
+		FInt3(MinSuperChunkBrickCoordinates.X,MinSuperChunkBrickCoordinates.Y,MinBrickCoordinates.Z).ToFloat(),
+		FInt3(MaxSuperChunkBrickCoordinates.X,MaxSuperChunkBrickCoordinates.Y,MaxBrickCoordinates.Z).ToFloat()
+		);
+	return SuperChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition);
+}
+
+bool UBrickGridComponent::IsSuperChunkMerged(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition) const
+{
+	return ComputeSuperChunkSquaredDistance(SuperChunkCoordinates,LocalViewPosition) > FMath::Square(Parameters.SuperChunkDistance);
+}
+
+bool UBrickGridComponent::AreSuperChunkRenderChunksBuilt(const FInt3& SuperChunkCoordinates,const FVector& LocalViewPosition,float LocalMaxDrawDistance) const
+{
+	// Only consider the render chunks within the grid and the draw distance, which are the ones UpdateRenderChunks creates.
+	const FInt3 MinChunkCoordinates = FInt3::Max(SuperChunkCoordinates << Parameters.RenderChunksPerSuperChunkLog2,BrickToRenderChunkCoordinates(MinBrickCoordinates));
+	const FInt3 MaxChunkCoordinates = FInt3::Min(((SuperChunkCoordinates + FInt3::Scalar(1)) << Parameters.RenderChunksPerSuperChunkLog2) - FInt3::Scalar(1),BrickToRenderChunkCoordinates(MaxBrickCoordinates));
+	for(int32 ChunkY = MinChunkCoordinates.Y;ChunkY <= MaxChunkCoordinates.Y;++ChunkY)
+	{
+		for(int32 ChunkX = MinChunkCoordinates.X;ChunkX <= MaxChunkCoordinates.X;++ChunkX)
+		{
+			const FInt3 MinChunkBrickCoordinates = FInt3(ChunkX,ChunkY,0) * BricksPerRenderChunk;
+			const FBox ChunkBounds(
+				FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MinBrickCoordinates.Z).ToFloat(),
+				FInt3(MinChunkBrickCoordinates.X,MinChunkBrickCoordinates.Y,MaxBrickCoordinates.Z).ToFloat()
+				);
+			if(ChunkBounds.ComputeSquaredDistanceToPoint(LocalViewPosition) < FMath::Square(LocalMaxDrawDistance))
+			{
+				for(int32 ChunkZ = MinChunkCoordinates.Z;ChunkZ <= MaxChunkCoordinates.Z;++ChunkZ)
+				{
+					const UBrickRenderComponent* RenderComponent = RenderChunkCoordinatesToComponent.FindRef(FInt3(ChunkX,ChunkY,ChunkZ));
+					if(!RenderComponent || !RenderComponent->IsMeshBuilt)
+					{
+						return false;
 					}
 				}
 			}
 		}
 	}
+	return true;
 }
 
 FBoxSphereBounds UBrickGridComponent::CalcBounds(const FTransform & LocalToWorld) const
@@ -512,7 +1664,17 @@ FBrickGridParameters::FBrickGridParameters()
 , CollisionChunksPerRegionLog2(1,1,2)
 , MinRegionCoordinates(-1024,-1024,0)
 , MaxRegionCoordinates(+1024,+1024,0)
+, MaxRenderChunkLOD(3)
+, RenderChunkLODDistance(256.0f)
+, RenderChunkLODHysteresis(16.0f)
+, RenderChunksPerSuperChunkLog2(2,2,2)
+, SuperChunkDistance(512.0f)
+, KeepRenderChunkVertices(true)
+, EnableCaveCulling(true)
 , AmbientOcclusionBlurRadius(2)
+, EnableLightPropagation(false)
+, Headless(false)
+, PrefetchLookAheadTime(1.0f)
 {
 	Materials.Add(FBrickMaterial());
 }
@@ -521,6 +1683,8 @@ UBrickGridComponent::UBrickGridComponent(const FObjectInitializer& Initializer)
 : Super(Initializer)
 {
 	PrimaryComponentTick.bStartWithTickEnabled =true;
+	NextViewerId = 0;
+	UpdateViewerId = INDEX_NONE;
 
 	Init(Parameters);
 }
@@ -533,6 +1697,10 @@ void UBrickGridComponent::OnRegister()
 	{
 		ChunkIt.Value()->RegisterComponent();
 	}
+	for (auto ChunkIt = SuperChunkCoordinatesToComponent.CreateConstIterator(); ChunkIt; ++ChunkIt)
+	{
+		ChunkIt.Value()->RegisterComponent();
+	}
 	for (auto ChunkIt = CollisionChunkCoordinatesToComponent.CreateConstIterator(); ChunkIt; ++ChunkIt)
 	{
 		ChunkIt.Value()->RegisterComponent();
@@ -545,6 +1713,10 @@ void UBrickGridComponent::OnUnregister()
 	{
 		ChunkIt.Value()->UnregisterComponent();
 	}
+	for (auto ChunkIt = SuperChunkCoordinatesToComponent.CreateConstIterator(); ChunkIt; ++ChunkIt)
+	{
+		ChunkIt.Value()->UnregisterComponent();
+	}
 	for (auto ChunkIt = CollisionChunkCoordinatesToComponent.CreateConstIterator(); ChunkIt; ++ChunkIt)
 	{
 		ChunkIt.Value()->UnregisterComponent();
@@ -0,0 +1,651 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved.
+
+#include "BrickGridPluginPrivatePCH.h"
+#include "BrickRenderComponent.h"
+#include "BrickGridComponent.h"
+#include "Async/ParallelFor.h"
+
+// Each brick's light is stored as a byte with the sky light level in the low 4 bits, and the block light level in the high 4 bits.
+namespace BrickLight
+{
+	enum EChannel
+	{
+		Sky,
+		Block,
+		NumChannels
+	};
+
+	static const uint8 MaxLevel = 15;
+
+	inline uint8 GetLevel(uint8 Light,int32 Channel)
+	{
+		return (Light >> (Channel * 4)) & MaxLevel;
+	}
+	inline void SetLevel(uint8& Light,int32 Channel,uint8 Level)
+	{
+		Light = (uint8)((Light & ~(MaxLevel << (Channel * 4))) | (Level << (Channel * 4)));
+	}
+
+	// Returns the level light propagates to an adjacent brick with. Light loses a level per brick, except full sky light going down.
+	inline uint8 GetPropagatedLevel(int32 Channel,uint32 FaceIndex,uint8 Level)
+	{
+		return (Channel == Sky && FaceIndex == 4 && Level == MaxLevel) ? MaxLevel : (Level > 0 ? Level - 1 : 0);
+	}
+};
+
+// The properties of each brick material that affect light propagation.
+struct FBrickLightMaterials
+{
+	TArray<uint8> EmissionByMaterial;
+	TArray<bool> IsOpaqueByMaterial;
+
+	FBrickLightMaterials(const UBrickGridComponent& Grid)
+	{
+		EmissionByMaterial.SetNumUninitialized(Grid.Parameters.Materials.Num());
+		IsOpaqueByMaterial.SetNumUninitialized(Grid.Parameters.Materials.Num());
+		for(int32 MaterialIndex = 0;MaterialIndex < Grid.Parameters.Materials.Num();++MaterialIndex)
+		{
+			EmissionByMaterial[MaterialIndex] = (uint8)FMath::Clamp<int32>(Grid.Parameters.Materials[MaterialIndex].LightEmission,0,BrickLight::MaxLevel);
+			IsOpaqueByMaterial[MaterialIndex] = Grid.BrickClassByMaterial[MaterialIndex] == EBrickClass::Opaque;
+		}
+	}
+};
+
+// Propagates light from a queue of bricks within a single region's light array.
+static void PropagateRegionLight(
+	int32 Channel,
+	const FInt3 BricksPerRegionLog2,
+	const TArray<uint8>& BrickContents,
+	const FBrickLightMaterials& LightMaterials,
+	TArray<uint32>& Queue,
+	TArray<uint8>& RegionLight
+	)
+{
+	const int32 BricksPerRegion[3] = { 1 << BricksPerRegionLog2.X,1 << BricksPerRegionLog2.Y,1 << BricksPerRegionLog2.Z };
+	const int32 BrickIndexStrides[3] = { 1 << BricksPerRegionLog2.Z,1 << (BricksPerRegionLog2.X + BricksPerRegionLog2.Z),1 };
+	for(int32 QueueIndex = 0;QueueIndex < Queue.Num();++QueueIndex)
+	{
+		const uint32 BrickIndex = Queue[QueueIndex];
+		const uint8 Level = BrickLight::GetLevel(RegionLight[BrickIndex],Channel);
+		const int32 RegionBrickCoordinates[3] =
+		{
+			int32(BrickIndex >> BricksPerRegionLog2.Z) & (BricksPerRegion[0] - 1),
+			int32(BrickIndex >> (BricksPerRegionLog2.X + BricksPerRegionLog2.Z)),
+			int32(BrickIndex) & (BricksPerRegion[2] - 1)
+		};
+		for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+		{
+			// Face 2N is the negative direction along axis N, and face 2N+1 the positive direction.
+			const int32 Axis = FaceIndex / 2;
+			const int32 Direction = (FaceIndex & 1) ? +1 : -1;
+			const int32 AdjacentCoordinate = RegionBrickCoordinates[Axis] + Direction;
+			if(AdjacentCoordinate < 0 || AdjacentCoordinate >= BricksPerRegion[Axis])
+			{
+				continue;
+			}
+			const uint32 AdjacentBrickIndex = BrickIndex + Direction * BrickIndexStrides[Axis];
+			const uint8 AdjacentLevel = BrickLight::GetPropagatedLevel(Channel,FaceIndex,Level);
+			if(!LightMaterials.IsOpaqueByMaterial[BrickContents[AdjacentBrickIndex]] && AdjacentLevel > BrickLight::GetLevel(RegionLight[AdjacentBrickIndex],Channel))
+			{
+				BrickLight::SetLevel(RegionLight[AdjacentBrickIndex],Channel,AdjacentLevel);
+				Queue.Add(AdjacentBrickIndex);
+			}
+		}
+	}
+}
+
+// Computes the light of a region from scratch, without reading or writing any other region.
+// The sky light at the bottom of the region above is used to find the columns open to the sky: if AboveRegionLight is null, all columns are.
+static void ComputeRegionLight(
+	const FInt3 BricksPerRegionLog2,
+	const TArray<uint8>& BrickContents,
+	const TArray<uint8>* AboveRegionLight,
+	const FBrickLightMaterials& LightMaterials,
+	TArray<uint8>& OutRegionLight
+	)
+{
+	const FInt3 BricksPerRegion = FInt3::Exp2(BricksPerRegionLog2);
+	const auto GetBrickIndex = [BricksPerRegionLog2](int32 X,int32 Y,int32 Z) -> uint32
+	{
+		return (((Y << BricksPerRegionLog2.X) + X) << BricksPerRegionLog2.Z) + Z;
+	};
+	OutRegionLight.Reset();
+	OutRegionLight.SetNumZeroed(BrickContents.Num());
+
+	// Fill the columns open to the sky with full sky light down to their highest opaque brick, and record the lowest brick lit that way in each column.
+	TArray<int32> SkyBottomZs;
+	SkyBottomZs.SetNumUninitialized(BricksPerRegion.X * BricksPerRegion.Y);
+	for(int32 Y = 0;Y < BricksPerRegion.Y;++Y)
+	{
+		for(int32 X = 0;X < BricksPerRegion.X;++X)
+		{
+			int32 Z = BricksPerRegion.Z;
+			if(!AboveRegionLight || BrickLight::GetLevel((*AboveRegionLight)[GetBrickIndex(X,Y,0)],BrickLight::Sky) == BrickLight::MaxLevel)
+			{
+				while(Z > 0 && !LightMaterials.IsOpaqueByMaterial[BrickContents[GetBrickIndex(X,Y,Z - 1)]])
+				{
+					--Z;
+					BrickLight::SetLevel(OutRegionLight[GetBrickIndex(X,Y,Z)],BrickLight::Sky,BrickLight::MaxLevel);
+				}
+			}
+			SkyBottomZs[Y * BricksPerRegion.X + X] = Z;
+		}
+	}
+
+	// Only the sky lit bricks beside a column that is lit less far down can spread sky light, so only propagate from those.
+	// Columns in other regions are lit when the region's seams are propagated.
+	TArray<uint32> Queue;
+	for(int32 Y = 0;Y < BricksPerRegion.Y;++Y)
+	{
+		for(int32 X = 0;X < BricksPerRegion.X;++X)
+		{
+			const int32 SkyBottomZ = SkyBottomZs[Y * BricksPerRegion.X + X];
+			int32 MaxAdjacentSkyBottomZ = SkyBottomZ;
+			if(X > 0) { MaxAdjacentSkyBottomZ = FMath::Max(MaxAdjacentSkyBottomZ,SkyBottomZs[Y * BricksPerRegion.X + X - 1]); }
+			if(X + 1 < BricksPerRegion.X) { MaxAdjacentSkyBottomZ = FMath::Max(MaxAdjacentSkyBottomZ,SkyBottomZs[Y * BricksPerRegion.X + X + 1]); }
+			if(Y > 0) { MaxAdjacentSkyBottomZ = FMath::Max(MaxAdjacentSkyBottomZ,SkyBottomZs[(Y - 1) * BricksPerRegion.X + X]); }
+			if(Y + 1 < BricksPerRegion.Y) { MaxAdjacentSkyBottomZ = FMath::Max(MaxAdjacentSkyBottomZ,SkyBottomZs[(Y + 1) * BricksPerRegion.X + X]); }
+			for(int32 Z = SkyBottomZ;Z < MaxAdjacentSkyBottomZ;++Z)
+			{
+				Queue.Add(GetBrickIndex(X,Y,Z));
+			}
+		}
+	}
+	PropagateRegionLight(BrickLight::Sky,BricksPerRegionLog2,BrickContents,LightMaterials,Queue,OutRegionLight);
+
+	// Propagate block light from the emissive bricks.
+	Queue.Reset();
+	for(int32 BrickIndex = 0;BrickIndex < BrickContents.Num();++BrickIndex)
+	{
+		const uint8 Emission = LightMaterials.EmissionByMaterial[BrickContents[BrickIndex]];
+		if(Emission)
+		{
+			BrickLight::SetLevel(OutRegionLight[BrickIndex],BrickLight::Block,Emission);
+			Queue.Add(BrickIndex);
+		}
+	}
+	PropagateRegionLight(BrickLight::Block,BricksPerRegionLog2,BrickContents,LightMaterials,Queue,OutRegionLight);
+}
+
+// Incrementally propagates light through the regions of a grid whose light is valid.
+// Light is removed by zeroing the bricks that received it from a removed brick and queuing the bricks that received it from elsewhere to propagate it back,
+// then added by propagating from a queue of lit bricks. Regions whose light isn't valid are treated as if they block light.
+class FBrickLightEngine
+{
+public:
+
+	// The box of bricks whose light was changed by the engine.
+	FInt3 MinLitBrickCoordinates;
+	FInt3 MaxLitBrickCoordinates;
+
+	FBrickLightEngine(UBrickGridComponent& InGrid)
+	: MinLitBrickCoordinates(FInt3::Scalar(INT_MAX))
+	, MaxLitBrickCoordinates(FInt3::Scalar(INT_MIN))
+	, Grid(InGrid)
+	, LightMaterials(InGrid)
+	, CachedRegionCoordinates(FInt3::Scalar(INT_MAX))
+	, CachedRegion(NULL)
+	{}
+
+	// Looks up a brick's light and material. Returns false if the brick isn't in a region with valid light.
+	bool GetBrick(const FInt3& BrickCoordinates,uint8*& OutLight,uint8& OutMaterial)
+	{
+		const FInt3 RegionCoordinates = Grid.BrickToRegionCoordinates(BrickCoordinates);
+		if(!(RegionCoordinates == CachedRegionCoordinates))
+		{
+			const int32* const RegionIndex = Grid.RegionCoordinatesToIndex.Find(RegionCoordinates);
+			CachedRegionCoordinates = RegionCoordinates;
+			CachedRegion = RegionIndex && Grid.Regions[*RegionIndex].IsLightValid ? &Grid.Regions[*RegionIndex] : NULL;
+		}
+		if(!CachedRegion)
+		{
+			return false;
+		}
+		const uint32 BrickIndex = Grid.BrickCoordinatesToRegionBrickIndex(RegionCoordinates,BrickCoordinates);
+		OutLight = &CachedRegion->Light[BrickIndex];
+		OutMaterial = CachedRegion->BrickContents[BrickIndex];
+		return true;
+	}
+
+	// Returns the level of light a brick emits on its own: sky light for non-opaque bricks that nothing with valid light is above, and block light for emissive bricks.
+	uint8 GetSourceLevel(int32 Channel,const FInt3& BrickCoordinates,uint8 Material)
+	{
+		if(Channel == BrickLight::Block)
+		{
+			return LightMaterials.EmissionByMaterial[Material];
+		}
+		else if(LightMaterials.IsOpaqueByMaterial[Material])
+		{
+			return 0;
+		}
+		uint8* AboveLight;
+		uint8 AboveMaterial;
+		return (BrickCoordinates.Z == Grid.MaxBrickCoordinates.Z || !GetBrick(BrickCoordinates + FInt3(0,0,1),AboveLight,AboveMaterial)) ? BrickLight::MaxLevel : 0;
+	}
+
+	void SetBrickLevel(const FInt3& BrickCoordinates,uint8& Light,int32 Channel,uint8 Level)
+	{
+		BrickLight::SetLevel(Light,Channel,Level);
+		MinLitBrickCoordinates = FInt3::Min(MinLitBrickCoordinates,BrickCoordinates);
+		MaxLitBrickCoordinates = FInt3::Max(MaxLitBrickCoordinates,BrickCoordinates);
+	}
+
+	void PushRemoval(int32 Channel,const FInt3& BrickCoordinates,uint8 Level)
+	{
+		new(RemovalQueues[Channel]) FRemoval(BrickCoordinates,Level);
+	}
+	void PushAddition(int32 Channel,const FInt3& BrickCoordinates)
+	{
+		AdditionQueues[Channel].Add(BrickCoordinates);
+	}
+
+	// Removes the light propagated from the bricks in the removal queues, queuing the bricks that still have light from elsewhere for addition.
+	void PropagateRemovals()
+	{
+		for(int32 Channel = 0;Channel < BrickLight::NumChannels;++Channel)
+		{
+			TArray<FRemoval>& Queue = RemovalQueues[Channel];
+			for(int32 QueueIndex = 0;QueueIndex < Queue.Num();++QueueIndex)
+			{
+				const FRemoval Removal = Queue[QueueIndex];
+				for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+				{
+					const FInt3 AdjacentBrickCoordinates = Removal.BrickCoordinates + FaceNormals[FaceIndex];
+					uint8* AdjacentLight;
+					uint8 AdjacentMaterial;
+					if(!GetBrick(AdjacentBrickCoordinates,AdjacentLight,AdjacentMaterial))
+					{
+						continue;
+					}
+					const uint8 AdjacentLevel = BrickLight::GetLevel(*AdjacentLight,Channel);
+					if(!AdjacentLevel)
+					{
+						continue;
+					}
+					if(AdjacentLevel < Removal.Level || BrickLight::GetPropagatedLevel(Channel,FaceIndex,Removal.Level) == AdjacentLevel)
+					{
+						// The adjacent brick may have received its light from the removed brick, so remove it too, and restore it if it is a source.
+						SetBrickLevel(AdjacentBrickCoordinates,*AdjacentLight,Channel,0);
+						new(Queue) FRemoval(AdjacentBrickCoordinates,AdjacentLevel);
+						const uint8 SourceLevel = GetSourceLevel(Channel,AdjacentBrickCoordinates,AdjacentMaterial);
+						if(SourceLevel)
+						{
+							SetBrickLevel(AdjacentBrickCoordinates,*AdjacentLight,Channel,SourceLevel);
+							PushAddition(Channel,AdjacentBrickCoordinates);
+						}
+					}
+					else
+					{
+						// The adjacent brick's light came from elsewhere, so propagate it back into the removed bricks.
+						PushAddition(Channel,AdjacentBrickCoordinates);
+					}
+				}
+			}
+			Queue.Reset();
+		}
+	}
+
+	// Propagates light from the bricks in the addition queues.
+	void PropagateAdditions()
+	{
+		for(int32 Channel = 0;Channel < BrickLight::NumChannels;++Channel)
+		{
+			TArray<FInt3>& Queue = AdditionQueues[Channel];
+			for(int32 QueueIndex = 0;QueueIndex < Queue.Num();++QueueIndex)
+			{
+				const FInt3 BrickCoordinates = Queue[QueueIndex];
+				uint8* Light;
+				uint8 Material;
+				if(!GetBrick(BrickCoordinates,Light,Material))
+				{
+					continue;
+				}
+				const uint8 Level = BrickLight::GetLevel(*Light,Channel);
+				if(Level <= 1)
+				{
+					continue;
+				}
+				for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+				{
+					const FInt3 AdjacentBrickCoordinates = BrickCoordinates + FaceNormals[FaceIndex];
+					uint8* AdjacentLight;
+					uint8 AdjacentMaterial;
+					const uint8 AdjacentLevel = BrickLight::GetPropagatedLevel(Channel,FaceIndex,Level);
+					if(	GetBrick(AdjacentBrickCoordinates,AdjacentLight,AdjacentMaterial)
+					&&	!LightMaterials.IsOpaqueByMaterial[AdjacentMaterial]
+					&&	AdjacentLevel > BrickLight::GetLevel(*AdjacentLight,Channel))
+					{
+						SetBrickLevel(AdjacentBrickCoordinates,*AdjacentLight,Channel,AdjacentLevel);
+						Queue.Add(AdjacentBrickCoordinates);
+					}
+				}
+			}
+			Queue.Reset();
+		}
+	}
+
+private:
+
+	struct FRemoval
+	{
+		FInt3 BrickCoordinates;
+		uint8 Level;
+		FRemoval(const FInt3& InBrickCoordinates,uint8 InLevel) : BrickCoordinates(InBrickCoordinates), Level(InLevel) {}
+	};
+
+	UBrickGridComponent& Grid;
+	const FBrickLightMaterials LightMaterials;
+
+	// The last region looked up, since propagation mostly stays within a region.
+	FInt3 CachedRegionCoordinates;
+	FBrickRegion* CachedRegion;
+
+	TArray<FRemoval> RemovalQueues[BrickLight::NumChannels];
+	TArray<FInt3> AdditionQueues[BrickLight::NumChannels];
+};
+
+void UBrickGridComponent::UpdateLight(const FInt3& MinDirtyBrickCoordinates,const FInt3& MaxDirtyBrickCoordinates)
+{
+	if(!Parameters.EnableLightPropagation)
+	{
+		return;
+	}
+
+	// Skip boxes that aren't in a region with valid light, such as the bricks of a region that is being initialized. The light engine doesn't read or
+	// write regions without valid light, so changing their bricks can't change the light of the bricks around them; RelightRegions lights the region
+	// and propagates light across its faces once it's initialized.
+	const FInt3 MinRegionCoordinates = BrickToRegionCoordinates(MinDirtyBrickCoordinates);
+	const FInt3 MaxRegionCoordinates = BrickToRegionCoordinates(MaxDirtyBrickCoordinates);
+	bool HasLitRegion = false;
+	for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y && !HasLitRegion;++RegionY)
+	{
+		for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X && !HasLitRegion;++RegionX)
+		{
+			for(int32 RegionZ = MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z && !HasLitRegion;++RegionZ)
+			{
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(FInt3(RegionX,RegionY,RegionZ));
+				HasLitRegion = RegionIndex && Regions[*RegionIndex].IsLightValid;
+			}
+		}
+	}
+	if(!HasLitRegion)
+	{
+		return;
+	}
+
+	// The light engine writes the regions' light in place, so hold the lock while propagating, but not while invalidating the lit chunks.
+	FInt3 MinLitBrickCoordinates;
+	FInt3 MaxLitBrickCoordinates;
+	{
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		FBrickLightEngine LightEngine(*this);
+
+		// Remove the light of the dirty bricks, along with any light that was propagated from them.
+		for(int32 Y = MinDirtyBrickCoordinates.Y;Y <= MaxDirtyBrickCoordinates.Y;++Y)
+		{
+			for(int32 X = MinDirtyBrickCoordinates.X;X <= MaxDirtyBrickCoordinates.X;++X)
+			{
+				for(int32 Z = MinDirtyBrickCoordinates.Z;Z <= MaxDirtyBrickCoordinates.Z;++Z)
+				{
+					const FInt3 BrickCoordinates(X,Y,Z);
+					uint8* Light;
+					uint8 Material;
+					if(LightEngine.GetBrick(BrickCoordinates,Light,Material))
+					{
+						for(int32 Channel = 0;Channel < BrickLight::NumChannels;++Channel)
+						{
+							const uint8 Level = BrickLight::GetLevel(*Light,Channel);
+							if(Level)
+							{
+								LightEngine.SetBrickLevel(BrickCoordinates,*Light,Channel,0);
+								LightEngine.PushRemoval(Channel,BrickCoordinates,Level);
+							}
+						}
+					}
+				}
+			}
+		}
+		LightEngine.PropagateRemovals();
+
+		// Relight the dirty bricks that are light sources, and propagate light into the dirty bricks from the bricks around them.
+		for(int32 Y = MinDirtyBrickCoordinates.Y - 1;Y <= MaxDirtyBrickCoordinates.Y + 1;++Y)
+		{
+			for(int32 X = MinDirtyBrickCoordinates.X - 1;X <= MaxDirtyBrickCoordinates.X + 1;++X)
+			{
+				for(int32 Z = MinDirtyBrickCoordinates.Z - 1;Z <= MaxDirtyBrickCoordinates.Z + 1;++Z)
+				{
+					const FInt3 BrickCoordinates(X,Y,Z);
+					uint8* Light;
+					uint8 Material;
+					if(LightEngine.GetBrick(BrickCoordinates,Light,Material))
+					{
+						const bool IsDirty = FInt3::All(BrickCoordinates >= MinDirtyBrickCoordinates) && FInt3::All(BrickCoordinates <= MaxDirtyBrickCoordinates);
+						for(int32 Channel = 0;Channel < BrickLight::NumChannels;++Channel)
+						{
+							const uint8 SourceLevel = IsDirty ? LightEngine.GetSourceLevel(Channel,BrickCoordinates,Material) : 0;
+							if(SourceLevel > BrickLight::GetLevel(*Light,Channel))
+							{
+								LightEngine.SetBrickLevel(BrickCoordinates,*Light,Channel,SourceLevel);
+							}
+							LightEngine.PushAddition(Channel,BrickCoordinates);
+						}
+					}
+				}
+			}
+		}
+		LightEngine.PropagateAdditions();
+		MinLitBrickCoordinates = LightEngine.MinLitBrickCoordinates;
+		MaxLitBrickCoordinates = LightEngine.MaxLitBrickCoordinates;
+	}
+
+	InvalidateLitChunkComponents(MinLitBrickCoordinates,MaxLitBrickCoordinates);
+}
+
+void UBrickGridComponent::RelightRegions(const TArray<FInt3>& RelightRegionCoordinates)
+{
+	if(!Parameters.EnableLightPropagation)
+	{
+		return;
+	}
+
+	// Light the regions from the top of the grid down, so each region can find its columns that are open to the sky from the region above it.
+	TArray<FInt3> SortedRegionCoordinates;
+	for(const FInt3& RegionCoordinates : RelightRegionCoordinates)
+	{
+		if(RegionCoordinatesToIndex.Find(RegionCoordinates))
+		{
+			SortedRegionCoordinates.Add(RegionCoordinates);
+		}
+	}
+	SortedRegionCoordinates.Sort([](const FInt3& A,const FInt3& B) { return A.Z > B.Z; });
+
+	// Compute the light of each horizontal layer of regions in parallel. The regions are only read by the tasks, and render chunk tasks
+	// only read them as well, so the lock only needs to be held while the results are written to the regions.
+	const FBrickLightMaterials LightMaterials(*this);
+	for(int32 LayerBeginIndex = 0;LayerBeginIndex < SortedRegionCoordinates.Num();)
+	{
+		int32 LayerEndIndex = LayerBeginIndex + 1;
+		while(LayerEndIndex < SortedRegionCoordinates.Num() && SortedRegionCoordinates[LayerEndIndex].Z == SortedRegionCoordinates[LayerBeginIndex].Z)
+		{
+			++LayerEndIndex;
+		}
+
+		TArray<TArray<uint8>> LayerRegionLight;
+		LayerRegionLight.SetNum(LayerEndIndex - LayerBeginIndex);
+		ParallelFor(LayerRegionLight.Num(),[&](int32 LayerRegionIndex)
+		{
+			const FInt3 RegionCoordinates = SortedRegionCoordinates[LayerBeginIndex + LayerRegionIndex];
+			const FBrickRegion& Region = Regions[RegionCoordinatesToIndex.FindChecked(RegionCoordinates)];
+			const int32* const AboveRegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates + FInt3(0,0,1));
+			const TArray<uint8>* AboveRegionLight = AboveRegionIndex && Regions[*AboveRegionIndex].IsLightValid ? &Regions[*AboveRegionIndex].Light : NULL;
+			ComputeRegionLight(Parameters.BricksPerRegionLog2,Region.BrickContents,AboveRegionLight,LightMaterials,LayerRegionLight[LayerRegionIndex]);
+		});
+
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		for(int32 LayerRegionIndex = 0;LayerRegionIndex < LayerRegionLight.Num();++LayerRegionIndex)
+		{
+			FBrickRegion& Region = Regions[RegionCoordinatesToIndex.FindChecked(SortedRegionCoordinates[LayerBeginIndex + LayerRegionIndex])];
+			Region.Light = MoveTemp(LayerRegionLight[LayerRegionIndex]);
+			Region.IsLightValid = true;
+		}
+		LayerBeginIndex = LayerEndIndex;
+	}
+
+	// The regions below the relit regions found their columns open to the sky while the relit regions' light wasn't valid, so update their top layer of bricks.
+	for(const FInt3& RegionCoordinates : SortedRegionCoordinates)
+	{
+		const FInt3 BelowRegionCoordinates = RegionCoordinates - FInt3(0,0,1);
+		if(!SortedRegionCoordinates.Contains(BelowRegionCoordinates))
+		{
+			const FInt3 MinBelowRegionBrickCoordinates = BelowRegionCoordinates * BricksPerRegion;
+			const FInt3 MaxBelowRegionBrickCoordinates = MinBelowRegionBrickCoordinates + BricksPerRegion - FInt3::Scalar(1);
+			UpdateLight(
+				FInt3(MinBelowRegionBrickCoordinates.X,MinBelowRegionBrickCoordinates.Y,MaxBelowRegionBrickCoordinates.Z),
+				MaxBelowRegionBrickCoordinates
+				);
+		}
+	}
+
+	// Propagate light across the faces of the relit regions in both directions. The light engine writes the regions' light in place, so hold the lock
+	// while propagating, but not while invalidating the lit chunks.
+	FInt3 MinLitBrickCoordinates;
+	FInt3 MaxLitBrickCoordinates;
+	{
+		FScopeLock RegionsLock(&RegionsCriticalSection);
+		FBrickLightEngine LightEngine(*this);
+		for(const FInt3& RegionCoordinates : SortedRegionCoordinates)
+		{
+			const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+			const FInt3 MaxRegionBrickCoordinates = MinRegionBrickCoordinates + BricksPerRegion - FInt3::Scalar(1);
+			for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+			{
+				FInt3 MinAdjacentBrickCoordinates;
+				FInt3 MaxAdjacentBrickCoordinates;
+				GetFaceAdjacentBricks(MinRegionBrickCoordinates,MaxRegionBrickCoordinates,FaceIndex,MinAdjacentBrickCoordinates,MaxAdjacentBrickCoordinates);
+				for(int32 Y = MinAdjacentBrickCoordinates.Y;Y <= MaxAdjacentBrickCoordinates.Y;++Y)
+				{
+					for(int32 X = MinAdjacentBrickCoordinates.X;X <= MaxAdjacentBrickCoordinates.X;++X)
+					{
+						for(int32 Z = MinAdjacentBrickCoordinates.Z;Z <= MaxAdjacentBrickCoordinates.Z;++Z)
+						{
+							for(int32 Channel = 0;Channel < BrickLight::NumChannels;++Channel)
+							{
+								LightEngine.PushAddition(Channel,FInt3(X,Y,Z));
+								LightEngine.PushAddition(Channel,FInt3(X,Y,Z) - FaceNormals[FaceIndex]);
+							}
+						}
+					}
+				}
+			}
+
+			// The light of all the region's bricks changed.
+			LightEngine.MinLitBrickCoordinates = FInt3::Min(LightEngine.MinLitBrickCoordinates,MinRegionBrickCoordinates);
+			LightEngine.MaxLitBrickCoordinates = FInt3::Max(LightEngine.MaxLitBrickCoordinates,MaxRegionBrickCoordinates);
+		}
+		LightEngine.PropagateAdditions();
+		MinLitBrickCoordinates = LightEngine.MinLitBrickCoordinates;
+		MaxLitBrickCoordinates = LightEngine.MaxLitBrickCoordinates;
+	}
+
+	InvalidateLitChunkComponents(MinLitBrickCoordinates,MaxLitBrickCoordinates);
+}
+
+void UBrickGridComponent::InvalidateLitChunkComponents(const FInt3& MinLitBrickCoordinates,const FInt3& MaxLitBrickCoordinates)
+{
+	if(FInt3::Any(MinLitBrickCoordinates > MaxLitBrickCoordinates))
+	{
+		return;
+	}
+
+	// Expand the box by 1 brick, since each vertex is lit by the bricks on both sides of it.
+	const FInt3 MinRenderChunkCoordinates = BrickToRenderChunkCoordinates(MinLitBrickCoordinates - FInt3::Scalar(1));
+	const FInt3 MaxRenderChunkCoordinates = BrickToRenderChunkCoordinates(MaxLitBrickCoordinates + FInt3::Scalar(1));
+	for(int32 ChunkX = MinRenderChunkCoordinates.X;ChunkX <= MaxRenderChunkCoordinates.X;++ChunkX)
+	{
+		for(int32 ChunkY = MinRenderChunkCoordinates.Y;ChunkY <= MaxRenderChunkCoordinates.Y;++ChunkY)
+		{
+			for(int32 ChunkZ = MinRenderChunkCoordinates.Z;ChunkZ <= MaxRenderChunkCoordinates.Z;++ChunkZ)
+			{
+				UBrickRenderComponent* RenderComponent = RenderChunkCoordinatesToComponent.FindRef(FInt3(ChunkX,ChunkY,ChunkZ));
+				if(RenderComponent)
+				{
+					RenderComponent->HasLowPriorityUpdatePending = true;
+				}
+			}
+		}
+	}
+
+	const FInt3 MinSuperChunkCoordinates = BrickToSuperChunkCoordinates(MinLitBrickCoordinates - FInt3::Scalar(1));
+	const FInt3 MaxSuperChunkCoordinates = BrickToSuperChunkCoordinates(MaxLitBrickCoordinates + FInt3::Scalar(1));
+	for(int32 SuperChunkX = MinSuperChunkCoordinates.X;SuperChunkX <= MaxSuperChunkCoordinates.X;++SuperChunkX)
+	{
+		for(int32 SuperChunkY = MinSuperChunkCoordinates.Y;SuperChunkY <= MaxSuperChunkCoordinates.Y;++SuperChunkY)
+		{
+			for(int32 SuperChunkZ = MinSuperChunkCoordinates.Z;SuperChunkZ <= MaxSuperChunkCoordinates.Z;++SuperChunkZ)
+			{
+				UBrickRenderComponent* SuperChunkComponent = SuperChunkCoordinatesToComponent.FindRef(FInt3(SuperChunkX,SuperChunkY,SuperChunkZ));
+				if(SuperChunkComponent)
+				{
+					SuperChunkComponent->HasLowPriorityUpdatePending = true;
+				}
+			}
+		}
+	}
+}
+
+void UBrickGridComponent::GetBrickLightArray(const FInt3& GetMinBrickCoordinates,const FInt3& GetMaxBrickCoordinates,TArray<uint8>& OutBrickLight) const
+{
+	FScopeLock RegionsLock(&RegionsCriticalSection);
+	const FInt3 OutputSize = GetMaxBrickCoordinates - GetMinBrickCoordinates + FInt3::Scalar(1);
+	const FInt3 GetMinRegionCoordinates = BrickToRegionCoordinates(GetMinBrickCoordinates);
+	const FInt3 GetMaxRegionCoordinates = BrickToRegionCoordinates(GetMaxBrickCoordinates);
+	const uint32 FullBlurredSkyVisibility = BrickMesher::GetFullBlurredSkyVisibility(Parameters.AmbientOcclusionBlurRadius);
+	for(int32 RegionY = GetMinRegionCoordinates.Y;RegionY <= GetMaxRegionCoordinates.Y;++RegionY)
+	{
+		for(int32 RegionX = GetMinRegionCoordinates.X;RegionX <= GetMaxRegionCoordinates.X;++RegionX)
+		{
+			for(int32 RegionZ = GetMinRegionCoordinates.Z;RegionZ <= GetMaxRegionCoordinates.Z;++RegionZ)
+			{
+				const FInt3 RegionCoordinates(RegionX,RegionY,RegionZ);
+				const int32* const RegionIndex = RegionCoordinatesToIndex.Find(RegionCoordinates);
+				const FBrickRegion* Region = RegionIndex && Regions[*RegionIndex].IsLightValid ? &Regions[*RegionIndex] : NULL;
+				const uint8 DefaultLight = RegionZ < Parameters.MinRegionCoordinates.Z ? 0 : BrickLight::MaxLevel;
+
+				// Regions that haven't been lit yet approximate their sky light with the blurred sky visibility, so their render chunks don't start out fully
+				// bright and then darken once the region is lit.
+				const FBrickRegion* UnlitRegion = RegionIndex && !Region && Regions[*RegionIndex].BlurredSkyVisibility.Num() ? &Regions[*RegionIndex] : NULL;
+				const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
+				const FInt3 MinOutputRegionBrickCoordinates = FInt3::Max(FInt3::Scalar(0),GetMinBrickCoordinates - MinRegionBrickCoordinates);
+				const FInt3 MaxOutputRegionBrickCoordinates = FInt3::Min(BricksPerRegion - FInt3::Scalar(1),GetMaxBrickCoordinates - MinRegionBrickCoordinates);
+				for(int32 RegionBrickY = MinOutputRegionBrickCoordinates.Y;RegionBrickY <= MaxOutputRegionBrickCoordinates.Y;++RegionBrickY)
+				{
+					for(int32 RegionBrickX = MinOutputRegionBrickCoordinates.X;RegionBrickX <= MaxOutputRegionBrickCoordinates.X;++RegionBrickX)
+					{
+						const int32 OutputX = MinRegionBrickCoordinates.X + RegionBrickX - GetMinBrickCoordinates.X;
+						const int32 OutputY = MinRegionBrickCoordinates.Y + RegionBrickY - GetMinBrickCoordinates.Y;
+						const int32 OutputMinZ = MinRegionBrickCoordinates.Z + MinOutputRegionBrickCoordinates.Z - GetMinBrickCoordinates.Z;
+						const int32 OutputSizeZ = MaxOutputRegionBrickCoordinates.Z - MinOutputRegionBrickCoordinates.Z + 1;
+						const uint32 OutputBaseBrickIndex = (OutputY * OutputSize.X + OutputX) * OutputSize.Z + OutputMinZ;
+						const uint32 RegionBaseBrickIndex = (((RegionBrickY << Parameters.BricksPerRegionLog2.X) + RegionBrickX) << Parameters.BricksPerRegionLog2.Z) + MinOutputRegionBrickCoordinates.Z;
+						if(Region)
+						{
+							FMemory::Memcpy(&OutBrickLight[OutputBaseBrickIndex],&Region->Light[RegionBaseBrickIndex],OutputSizeZ * sizeof(uint8));
+						}
+						else if(UnlitRegion)
+						{
+							for(int32 OutputZ = 0;OutputZ < OutputSizeZ;++OutputZ)
+							{
+								const uint32 SkyVisibility = UnlitRegion->BlurredSkyVisibility[RegionBaseBrickIndex + OutputZ];
+								OutBrickLight[OutputBaseBrickIndex + OutputZ] = (uint8)((SkyVisibility * BrickLight::MaxLevel + FullBlurredSkyVisibility / 2) / FullBlurredSkyVisibility);
+							}
+						}
+						else
+						{
+							FMemory::Memset(&OutBrickLight[OutputBaseBrickIndex],DefaultLight,OutputSizeZ * sizeof(uint8));
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,73 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#include "BrickGridPluginPrivatePCH.h"
+#include "BrickGridMovementComponent.h"
+#include "BrickGridComponent.h"
+
+UBrickGridMovementComponent::UBrickGridMovementComponent(const FObjectInitializer& Initializer)
+	: Super(Initializer)
+{
+	Grid = NULL;
+	MaxWalkSpeed = 600.0f;
+	JumpZVelocity = 420.0f;
+	MaxStepHeight = 45.0f;
+	IsOnGround = false;
+}
+
+void UBrickGridMovementComponent::TickComponent(float DeltaTime,enum ELevelTick TickType,FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime,TickType,ThisTickFunction);
+
+	if(!PawnOwner || !UpdatedComponent || !Grid || ShouldSkipUpdate(DeltaTime))
+	{
+		return;
+	}
+
+	// Walk horizontally at the input's speed, jump on upward input while standing on the ground, and fall under gravity.
+	const FVector InputVector = ConsumeInputVector().GetClampedToMaxSize(1.0f);
+	Velocity.X = InputVector.X * MaxWalkSpeed;
+	Velocity.Y = InputVector.Y * MaxWalkSpeed;
+	if(IsOnGround && InputVector.Z > 0.0f)
+	{
+		Velocity.Z = JumpZVelocity;
+	}
+	Velocity.Z += GetGravityZ() * DeltaTime;
+
+	const FBox Box = UpdatedComponent->Bounds.GetBox();
+	const FVector DesiredDelta = Velocity * DeltaTime;
+	FVector HitNormal;
+	FVector Delta = Grid->SweepBox(Box,DesiredDelta,HitNormal);
+
+	// If the pawn walked into a ledge, try stepping onto it by moving up by the step height, then across, then back down.
+	if(IsOnGround && MaxStepHeight > 0.0f && (HitNormal.X != 0.0f || HitNormal.Y != 0.0f))
+	{
+		FVector StepUpHitNormal;
+		FVector StepAcrossHitNormal;
+		FVector StepDownHitNormal;
+		const FVector StepUpDelta = Grid->SweepBox(Box,FVector(0.0f,0.0f,MaxStepHeight),StepUpHitNormal);
+		const FVector StepAcrossDelta = Grid->SweepBox(Box.ShiftBy(StepUpDelta),FVector(DesiredDelta.X,DesiredDelta.Y,0.0f),StepAcrossHitNormal);
+		if(StepAcrossDelta.SizeSquared2D() > Delta.SizeSquared2D() + KINDA_SMALL_NUMBER)
+		{
+			const FVector StepDownDelta = Grid->SweepBox(
+				Box.ShiftBy(StepUpDelta + StepAcrossDelta),
+				FVector(0.0f,0.0f,FMath::Min(0.0f,DesiredDelta.Z) - StepUpDelta.Z),
+				StepDownHitNormal
+				);
+			Delta = StepUpDelta + StepAcrossDelta + StepDownDelta;
+			HitNormal = FVector(StepAcrossHitNormal.X,StepAcrossHitNormal.Y,StepDownHitNormal.Z);
+		}
+	}
+
+	// Stop the pawn along the axes it was blocked along.
+	for(int32 Axis = 0;Axis < 3;++Axis)
+	{
+		if(HitNormal[Axis] != 0.0f)
+		{
+			Velocity[Axis] = 0.0f;
+		}
+	}
+	IsOnGround = HitNormal.Z > 0.0f;
+
+	MoveUpdatedComponent(Delta,UpdatedComponent->GetComponentQuat(),false);
+	UpdateComponentVelocity();
+}
@@ -0,0 +1,119 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#include "BrickGridPluginPrivatePCH.h"
+#include "BrickGridScheduler.h"
+
+// How much of each new cost measurement is blended into the moving average.
+static const double CostSampleWeight = 0.1;
+
+FBrickGridWorkScheduler::FBrickGridWorkScheduler()
+: GameThreadBudgetRemaining(0.0)
+, WorkerBudgetRemaining(0.0)
+{
+	// Start with rough guesses for 32x32x32 brick chunks, which are adapted once the work has been measured.
+	EstimatedCosts[(int32)EBrickGridWork::RegionInit] = 0.005;
+	EstimatedCosts[(int32)EBrickGridWork::RenderChunkCreation] = 0.0002;
+	EstimatedCosts[(int32)EBrickGridWork::CollisionChunkCreation] = 0.001;
+	EstimatedCosts[(int32)EBrickGridWork::AmbientOcclusionUpdate] = 0.0002;
+	EstimatedCosts[(int32)EBrickGridWork::RenderChunkMeshBuild] = 0.001;
+	EstimatedCosts[(int32)EBrickGridWork::SuperChunkMeshBuild] = 0.008;
+	EstimatedCosts[(int32)EBrickGridWork::CollisionBuild] = 0.0005;
+	for(int32 WorkIndex = 0;WorkIndex < (int32)EBrickGridWork::Count;++WorkIndex)
+	{
+		NumWorkerTasksInFlight[WorkIndex] = 0;
+		HasAdmittedWork[WorkIndex] = false;
+	}
+}
+
+void FBrickGridWorkScheduler::BeginUpdate(float GameThreadBudget,float WorkerBudget)
+{
+	FScopeLock Lock(&CriticalSection);
+	GameThreadBudgetRemaining = GameThreadBudget;
+	WorkerBudgetRemaining = WorkerBudget;
+	for(int32 WorkIndex = 0;WorkIndex < (int32)EBrickGridWork::Count;++WorkIndex)
+	{
+		// The workers haven't finished the tasks still in flight, so they don't have time for as much new work.
+		WorkerBudgetRemaining -= NumWorkerTasksInFlight[WorkIndex] * EstimatedCosts[WorkIndex];
+		HasAdmittedWork[WorkIndex] = false;
+	}
+}
+
+bool FBrickGridWorkScheduler::Admit(EBrickGridWork Work,double* OutChargedSeconds)
+{
+	FScopeLock Lock(&CriticalSection);
+	if(Fits(Work))
+	{
+		const double ChargedSeconds = Charge(Work);
+		if(OutChargedSeconds)
+		{
+			*OutChargedSeconds = ChargedSeconds;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool FBrickGridWorkScheduler::Admit(EBrickGridWork GameThreadWork,EBrickGridWork WorkerWork,double* OutGameThreadChargedSeconds)
+{
+	check(!IsWorkerWork(GameThreadWork) && IsWorkerWork(WorkerWork));
+	FScopeLock Lock(&CriticalSection);
+	if(Fits(GameThreadWork) && Fits(WorkerWork))
+	{
+		const double GameThreadChargedSeconds = Charge(GameThreadWork);
+		Charge(WorkerWork);
+		if(OutGameThreadChargedSeconds)
+		{
+			*OutGameThreadChargedSeconds = GameThreadChargedSeconds;
+		}
+		return true;
+	}
+	return false;
+}
+
+void FBrickGridWorkScheduler::ReportGameThreadCost(EBrickGridWork Work,double ChargedSeconds,double Seconds)
+{
+	check(!IsWorkerWork(Work));
+	FScopeLock Lock(&CriticalSection);
+	GameThreadBudgetRemaining += ChargedSeconds - Seconds;
+	AddCostSample(Work,Seconds);
+}
+
+void FBrickGridWorkScheduler::BeginWorkerTask(EBrickGridWork Work)
+{
+	check(IsWorkerWork(Work));
+	FScopeLock Lock(&CriticalSection);
+	++NumWorkerTasksInFlight[(int32)Work];
+}
+
+void FBrickGridWorkScheduler::EndWorkerTask(EBrickGridWork Work,double Seconds)
+{
+	check(IsWorkerWork(Work));
+	FScopeLock Lock(&CriticalSection);
+	NumWorkerTasksInFlight[(int32)Work] = FMath::Max(0,NumWorkerTasksInFlight[(int32)Work] - 1);
+	AddCostSample(Work,Seconds);
+}
+
+double FBrickGridWorkScheduler::GetEstimatedCost(EBrickGridWork Work) const
+{
+	FScopeLock Lock(&CriticalSection);
+	return EstimatedCosts[(int32)Work];
+}
+
+void FBrickGridWorkScheduler::AddCostSample(EBrickGridWork Work,double Seconds)
+{
+	EstimatedCosts[(int32)Work] += (Seconds - EstimatedCosts[(int32)Work]) * CostSampleWeight;
+}
+
+bool FBrickGridWorkScheduler::Fits(EBrickGridWork Work) const
+{
+	const double BudgetRemaining = IsWorkerWork(Work) ? WorkerBudgetRemaining : GameThreadBudgetRemaining;
+	return !HasAdmittedWork[(int32)Work] || EstimatedCosts[(int32)Work] <= BudgetRemaining;
+}
+
+double FBrickGridWorkScheduler::Charge(EBrickGridWork Work)
+{
+	double& BudgetRemaining = IsWorkerWork(Work) ? WorkerBudgetRemaining : GameThreadBudgetRemaining;
+	BudgetRemaining -= EstimatedCosts[(int32)Work];
+	HasAdmittedWork[(int32)Work] = true;
+	return EstimatedCosts[(int32)Work];
+}
@@ -3,23 +3,13 @@
 #include "BrickGridPluginPrivatePCH.h"
 #include "BrickRenderComponent.h"
 #include "BrickGridComponent.h"
+#include "BrickMesher.h"
 #include "BrickAmbientOcclusion.inl"
 
-// Maps brick corner indices to 3D coordinates.
-static FInt3 GetCornerVertexOffset(uint8 BrickVertexIndex)
-{
-	return (FInt3::Scalar(BrickVertexIndex) >> FInt3(2,1,0)) & FInt3::Scalar(1);
-}
-// Maps face index and face vertex index to brick corner indices.
-static const uint8 FaceVertices[6][4] =
-{
-	{ 2, 3, 1, 0 },		// -X
-	{ 4, 5, 7, 6 },		// +X
-	{ 0, 1, 5, 4 },		// -Y
-	{ 6, 7, 3, 2 },		// +Y
-	{ 4, 6, 2, 0 },	// -Z
-	{ 1, 3, 7, 5 }		// +Z
-};
+DECLARE_STATS_GROUP(TEXT("BrickGrid"),STATGROUP_BrickGrid,STATCAT_Advanced);
+DECLARE_MEMORY_STAT(TEXT("Chunk Vertex Memory"),STAT_BrickChunkVertexMemory,STATGROUP_BrickGrid);
+DECLARE_MEMORY_STAT(TEXT("Chunk Index Memory"),STAT_BrickChunkIndexMemory,STATGROUP_BrickGrid);
+
 // Maps face index to normal.
 const FInt3 FaceNormals[6] =
 {
@@ -31,26 +21,56 @@ const FInt3 FaceNormals[6] =
 	FInt3(0, 0, +1)
 };
 
-enum class EBrickClass
+/**	An element of the position vertex buffer given to the GPU by the CPU brick tessellator.
+	8-bit coordinates are used for efficiency, and 16-bit coordinates for chunks too large to address with 8 bits. */
+template<typename CoordinateType>
+struct TBrickVertex
 {
-	Empty = 0,
-	Translucent = 1,
-	Opaque = 2,
-	Count = 3
+	CoordinateType X;
+	CoordinateType Y;
+	CoordinateType Z;
+	CoordinateType W;
+
+	TBrickVertex() {}
+	TBrickVertex(FInt3 InCoordinates)
+	: X(InCoordinates.X), Y(InCoordinates.Y), Z(InCoordinates.Z), W(TNumericLimits<CoordinateType>::Max())
+	{}
+
+	FInt3 GetCoordinates() const { return FInt3(X,Y,Z); }
 };
+typedef TBrickVertex<uint8> FBrickVertex;
 
-/**	An element of the vertex buffer given to the GPU by the CPU brick tessellator.
-	8-bit coordinates are used for efficiency. */
-struct FBrickVertex
+/**	A 16-bit vertex also carries its texture coordinates, since normalizing its coordinates would scale them by 1/65535 instead of the 1/255 of 8-bit vertices.
+	The texture coordinates are the normalized coordinates of an 8-bit vertex, packed as halfs. Halfs round them by at most 1/8 of a brick for coordinates
+	up to 510, and 1/4 of a brick for coordinates up to 1020. */
+struct FBrickVertex16 : TBrickVertex<uint16>
 {
-	uint8 X;
-	uint8 Y;
-	uint8 Z;
+	FFloat16 TextureCoordinates[4];
+
+	FBrickVertex16() {}
+	FBrickVertex16(FInt3 InCoordinates)
+	: TBrickVertex<uint16>(InCoordinates)
+	{
+		TextureCoordinates[0] = FFloat16(InCoordinates.X / 255.0f);
+		TextureCoordinates[1] = FFloat16(InCoordinates.Y / 255.0f);
+		TextureCoordinates[2] = FFloat16(InCoordinates.Z / 255.0f);
+		TextureCoordinates[3] = FFloat16(1.0f);
+	}
+};
+
+/**	An element of the ambient occlusion vertex buffer, which is a separate stream so it can be updated without rebuilding the chunk's geometry.
+	The ambient occlusion is in the alpha component. 16-bit positions don't fit in the color, so no vertex format repeats its position in the RGB components:
+	they are white, like the vertex color of meshes that don't have one, so materials see the same vertex color for every chunk. */
+struct FBrickVertexColor
+{
+	uint8 R;
+	uint8 G;
+	uint8 B;
 	uint8 AmbientOcclusionFactor;
 
-	FBrickVertex() {}
-	FBrickVertex(FInt3 InCoordinates,uint8 InAmbientOcclusionFactor)
-	: X(InCoordinates.X), Y(InCoordinates.Y), Z(InCoordinates.Z), AmbientOcclusionFactor(InAmbientOcclusionFactor)
+	FBrickVertexColor() {}
+	FBrickVertexColor(uint8 InAmbientOcclusionFactor)
+	: R(255), G(255), B(255), AmbientOcclusionFactor(InAmbientOcclusionFactor)
 	{}
 };
 
@@ -58,38 +78,167 @@ struct FBrickVertex
 class FBrickChunkVertexBuffer : public FVertexBuffer 
 {
 public:
+	// Whether the vertices use 16-bit coordinates. Only the matching vertex array is used.
+	bool Use16BitPositions;
+	// Whether to keep the CPU copy of the vertices after uploading them, so the proxy can recompute their ambient occlusion.
+	bool KeepCPUVertices;
 	TArray<FBrickVertex> Vertices;
+	TArray<FBrickVertex16> Vertices16;
+
+	FBrickChunkVertexBuffer(): Use16BitPositions(false), KeepCPUVertices(true), NumVertices(0) {}
+
+	int32 GetNumVertices() const { return NumVertices; }
+	uint32 GetStride() const { return Use16BitPositions ? sizeof(FBrickVertex16) : sizeof(FBrickVertex); }
+	FInt3 GetVertexCoordinates(int32 VertexIndex) const { return Use16BitPositions ? Vertices16[VertexIndex].GetCoordinates() : Vertices[VertexIndex].GetCoordinates(); }
+	void AddVertex(const FInt3 Coordinates)
+	{
+		if(Use16BitPositions)
+		{
+			new(Vertices16) FBrickVertex16(Coordinates);
+		}
+		else
+		{
+			new(Vertices) FBrickVertex(Coordinates);
+		}
+		++NumVertices;
+	}
+
 	virtual void InitRHI()
 	{
-		if (Vertices.Num() > 0)
+		// If the vertices were discarded after a previous upload, the buffer can't be recreated, so leave it empty rather than reading the discarded arrays.
+		NumVertices = Use16BitPositions ? Vertices16.Num() : Vertices.Num();
+		if (NumVertices > 0)
 		{
+			const uint32 Size = NumVertices * GetStride();
+			const void* Data = Use16BitPositions ? (const void*)Vertices16.GetData() : (const void*)Vertices.GetData();
 			FRHIResourceCreateInfo CreateInfo;
-			VertexBufferRHI = RHICreateVertexBuffer(Vertices.Num() * sizeof(FBrickVertex), BUF_Dynamic, CreateInfo);
+			VertexBufferRHI = RHICreateVertexBuffer(Size, BUF_Static, CreateInfo);
 			// Copy the vertex data into the vertex buffer.
-			void* VertexBufferData = RHILockVertexBuffer(VertexBufferRHI, 0, Vertices.Num() * sizeof(FBrickVertex), RLM_WriteOnly);
-			FMemory::Memcpy(VertexBufferData, Vertices.GetData(), Vertices.Num() * sizeof(FBrickVertex));
+			void* VertexBufferData = RHILockVertexBuffer(VertexBufferRHI, 0, Size, RLM_WriteOnly);
+			FMemory::Memcpy(VertexBufferData, Data, Size);
 			RHIUnlockVertexBuffer(VertexBufferRHI);
+			INC_MEMORY_STAT_BY(STAT_BrickChunkVertexMemory, Size);
+
+			// Like static meshes without CPU access, the vertices are discarded once they are on the GPU.
+			if(!KeepCPUVertices)
+			{
+				Vertices.Empty();
+				Vertices16.Empty();
+			}
+		}
+	}
+	virtual void ReleaseRHI()
+	{
+		if (IsValidRef(VertexBufferRHI))
+		{
+			DEC_MEMORY_STAT_BY(STAT_BrickChunkVertexMemory, NumVertices * GetStride());
 		}
+		FVertexBuffer::ReleaseRHI();
 	}
+
+private:
+
+	int32 NumVertices;
+};
+
+/** Ambient occlusion vertex buffer */
+class FBrickChunkColorVertexBuffer : public FVertexBuffer 
+{
+public:
+	// The initial colors, which are discarded once they are uploaded.
+	TArray<FBrickVertexColor> Colors;
+
+	FBrickChunkColorVertexBuffer(): NumColors(0) {}
+
+	virtual void InitRHI()
+	{
+		NumColors = Colors.Num();
+		if (NumColors > 0)
+		{
+			FRHIResourceCreateInfo CreateInfo;
+			VertexBufferRHI = RHICreateVertexBuffer(NumColors * sizeof(FBrickVertexColor), BUF_Dynamic, CreateInfo);
+			INC_MEMORY_STAT_BY(STAT_BrickChunkVertexMemory, NumColors * sizeof(FBrickVertexColor));
+			Upload(Colors);
+			Colors.Empty();
+		}
+	}
+	virtual void ReleaseRHI()
+	{
+		if (IsValidRef(VertexBufferRHI))
+		{
+			DEC_MEMORY_STAT_BY(STAT_BrickChunkVertexMemory, NumColors * sizeof(FBrickVertexColor));
+		}
+		FVertexBuffer::ReleaseRHI();
+	}
+	// Copies a color for each vertex into the vertex buffer.
+	void Upload(const TArray<FBrickVertexColor>& NewColors)
+	{
+		check(IsInRenderingThread());
+		if (IsValidRef(VertexBufferRHI))
+		{
+			check(NewColors.Num() == NumColors);
+			void* VertexBufferData = RHILockVertexBuffer(VertexBufferRHI, 0, NumColors * sizeof(FBrickVertexColor), RLM_WriteOnly);
+			FMemory::Memcpy(VertexBufferData, NewColors.GetData(), NumColors * sizeof(FBrickVertexColor));
+			RHIUnlockVertexBuffer(VertexBufferRHI);
+		}
+	}
+
+private:
+
+	int32 NumColors;
 };
 
 /** Index Buffer */
 class FBrickChunkIndexBuffer : public FIndexBuffer 
 {
 public:
-	TArray<uint16> Indices;
+	// The indices, which are discarded once they are uploaded.
+	TArray<uint32> Indices;
+	// Whether the GPU index buffer uses 32-bit indices. Otherwise, the indices are narrowed to 16 bits when they are uploaded.
+	bool Use32BitIndices;
+
+	FBrickChunkIndexBuffer(): Use32BitIndices(false), GPUSize(0) {}
+
 	virtual void InitRHI()
 	{
+		GPUSize = 0;
 		if (Indices.Num() > 0)
 		{
+			const uint32 Stride = Use32BitIndices ? sizeof(uint32) : sizeof(uint16);
+			GPUSize = Indices.Num() * Stride;
 			FRHIResourceCreateInfo CreateInfo;
-			IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint16), Indices.Num() * sizeof(uint16), BUF_Static, CreateInfo);
+			IndexBufferRHI = RHICreateIndexBuffer(Stride, GPUSize, BUF_Static, CreateInfo);
 			// Write the indices to the index buffer.
-			void* Buffer = RHILockIndexBuffer(IndexBufferRHI, 0, Indices.Num() * sizeof(uint16), RLM_WriteOnly);
-			FMemory::Memcpy(Buffer, Indices.GetData(), Indices.Num() * sizeof(uint16));
+			void* Buffer = RHILockIndexBuffer(IndexBufferRHI, 0, GPUSize, RLM_WriteOnly);
+			if(Use32BitIndices)
+			{
+				FMemory::Memcpy(Buffer, Indices.GetData(), Indices.Num() * sizeof(uint32));
+			}
+			else
+			{
+				uint16* Buffer16 = (uint16*)Buffer;
+				for(int32 Index = 0;Index < Indices.Num();++Index)
+				{
+					Buffer16[Index] = (uint16)Indices[Index];
+				}
+			}
 			RHIUnlockIndexBuffer(IndexBufferRHI);
+			INC_MEMORY_STAT_BY(STAT_BrickChunkIndexMemory, GPUSize);
+			Indices.Empty();
 		}
 	}
+	virtual void ReleaseRHI()
+	{
+		if (IsValidRef(IndexBufferRHI))
+		{
+			DEC_MEMORY_STAT_BY(STAT_BrickChunkIndexMemory, GPUSize);
+		}
+		FIndexBuffer::ReleaseRHI();
+	}
+
+private:
+
+	uint32 GPUSize;
 };
 
 /** Tangent Buffer */
@@ -122,16 +271,24 @@ class FBrickChunkVertexFactory : public FLocalVertexFactory
 {
 public:
 
-	void Init(const FBrickChunkVertexBuffer& VertexBuffer,const FPrimitiveSceneProxy* InPrimitiveSceneProxy,uint8 InFaceIndex)
+	void Init(const FBrickChunkVertexBuffer& VertexBuffer,const FBrickChunkColorVertexBuffer& ColorVertexBuffer,const FPrimitiveSceneProxy* InPrimitiveSceneProxy,uint8 InFaceIndex)
 	{
 		PrimitiveSceneProxy = InPrimitiveSceneProxy;
 		FaceIndex = InFaceIndex;
 
 		// Initialize the vertex factory's stream components.
 		DataType NewData;
-		NewData.PositionComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex, X, VET_UByte4N);
-		NewData.TextureCoordinates.Add(STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex, X, VET_UByte4N));
-		NewData.ColorComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex, X, VET_Color);
+		if(VertexBuffer.Use16BitPositions)
+		{
+			NewData.PositionComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex16, X, VET_UShort4N);
+			NewData.TextureCoordinates.Add(STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex16, TextureCoordinates, VET_Half4));
+		}
+		else
+		{
+			NewData.PositionComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex, X, VET_UByte4N);
+			NewData.TextureCoordinates.Add(STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&VertexBuffer, FBrickVertex, X, VET_UByte4N));
+		}
+		NewData.ColorComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(&ColorVertexBuffer, FBrickVertexColor, R, VET_Color);
 		// Use a stride of 0 to use the same TangentX/TangentZ for all faces using this vertex factory.
 		NewData.TangentBasisComponents[0] = FVertexStreamComponent(&TangentBuffer,sizeof(FPackedNormal) * (2 * FaceIndex + 0),0,VET_PackedNormal);
 		NewData.TangentBasisComponents[1] = FVertexStreamComponent(&TangentBuffer,sizeof(FPackedNormal) * (2 * FaceIndex + 1),0,VET_PackedNormal);
@@ -183,6 +340,7 @@ class FBrickChunkSceneProxy : public FPrimitiveSceneProxy
 public:
 
 	FBrickChunkVertexBuffer VertexBuffer;
+	FBrickChunkColorVertexBuffer ColorVertexBuffer;
 	FBrickChunkIndexBuffer IndexBuffer;
 	FBrickChunkVertexFactory VertexFactories[6];
 
@@ -202,11 +360,12 @@ public:
 
 	FGraphEventRef SetupCompletionEvent;
 
-	TArray<uint8> LocalBrickMaterials;
+	// Whether the grid's cave culling found that the chunk can't be seen from the viewer.
+	bool IsCaveCulled;
 
-	FBrickChunkSceneProxy(UBrickRenderComponent* Component,const TArray<uint8>&& InLocalBrickMaterials)
+	FBrickChunkSceneProxy(UBrickRenderComponent* Component)
 	: FPrimitiveSceneProxy(Component)
-	, LocalBrickMaterials(InLocalBrickMaterials)
+	, IsCaveCulled(Component->IsCaveCulled)
 	{}
 
 	void BeginInitResources()
@@ -217,10 +376,11 @@ public:
 			FTaskGraphInterface::Get().WaitUntilTaskCompletes(SetupCompletionEvent,ENamedThreads::RenderThread);
 		});
 		BeginInitResource(&VertexBuffer);
+		BeginInitResource(&ColorVertexBuffer);
 		BeginInitResource(&IndexBuffer);
 		for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
 		{
-			VertexFactories[FaceIndex].Init(VertexBuffer,this,FaceIndex);
+			VertexFactories[FaceIndex].Init(VertexBuffer,ColorVertexBuffer,this,FaceIndex);
 			BeginInitResource(&VertexFactories[FaceIndex]);
 		}
 	}
@@ -228,6 +388,7 @@ public:
 	virtual ~FBrickChunkSceneProxy()
 	{
 		VertexBuffer.ReleaseResource();
+		ColorVertexBuffer.ReleaseResource();
 		IndexBuffer.ReleaseResource();
 		for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
 		{
@@ -235,10 +396,26 @@ public:
 		}
 	}
 
+	// Replaces the ambient occlusion factors of the existing vertices, and uploads them to the GPU without touching the chunk's geometry.
+	// Requires the proxy to have kept the CPU copy of its vertices.
+	void UpdateAmbientOcclusion_RenderThread(const TArray<uint8>& LocalVertexAmbientFactors,const FInt3 LocalVertexDim)
+	{
+		check(VertexBuffer.KeepCPUVertices);
+		TArray<FBrickVertexColor> Colors;
+		Colors.SetNumUninitialized(VertexBuffer.GetNumVertices());
+		for(int32 VertexIndex = 0;VertexIndex < VertexBuffer.GetNumVertices();++VertexIndex)
+		{
+			const FInt3 Vertex = VertexBuffer.GetVertexCoordinates(VertexIndex);
+			Colors[VertexIndex] = FBrickVertexColor(LocalVertexAmbientFactors[(Vertex.Y * LocalVertexDim.X + Vertex.X) * LocalVertexDim.Z + Vertex.Z]);
+		}
+		ColorVertexBuffer.Upload(Colors);
+	}
+
 	virtual void OnTransformChanged() override
 	{
-		// Create a uniform buffer with the transform for the chunk.
-		PrimitiveUniformBuffer = CreatePrimitiveUniformBufferImmediate(FScaleMatrix(FVector(255, 255, 255)) * GetLocalToWorld(), GetBounds(), GetLocalBounds(), true, UseEditorDepthTest());
+		// Create a uniform buffer with the transform for the chunk, scaled to undo the normalization of the vertex positions.
+		const float PositionScale = VertexBuffer.Use16BitPositions ? 65535.0f : 255.0f;
+		PrimitiveUniformBuffer = CreatePrimitiveUniformBufferImmediate(FScaleMatrix(FVector(PositionScale, PositionScale, PositionScale)) * GetLocalToWorld(), GetBounds(), GetLocalBounds(), true, UseEditorDepthTest());
 	}
 
 	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views,const FSceneViewFamily& ViewFamily,uint32 VisibilityMap,class FMeshElementCollector& Collector) const override
@@ -251,7 +428,7 @@ public:
 		Collector.RegisterOneFrameMaterialProxy(WireframeMaterialFace);
 
 		// Draw the mesh elements in each view they are visible.
-		for(int32 ElementIndex = 0; ElementIndex < Elements.Num(); ++ElementIndex)
+		for(int32 ElementIndex = 0; ElementIndex < Elements.Num() && HasRHIBuffers(); ++ElementIndex)
 		{
 			FMeshBatch& Batch = Collector.AllocateMesh();
 			InitMeshBatch(Batch,ElementIndex,ViewFamily.EngineShowFlags.Wireframe ? WireframeMaterialFace : NULL);
@@ -268,7 +445,7 @@ public:
 
 	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) override
 	{
-		for(int32 ElementIndex = 0; ElementIndex < Elements.Num(); ++ElementIndex)
+		for(int32 ElementIndex = 0; ElementIndex < Elements.Num() && HasRHIBuffers(); ++ElementIndex)
 		{
 			FMeshBatch Batch;
 			InitMeshBatch(Batch,ElementIndex,NULL);
@@ -279,7 +456,7 @@ public:
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override
 	{
 		FPrimitiveViewRelevance Result;
-		Result.bDrawRelevance = IsShown(View);
+		Result.bDrawRelevance = IsShown(View) && !IsCaveCulled;
 		Result.bShadowRelevance = IsShadowCast(View);
 		Result.bDynamicRelevance = View->Family->EngineShowFlags.Wireframe || IsSelected();
 		Result.bStaticRelevance = !Result.bDynamicRelevance;
@@ -293,7 +470,24 @@ public:
 	}
 
 	virtual uint32 GetMemoryFootprint(void) const { return(sizeof(*this) + GetAllocatedSize()); }
-	uint32 GetAllocatedSize( void ) const { return( FPrimitiveSceneProxy::GetAllocatedSize() ); }
+	uint32 GetAllocatedSize( void ) const
+	{
+		// The GPU copies of the vertices and indices are tracked by the BrickGrid memory stats.
+		return FPrimitiveSceneProxy::GetAllocatedSize()
+			+ VertexBuffer.Vertices.GetAllocatedSize()
+			+ VertexBuffer.Vertices16.GetAllocatedSize()
+			+ ColorVertexBuffer.Colors.GetAllocatedSize()
+			+ IndexBuffer.Indices.GetAllocatedSize()
+			+ Elements.GetAllocatedSize()
+			+ Materials.GetAllocatedSize();
+	}
+
+	// Whether the GPU buffers exist. They're missing if the RHI resources were reinitialized after the CPU copies were discarded,
+	// in which case the chunk isn't drawn until it's rebuilt.
+	bool HasRHIBuffers() const
+	{
+		return IsValidRef(VertexBuffer.VertexBufferRHI) && IsValidRef(ColorVertexBuffer.VertexBufferRHI) && IsValidRef(IndexBuffer.IndexBufferRHI);
+	}
 
 	void InitMeshBatch(FMeshBatch& OutBatch,int32 ElementIndex,FMaterialRenderProxy* WireframeMaterialFace) const
 	{
@@ -309,7 +503,7 @@ public:
 		OutBatch.Elements[0].FirstIndex = Element.FirstIndex;
 		OutBatch.Elements[0].NumPrimitives = Element.NumPrimitives;
 		OutBatch.Elements[0].MinVertexIndex = 0;
-		OutBatch.Elements[0].MaxVertexIndex = VertexBuffer.Vertices.Num() - 1;
+		OutBatch.Elements[0].MaxVertexIndex = VertexBuffer.GetNumVertices() - 1;
 		OutBatch.Elements[0].IndexBuffer = &IndexBuffer;
 		OutBatch.Elements[0].PrimitiveUniformBuffer = PrimitiveUniformBuffer;
 		OutBatch.Elements[0].UserIndex = Element.FaceIndex;
@@ -324,243 +518,490 @@ UBrickRenderComponent::UBrickRenderComponent( const FObjectInitializer& Initiali
 	bUseAsOccluder = true;
 	bCanEverAffectNavigation = true;	
 	bAutoRegister = false;
+	IsCaveCulled = false;
+	IsMeshBuilt = false;
+	FaceConnectivity = BrickMesher::AllFacesConnected;
 
 	SetCollisionProfileName(UCollisionProfile::NoCollision_ProfileName);
 }
 
-FPrimitiveSceneProxy* UBrickRenderComponent::CreateSceneProxy()
+// Converts a brick grid vector to the mesher's vector type.
+static BrickMesher::FSize3 ToMesherSize(const FInt3& Vector)
 {
-	const double StartTime = FPlatformTime::Seconds();
-	TArray<EBrickClass> BrickClassByMaterial;
-	for (int32 MaterialIndex = 0; MaterialIndex < Grid->Parameters.Materials.Num(); ++MaterialIndex)
+	return BrickMesher::FSize3(Vector.X,Vector.Y,Vector.Z);
+}
+
+// Computes the ambient occlusion factor for each full resolution vertex of a box of bricks.
+static void ComputeVertexAmbientOcclusion(const UBrickGridComponent* Grid,const FInt3 MinBrickCoordinates,const FInt3 BricksDim,TArray<uint8>& OutLocalVertexAmbientFactors)
+{
+	const FInt3 LocalVertexDim = BricksDim + FInt3::Scalar(1);
+	OutLocalVertexAmbientFactors.SetNumUninitialized(LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z);
+
+	const FInt3 AdjacentBricksDim = LocalVertexDim + FInt3::Scalar(1);
+	if(Grid->Parameters.EnableLightPropagation)
 	{
-		if (MaterialIndex == Grid->Parameters.EmptyMaterialIndex)
-		{
-			BrickClassByMaterial.Add(EBrickClass::Empty);
-		}
-		else
+		// Average the grid's propagated light of the non-opaque bricks adjacent to each vertex.
+		TArray<uint8> AdjacentBrickLight;
+		TArray<uint8> AdjacentBrickMaterials;
+		AdjacentBrickLight.SetNumUninitialized(AdjacentBricksDim.X * AdjacentBricksDim.Y * AdjacentBricksDim.Z);
+		AdjacentBrickMaterials.SetNumUninitialized(AdjacentBricksDim.X * AdjacentBricksDim.Y * AdjacentBricksDim.Z);
+		Grid->GetBrickLightArray(MinBrickCoordinates - FInt3::Scalar(1),MinBrickCoordinates + BricksDim,AdjacentBrickLight);
+		Grid->GetBrickMaterialArray(MinBrickCoordinates - FInt3::Scalar(1),MinBrickCoordinates + BricksDim,AdjacentBrickMaterials);
+		BrickMesher::ComputeVertexLight(AdjacentBrickLight.GetData(),AdjacentBrickMaterials.GetData(),Grid->BrickClassByMaterial.GetData(),ToMesherSize(LocalVertexDim),OutLocalVertexAmbientFactors.GetData());
+		return;
+	}
+
+	// Average the grid's blurred sky visibility of the bricks adjacent to each vertex.
+	TArray<uint8> BlurredSkyVisibility;
+	BlurredSkyVisibility.SetNumUninitialized(AdjacentBricksDim.X * AdjacentBricksDim.Y * AdjacentBricksDim.Z);
+	if(Grid->GetBlurredSkyVisibility(MinBrickCoordinates - FInt3::Scalar(1),MinBrickCoordinates + BricksDim,BlurredSkyVisibility))
+	{
+		BrickMesher::ComputeVertexAmbientOcclusion(BlurredSkyVisibility.GetData(),ToMesherSize(LocalVertexDim),OutLocalVertexAmbientFactors.GetData());
+	}
+	else
+	{
+		// Some of the adjacent bricks are in regions that haven't been created, so blur the sky visibility from the height map of the columns within the blur radius of the box's vertices.
+		const FInt3 LocalBrickExpansion(Grid->Parameters.AmbientOcclusionBlurRadius + 1,Grid->Parameters.AmbientOcclusionBlurRadius + 1,1);
+		const FInt3 MinLocalBrickCoordinates = MinBrickCoordinates - LocalBrickExpansion;
+		const FInt3 LocalBricksDim = BricksDim + LocalBrickExpansion * FInt3::Scalar(2);
+		ComputeChunkAO(Grid,MinLocalBrickCoordinates,LocalBrickExpansion,LocalBricksDim,LocalVertexDim,OutLocalVertexAmbientFactors);
+	}
+}
+
+// Downsamples a box of brick materials by an integer factor, choosing the most common material in each block of source bricks.
+// Ties are broken in favor of the material with the highest brick class, so thin surfaces don't disappear at lower resolutions.
+static void DownsampleBrickMaterials(
+	const TArray<uint8>& SourceBrickMaterials,
+	const FInt3 SourceBricksDim,
+	const int32 Factor,
+	const TArray<EBrickClass>& BrickClassByMaterial,
+	TArray<uint8>& OutBrickMaterials
+	)
+{
+	const FInt3 OutputBricksDim = SourceBricksDim / FInt3::Scalar(Factor);
+	OutBrickMaterials.SetNumUninitialized(OutputBricksDim.X * OutputBricksDim.Y * OutputBricksDim.Z);
+
+	uint32 MaterialCounts[256] = { 0 };
+	for(int32 OutputY = 0;OutputY < OutputBricksDim.Y;++OutputY)
+	{
+		for(int32 OutputX = 0;OutputX < OutputBricksDim.X;++OutputX)
 		{
-			if (Grid->Parameters.Materials[MaterialIndex].SurfaceMaterial->GetBlendMode() == EBlendMode::BLEND_Opaque)
+			for(int32 OutputZ = 0;OutputZ < OutputBricksDim.Z;++OutputZ)
 			{
-				BrickClassByMaterial.Add(EBrickClass::Opaque);
-			}
-			else
-			{
-				BrickClassByMaterial.Add(EBrickClass::Translucent);
+				// Count the occurrences of each material in the block of source bricks.
+				uint8 MajorityMaterial = SourceBrickMaterials[((OutputY * Factor) * SourceBricksDim.X + OutputX * Factor) * SourceBricksDim.Z + OutputZ * Factor];
+				for(int32 SourceY = OutputY * Factor;SourceY < (OutputY + 1) * Factor;++SourceY)
+				{
+					for(int32 SourceX = OutputX * Factor;SourceX < (OutputX + 1) * Factor;++SourceX)
+					{
+						for(int32 SourceZ = OutputZ * Factor;SourceZ < (OutputZ + 1) * Factor;++SourceZ)
+						{
+							const uint8 SourceMaterial = SourceBrickMaterials[(SourceY * SourceBricksDim.X + SourceX) * SourceBricksDim.Z + SourceZ];
+							const uint32 SourceMaterialCount = ++MaterialCounts[SourceMaterial];
+							if(	SourceMaterialCount > MaterialCounts[MajorityMaterial]
+							||	(SourceMaterialCount == MaterialCounts[MajorityMaterial] && BrickClassByMaterial[SourceMaterial] > BrickClassByMaterial[MajorityMaterial]))
+							{
+								MajorityMaterial = SourceMaterial;
+							}
+						}
+					}
+				}
+				OutBrickMaterials[(OutputY * OutputBricksDim.X + OutputX) * OutputBricksDim.Z + OutputZ] = MajorityMaterial;
+
+				// Reset the counts for the next block.
+				for(int32 SourceY = OutputY * Factor;SourceY < (OutputY + 1) * Factor;++SourceY)
+				{
+					for(int32 SourceX = OutputX * Factor;SourceX < (OutputX + 1) * Factor;++SourceX)
+					{
+						for(int32 SourceZ = OutputZ * Factor;SourceZ < (OutputZ + 1) * Factor;++SourceZ)
+						{
+							MaterialCounts[SourceBrickMaterials[(SourceY * SourceBricksDim.X + SourceX) * SourceBricksDim.Z + SourceZ]] = 0;
+						}
+					}
+				}
 			}
-			
 		}
 	}
+}
+
+// The ambient occlusion for a chunk's vertices, computed by a worker task for the chunk's scene proxy at the time.
+struct FBrickAmbientOcclusionUpdate
+{
+	// The proxy the ambient occlusion is for, or NULL if the proxy has been recreated since, and computed its own ambient occlusion.
+	FBrickChunkSceneProxy* SceneProxy;
+	FInt3 LocalVertexDim;
+	TArray<uint8> LocalVertexAmbientFactors;
+};
+
+// The results of a chunk's mesh build task that the component uses on the game thread. The mesh itself is written to the scene proxy.
+struct FBrickChunkMeshBuild
+{
+	uint32 FaceConnectivity;
+};
+
+FPrimitiveSceneProxy* UBrickRenderComponent::CreateSceneProxy()
+{
+	const double StartTime = FPlatformTime::Seconds();
 	HasLowPriorityUpdatePending = false;
+	HasDeferredRebuildPending = false;
 
-	const FInt3 MinBrickCoordinates = Coordinates << Grid->BricksPerRenderChunkLog2;
-	const FInt3 LocalBrickExpansion(Grid->Parameters.AmbientOcclusionBlurRadius + 1,Grid->Parameters.AmbientOcclusionBlurRadius + 1,1);
-	const FInt3 MinLocalBrickCoordinates = MinBrickCoordinates - LocalBrickExpansion;
+	// The new proxy computes its own ambient occlusion, so discard any that is still being computed for the old proxy.
+	if(PendingAmbientOcclusionUpdate.IsValid())
+	{
+		PendingAmbientOcclusionUpdate->SceneProxy = NULL;
+	}
+
+	// The old proxy's mesh build is superseded, but it may still be reading the grid, so keep its event for BeginDestroy to wait on.
+	if(PendingMeshBuildEvent.IsValid() && !PendingMeshBuildEvent->IsComplete())
+	{
+		SupersededMeshBuildEvents.Add(PendingMeshBuildEvent);
+	}
+	PendingMeshBuild.Reset();
+	PendingMeshBuildEvent = NULL;
 
-	// Read the brick materials for all the bricks that affect this chunk.
-	const FInt3 LocalBricksDim = Grid->BricksPerRenderChunk + LocalBrickExpansion * FInt3::Scalar(2);
-	TArray<uint8> LocalBrickMaterialsGameThread;
-	LocalBrickMaterialsGameThread.SetNumUninitialized(LocalBricksDim.X * LocalBricksDim.Y * LocalBricksDim.Z);
-	Grid->GetBrickMaterialArray(MinLocalBrickCoordinates,MinLocalBrickCoordinates + LocalBricksDim - FInt3::Scalar(1),LocalBrickMaterialsGameThread);
+	// At LOD N, the chunk is meshed from bricks that each cover 2^N bricks along each axis.
+	const int32 LODScale = 1 << LOD;
+	const FInt3 BricksDim = GetBricksDim();
+	const FInt3 MeshBricksDim = BricksDim / FInt3::Scalar(LODScale);
+	const FInt3 MinBrickCoordinates = GetMinBrickCoordinates();
 
-	// Check whether there are any non-empty bricks in this chunk.
-	bool HasNonEmptyBrick = false;
-	const int32 EmptyMaterialIndex = Grid->Parameters.EmptyMaterialIndex;
-	for(int32 LocalBrickY = LocalBrickExpansion.Y; LocalBrickY < Grid->BricksPerRenderChunk.Y + LocalBrickExpansion.Y && !HasNonEmptyBrick; ++LocalBrickY)
+	// Find the sides of the chunk that face a higher resolution neighbor, and so need to be sealed.
+	uint32 SealedFaceMask = 0;
+	if(LOD > 0)
 	{
-		for(int32 LocalBrickX = LocalBrickExpansion.X; LocalBrickX < Grid->BricksPerRenderChunk.X + LocalBrickExpansion.X && !HasNonEmptyBrick; ++LocalBrickX)
+		for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
 		{
-			for(int32 LocalBrickZ = LocalBrickExpansion.Z; LocalBrickZ < Grid->BricksPerRenderChunk.Z + LocalBrickExpansion.Z && !HasNonEmptyBrick; ++LocalBrickZ)
+			FInt3 MinNeighborBrickCoordinates;
+			FInt3 MaxNeighborBrickCoordinates;
+			GetFaceAdjacentBricks(MinBrickCoordinates,MinBrickCoordinates + BricksDim - FInt3::Scalar(1),FaceIndex,MinNeighborBrickCoordinates,MaxNeighborBrickCoordinates);
+			if(Grid->GetMinRenderLOD(MinNeighborBrickCoordinates,MaxNeighborBrickCoordinates,LOD) < LOD)
 			{
-				const uint32 LocalBrickIndex = (LocalBrickY * LocalBricksDim.X + LocalBrickX) * LocalBricksDim.Z + LocalBrickZ;
-				if(LocalBrickMaterialsGameThread[LocalBrickIndex] != EmptyMaterialIndex)
-				{
-					HasNonEmptyBrick = true;
-				}
+				SealedFaceMask |= 1 << FaceIndex;
 			}
 		}
 	}
 
-	// Only create a scene proxy if there are some non-empty bricks in the chunk.
-	FBrickChunkSceneProxy* BrickSceneProxy = NULL;
-	if(HasNonEmptyBrick)
+	// Find the bricks beyond the chunk's sides that are drawn by lower resolution neighbors.
+	TArray<FBrickRenderSeam> LowerResolutionSeams;
+	Grid->GetLowerResolutionSeams(this,LowerResolutionSeams);
+
+	// Use the grid's per-chunk brick counts to skip chunks that can't produce any faces without reading their bricks:
+	// chunks with no non-empty bricks, and chunks that are surrounded by opaque bricks and have no sides to seal or mesh against a lower resolution neighbor.
+	const FInt3 MinRenderChunkCoordinates = Grid->BrickToRenderChunkCoordinates(MinBrickCoordinates);
+	const FInt3 MaxRenderChunkCoordinates = Grid->BrickToRenderChunkCoordinates(MinBrickCoordinates + BricksDim - FInt3::Scalar(1));
+	const EBrickChunkSummary Summary = Grid->GetRenderChunkSummary(MinRenderChunkCoordinates,MaxRenderChunkCoordinates);
+	if(Summary == EBrickChunkSummary::Empty || (Summary == EBrickChunkSummary::Buried && !SealedFaceMask && !LowerResolutionSeams.Num()))
+	{
+		FaceConnectivity = Summary == EBrickChunkSummary::Empty ? BrickMesher::AllFacesConnected : 0;
+		IsMeshBuilt = true;
+		return NULL;
+	}
+
+	const ERHIFeatureLevel::Type SceneFeatureLevel = GetScene()->GetFeatureLevel();
+	const TArray<EBrickClass> BrickClassByMaterial = Grid->BrickClassByMaterial;
+	const int32 EmptyMaterialIndex = Grid->Parameters.EmptyMaterialIndex;
+
+	FBrickChunkSceneProxy* BrickSceneProxy = new FBrickChunkSceneProxy(this);
+
+	// The vertex format must be chosen before the vertex factories are initialized, so base it on the largest possible vertex coordinate.
+	BrickSceneProxy->VertexBuffer.Use16BitPositions = BricksDim.X > 255 || BricksDim.Y > 255 || BricksDim.Z > 255;
+
+	// Only keep the vertices on the CPU if they are needed to update the chunk's ambient occlusion without rebuilding it.
+	#if WITH_GFSDK_VXGI
+		BrickSceneProxy->VertexBuffer.KeepCPUVertices = false;
+	#else
+		BrickSceneProxy->VertexBuffer.KeepCPUVertices = Grid->Parameters.KeepRenderChunkVertices;
+	#endif
+	const EBrickGridWork MeshBuildWork = FInt3::Any(MergedChunksLog2 > FInt3::Scalar(0)) ? EBrickGridWork::SuperChunkMeshBuild : EBrickGridWork::RenderChunkMeshBuild;
+
+	// The task only writes to the proxy and the build result, which the component applies on the game thread in FinishMeshBuild.
+	const TSharedPtr<FBrickChunkMeshBuild,ESPMode::ThreadSafe> MeshBuild = MakeShareable(new FBrickChunkMeshBuild);
+	MeshBuild->FaceConnectivity = BrickMesher::AllFacesConnected;
+	UBrickGridComponent* LocalGrid = Grid;
+	Grid->WorkScheduler.BeginWorkerTask(MeshBuildWork);
+	BrickSceneProxy->SetupCompletionEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([=]()
 	{
-		const ERHIFeatureLevel::Type SceneFeatureLevel = GetScene()->GetFeatureLevel();
+		const double SetupStartTime = FPlatformTime::Seconds();
+		FBrickGridScopedWorkerTask ScopedWorkerTask(LocalGrid->WorkScheduler,MeshBuildWork);
 
-		BrickSceneProxy = new FBrickChunkSceneProxy(this,MoveTemp(LocalBrickMaterialsGameThread));
-		BrickSceneProxy->SetupCompletionEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([=]()
+		// Read the brick materials for all the bricks that affect this chunk: the chunk's bricks plus a border of one mesh brick on each side.
+		const FInt3 LocalBrickExpansion = FInt3::Scalar(1);
+		const FInt3 LocalBricksDim = MeshBricksDim + LocalBrickExpansion * FInt3::Scalar(2);
+		const FInt3 MinLocalBrickCoordinates = MinBrickCoordinates - LocalBrickExpansion * FInt3::Scalar(LODScale);
+		const FInt3 SourceLocalBricksDim = LocalBricksDim * FInt3::Scalar(LODScale);
+		TArray<uint8> LocalBrickMaterials;
+		LocalBrickMaterials.SetNumUninitialized(SourceLocalBricksDim.X * SourceLocalBricksDim.Y * SourceLocalBricksDim.Z);
+		LocalGrid->GetBrickMaterialArray(MinLocalBrickCoordinates,MinLocalBrickCoordinates + SourceLocalBricksDim - FInt3::Scalar(1),LocalBrickMaterials);
+		if(LODScale > 1)
 		{
-			const double SetupStartTime = FPlatformTime::Seconds();
-			const TArray<uint8>& LocalBrickMaterials = BrickSceneProxy->LocalBrickMaterials;
-		
-			struct FFaceBatch
-			{
-				TArray<uint16> Indices;
-			};
-			struct FMaterialBatch
-			{
-				FFaceBatch FaceBatches[6];
-			};
-			TArray<FMaterialBatch> MaterialBatches;
-			MaterialBatches.Init(FMaterialBatch(),Grid->Parameters.Materials.Num());
-
-			// Compute the ambient occlusion for the vertices in this chunk.
-			const FInt3 LocalVertexDim = Grid->BricksPerRenderChunk + FInt3::Scalar(1);
-			#if !WITH_GFSDK_VXGI
-				TArray<uint8> LocalVertexAmbientFactors;
-				LocalVertexAmbientFactors.SetNumUninitialized(LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z);
-				ComputeChunkAO(Grid,MinLocalBrickCoordinates,LocalBrickExpansion,LocalBricksDim,LocalVertexDim,LocalBrickMaterials,LocalVertexAmbientFactors);
-			#endif
-
-			// Create an array of the vertices needed to render this chunk, along with a map from 3D coordinates to indices.
-			TArray<uint16> VertexIndexMap;
-			VertexIndexMap.Empty(LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z);
-			for(int32 LocalVertexY = 0; LocalVertexY < LocalVertexDim.Y; ++LocalVertexY)
+			TArray<uint8> SourceBrickMaterials = MoveTemp(LocalBrickMaterials);
+			DownsampleBrickMaterials(SourceBrickMaterials,SourceLocalBricksDim,LODScale,BrickClassByMaterial,LocalBrickMaterials);
+
+			// Seal the sides of the chunk that face a higher resolution neighbor: treating the border bricks as empty emits faces
+			// on the chunk boundary that cover any gaps between this chunk's surface and the neighbor's.
+			for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
 			{
-				for(int32 LocalVertexX = 0; LocalVertexX < LocalVertexDim.X; ++LocalVertexX)
+				if(SealedFaceMask & (1 << FaceIndex))
 				{
-					for(int32 LocalVertexZ = 0; LocalVertexZ < LocalVertexDim.Z; ++LocalVertexZ)
+					const FInt3 MinBorderBrick = FInt3::Max(FInt3::Scalar(0),FaceNormals[FaceIndex] * (LocalBricksDim - FInt3::Scalar(1)));
+					const FInt3 MaxBorderBrick = FInt3::Min(LocalBricksDim - FInt3::Scalar(1),(FaceNormals[FaceIndex] + FInt3::Scalar(1)) * (LocalBricksDim - FInt3::Scalar(1)));
+					for(int32 LocalBrickY = MinBorderBrick.Y;LocalBrickY <= MaxBorderBrick.Y;++LocalBrickY)
 					{
-						const FInt3 LocalVertexCoordinates(LocalVertexX,LocalVertexY,LocalVertexZ);
-						uint32 HasAdjacentBrickOfClass[(int32)EBrickClass::Count] = { 0 };
-
-						for(uint32 AdjacentBrickIndex = 0;AdjacentBrickIndex < 8;++AdjacentBrickIndex)
+						for(int32 LocalBrickX = MinBorderBrick.X;LocalBrickX <= MaxBorderBrick.X;++LocalBrickX)
 						{
-							const FInt3 LocalBrickCoordinates = LocalVertexCoordinates + GetCornerVertexOffset(AdjacentBrickIndex) + LocalBrickExpansion - FInt3::Scalar(1);
-							const uint32 LocalBrickIndex = (LocalBrickCoordinates.Y * LocalBricksDim.X + LocalBrickCoordinates.X) * LocalBricksDim.Z + LocalBrickCoordinates.Z;
-							
-							const uint32 BrickClass = (uint32)BrickClassByMaterial[LocalBrickMaterials[LocalBrickIndex]];
-							HasAdjacentBrickOfClass[BrickClass] = 1;
-						}
-
-						if ((HasAdjacentBrickOfClass[(int32)EBrickClass::Opaque]
-							+ HasAdjacentBrickOfClass[(int32)EBrickClass::Translucent]
-							+ HasAdjacentBrickOfClass[(int32)EBrickClass::Empty]) > 1)
-						{
-							VertexIndexMap.Add(BrickSceneProxy->VertexBuffer.Vertices.Num());
-							new(BrickSceneProxy->VertexBuffer.Vertices) FBrickVertex(
-								LocalVertexCoordinates,
-								#if WITH_GFSDK_VXGI
-									255
-								#else
-									LocalVertexAmbientFactors[(LocalVertexCoordinates.Y * LocalVertexDim.X + LocalVertexCoordinates.X) * LocalVertexDim.Z + LocalVertexCoordinates.Z]
-								#endif
-								);
-						}
-						else
-						{
-							VertexIndexMap.Add(0);
+							for(int32 LocalBrickZ = MinBorderBrick.Z;LocalBrickZ <= MaxBorderBrick.Z;++LocalBrickZ)
+							{
+								LocalBrickMaterials[(LocalBrickY * LocalBricksDim.X + LocalBrickX) * LocalBricksDim.Z + LocalBrickZ] = EmptyMaterialIndex;
+							}
 						}
 					}
 				}
 			}
+		}
+
+		// Mesh the sides of the chunk that face a lower resolution neighbor against the neighbor's downsampled bricks: the border bricks are replaced with the
+		// neighbor's brick at its LOD, so faces are emitted on the chunk boundary wherever the neighbor's surface leaves this chunk's bricks exposed.
+		for(const FBrickRenderSeam& Seam : LowerResolutionSeams)
+		{
+			// Read and downsample the neighbor's bricks covering the seam. Chunk boundaries are aligned to the neighbor's bricks, so the border bricks
+			// along the face axis, which are one mesh brick thick, are all within the single layer of neighbor bricks adjacent to the chunk.
+			const int32 SeamLODScale = 1 << Seam.LOD;
+			const FInt3 MinSeamBrickCoordinates = FInt3::SignedShiftRight(Seam.MinBrickCoordinates,FInt3::Scalar(Seam.LOD));
+			const FInt3 SeamBricksDim = FInt3::SignedShiftRight(Seam.MaxBrickCoordinates,FInt3::Scalar(Seam.LOD)) - MinSeamBrickCoordinates + FInt3::Scalar(1);
+			const FInt3 SourceSeamBricksDim = SeamBricksDim * FInt3::Scalar(SeamLODScale);
+			const FInt3 MinSourceSeamBrickCoordinates = MinSeamBrickCoordinates * FInt3::Scalar(SeamLODScale);
+			TArray<uint8> SourceSeamBrickMaterials;
+			SourceSeamBrickMaterials.SetNumUninitialized(SourceSeamBricksDim.X * SourceSeamBricksDim.Y * SourceSeamBricksDim.Z);
+			LocalGrid->GetBrickMaterialArray(MinSourceSeamBrickCoordinates,MinSourceSeamBrickCoordinates + SourceSeamBricksDim - FInt3::Scalar(1),SourceSeamBrickMaterials);
+			TArray<uint8> SeamBrickMaterials;
+			DownsampleBrickMaterials(SourceSeamBrickMaterials,SourceSeamBricksDim,SeamLODScale,BrickClassByMaterial,SeamBrickMaterials);
 
-			// Iterate over each brick in the chunk.
-			for(int32 LocalBrickY = LocalBrickExpansion.Y; LocalBrickY < Grid->BricksPerRenderChunk.Y + LocalBrickExpansion.Y; ++LocalBrickY)
+			const FInt3 FaceAxisMask = FaceNormals[Seam.FaceIndex] * FaceNormals[Seam.FaceIndex];
+			const FInt3 MinBorderBrick = FInt3::Max(FInt3::Scalar(0),FaceNormals[Seam.FaceIndex] * (LocalBricksDim - FInt3::Scalar(1)));
+			const FInt3 MaxBorderBrick = FInt3::Min(LocalBricksDim - FInt3::Scalar(1),(FaceNormals[Seam.FaceIndex] + FInt3::Scalar(1)) * (LocalBricksDim - FInt3::Scalar(1)));
+			for(int32 LocalBrickY = MinBorderBrick.Y;LocalBrickY <= MaxBorderBrick.Y;++LocalBrickY)
 			{
-				for(int32 LocalBrickX = LocalBrickExpansion.X; LocalBrickX < Grid->BricksPerRenderChunk.X + LocalBrickExpansion.X; ++LocalBrickX)
+				for(int32 LocalBrickX = MinBorderBrick.X;LocalBrickX <= MaxBorderBrick.X;++LocalBrickX)
 				{
-					for(int32 LocalBrickZ = LocalBrickExpansion.Z; LocalBrickZ < Grid->BricksPerRenderChunk.Z + LocalBrickExpansion.Z; ++LocalBrickZ)
+					for(int32 LocalBrickZ = MinBorderBrick.Z;LocalBrickZ <= MaxBorderBrick.Z;++LocalBrickZ)
 					{
-						// Only draw faces of bricks that aren't empty.
-						const uint32 LocalBrickIndex = (LocalBrickY * LocalBricksDim.X + LocalBrickX) * LocalBricksDim.Z + LocalBrickZ;
-						const uint8 BrickMaterial = LocalBrickMaterials[LocalBrickIndex];
-						if (BrickMaterial != EmptyMaterialIndex)
+						// Only replace the border bricks drawn by this neighbor.
+						const FInt3 BorderBrickCoordinates = MinLocalBrickCoordinates + FInt3(LocalBrickX,LocalBrickY,LocalBrickZ) * FInt3::Scalar(LODScale);
+						const FInt3 SeamBrickCoordinates = BorderBrickCoordinates * (FInt3::Scalar(1) - FaceAxisMask) + Seam.MinBrickCoordinates * FaceAxisMask;
+						if(FInt3::All(SeamBrickCoordinates >= Seam.MinBrickCoordinates) && FInt3::All(SeamBrickCoordinates <= Seam.MaxBrickCoordinates))
 						{
-							const FInt3 RelativeBrickCoordinates = FInt3(LocalBrickX,LocalBrickY,LocalBrickZ) - LocalBrickExpansion;
-							for(uint32 FaceIndex = 0; FaceIndex < 6; ++FaceIndex)
-							{
-								// Only draw faces that face empty bricks.
-								const int32 FacingLocalBrickX = LocalBrickX + FaceNormals[FaceIndex].X;
-								const int32 FacingLocalBrickY = LocalBrickY + FaceNormals[FaceIndex].Y;
-								const int32 FacingLocalBrickZ = LocalBrickZ + FaceNormals[FaceIndex].Z;
-								const uint32 FacingLocalBrickIndex = (FacingLocalBrickY * LocalBricksDim.X + FacingLocalBrickX) * LocalBricksDim.Z + FacingLocalBrickZ;
-								const uint32 FrontBrickMaterial = LocalBrickMaterials[FacingLocalBrickIndex];
-
-								if (BrickClassByMaterial[BrickMaterial] > BrickClassByMaterial[FrontBrickMaterial])
-								{
-									uint16 FaceVertexIndices[4];
-									for (uint32 FaceVertexIndex = 0; FaceVertexIndex < 4; ++FaceVertexIndex)
-									{
-										const FInt3 CornerVertexOffset = GetCornerVertexOffset(FaceVertices[FaceIndex][FaceVertexIndex]);
-										const FInt3 LocalVertexCoordinates = RelativeBrickCoordinates + CornerVertexOffset;
-										FaceVertexIndices[FaceVertexIndex] = VertexIndexMap[(LocalVertexCoordinates.Y * LocalVertexDim.X + LocalVertexCoordinates.X) * LocalVertexDim.Z + LocalVertexCoordinates.Z];
-									}
-
-									// Write the indices for the brick face.
-									FFaceBatch& FaceBatch = MaterialBatches[BrickMaterial].FaceBatches[FaceIndex];
-									uint16* FaceVertexIndex = &FaceBatch.Indices[FaceBatch.Indices.AddUninitialized(6)];
-									*FaceVertexIndex++ = FaceVertexIndices[0];
-									*FaceVertexIndex++ = FaceVertexIndices[1];
-									*FaceVertexIndex++ = FaceVertexIndices[2];
-									*FaceVertexIndex++ = FaceVertexIndices[0];
-									*FaceVertexIndex++ = FaceVertexIndices[2];
-									*FaceVertexIndex++ = FaceVertexIndices[3];
-								}
-							}
+							const FInt3 SeamBrick = FInt3::SignedShiftRight(SeamBrickCoordinates,FInt3::Scalar(Seam.LOD)) - MinSeamBrickCoordinates;
+							LocalBrickMaterials[(LocalBrickY * LocalBricksDim.X + LocalBrickX) * LocalBricksDim.Z + LocalBrickZ] =
+								SeamBrickMaterials[(SeamBrick.Y * SeamBricksDim.X + SeamBrick.X) * SeamBricksDim.Z + SeamBrick.Z];
 						}
 					}
 				}
 			}
+		}
+
+		BrickMesher::FChunkInput MesherInput;
+		MesherInput.LocalBrickMaterials = LocalBrickMaterials.GetData();
+		MesherInput.BricksDim = ToMesherSize(MeshBricksDim);
+		MesherInput.BrickClassByMaterial = BrickClassByMaterial.GetData();
+		MesherInput.NumMaterials = BrickClassByMaterial.Num();
+		MesherInput.EmptyMaterialIndex = EmptyMaterialIndex;
+		MesherInput.VertexScale = LODScale;
+
+		// Compute which of the chunk's faces can see each other for the grid's cave culling.
+		BrickMesher::FChunkMesher Mesher;
+		MeshBuild->FaceConnectivity = Mesher.ComputeFaceConnectivity(MesherInput);
+
+		// Downsampling may have left a mixed chunk without any non-empty bricks.
+		if(!BrickMesher::HasNonEmptyBricks(MesherInput))
+		{
+			return;
+		}
 
-			// Create mesh elements for each batch.
-			int32 NumIndices = 0;
-			for (int32 BrickMaterialIndex = 0; BrickMaterialIndex < MaterialBatches.Num(); ++BrickMaterialIndex)
+		// Compute the ambient occlusion for the full resolution vertices in this chunk.
+		const FInt3 AmbientVertexDim = BricksDim + FInt3::Scalar(1);
+		#if !WITH_GFSDK_VXGI
+			TArray<uint8> LocalVertexAmbientFactors;
+			ComputeVertexAmbientOcclusion(LocalGrid,MinBrickCoordinates,BricksDim,LocalVertexAmbientFactors);
+		#endif
+
+		// Mesh the chunk's bricks. The mesher's vertex positions are always in full resolution brick units, regardless of the chunk's LOD.
+		BrickMesher::FChunkOutput MesherOutput;
+		Mesher.Mesh(MesherInput,MesherOutput);
+
+		// Copy the vertices to the proxy's vertex buffers.
+		BrickSceneProxy->ColorVertexBuffer.Colors.Empty((int32)MesherOutput.Vertices.size());
+		for(const BrickMesher::FVertex& MesherVertex : MesherOutput.Vertices)
+		{
+			const FInt3 AmbientVertexCoordinates(MesherVertex.X,MesherVertex.Y,MesherVertex.Z);
+			BrickSceneProxy->VertexBuffer.AddVertex(AmbientVertexCoordinates);
+			new(BrickSceneProxy->ColorVertexBuffer.Colors) FBrickVertexColor(
+				#if WITH_GFSDK_VXGI
+					255
+				#else
+					LocalVertexAmbientFactors[(AmbientVertexCoordinates.Y * AmbientVertexDim.X + AmbientVertexCoordinates.X) * AmbientVertexDim.Z + AmbientVertexCoordinates.Z]
+				#endif
+				);
+		}
+		BrickSceneProxy->IndexBuffer.Indices.Append(MesherOutput.Indices.data(),(int32)MesherOutput.Indices.size());
+
+		// Map the brick materials to proxy materials.
+		TArray<int32> ProxyMaterialIndices;
+		TArray<int32> TopProxyMaterialIndices;
+		for(int32 BrickMaterialIndex = 0; BrickMaterialIndex < LocalGrid->Parameters.Materials.Num(); ++BrickMaterialIndex)
+		{
+			UMaterialInterface* SurfaceMaterial = LocalGrid->Parameters.Materials[BrickMaterialIndex].SurfaceMaterial;
+			if(SurfaceMaterial == NULL)
 			{
-				for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
-				{
-					NumIndices += MaterialBatches[BrickMaterialIndex].FaceBatches[FaceIndex].Indices.Num();
-				}
+				SurfaceMaterial = UMaterial::GetDefaultMaterial(MD_Surface);
 			}
-			BrickSceneProxy->IndexBuffer.Indices.Empty(NumIndices);
-			for(int32 BrickMaterialIndex = 0; BrickMaterialIndex < MaterialBatches.Num(); ++BrickMaterialIndex)
-			{
-				UMaterialInterface* SurfaceMaterial = Grid->Parameters.Materials[BrickMaterialIndex].SurfaceMaterial;
-				if(SurfaceMaterial == NULL)
-				{
-					SurfaceMaterial = UMaterial::GetDefaultMaterial(MD_Surface);
-				}
-				BrickSceneProxy->MaterialRelevance |= SurfaceMaterial->GetRelevance_Concurrent(SceneFeatureLevel);
-				const int32 ProxyMaterialIndex = BrickSceneProxy->Materials.AddUnique(SurfaceMaterial);
-
-				UMaterialInterface* OverrideTopSurfaceMaterial = Grid->Parameters.Materials[BrickMaterialIndex].OverrideTopSurfaceMaterial;
-				if(OverrideTopSurfaceMaterial)
-				{
-					BrickSceneProxy->MaterialRelevance |= OverrideTopSurfaceMaterial->GetRelevance_Concurrent(SceneFeatureLevel);
-				}
-				const int32 TopProxyMaterialIndex = OverrideTopSurfaceMaterial ? BrickSceneProxy->Materials.AddUnique(OverrideTopSurfaceMaterial) : ProxyMaterialIndex;
+			BrickSceneProxy->MaterialRelevance |= SurfaceMaterial->GetRelevance_Concurrent(SceneFeatureLevel);
+			const int32 ProxyMaterialIndex = BrickSceneProxy->Materials.AddUnique(SurfaceMaterial);
 
-				for(uint32 FaceIndex = 0;FaceIndex < 6;++FaceIndex)
-				{
-					const FFaceBatch& FaceBatch = MaterialBatches[BrickMaterialIndex].FaceBatches[FaceIndex];
-					if (FaceBatch.Indices.Num() > 0)
-					{
-						FBrickChunkSceneProxy::FElement& Element = *new(BrickSceneProxy->Elements)FBrickChunkSceneProxy::FElement;
-						Element.FirstIndex = BrickSceneProxy->IndexBuffer.Indices.Num();
-						Element.NumPrimitives = FaceBatch.Indices.Num() / 3;
-						Element.MaterialIndex = FaceIndex == 5 ? TopProxyMaterialIndex : ProxyMaterialIndex;
-						Element.FaceIndex = FaceIndex;
-
-						// Append the batch's indices to the index buffer.
-						BrickSceneProxy->IndexBuffer.Indices.Append(FaceBatch.Indices);
-					}
-				}
+			UMaterialInterface* OverrideTopSurfaceMaterial = LocalGrid->Parameters.Materials[BrickMaterialIndex].OverrideTopSurfaceMaterial;
+			if(OverrideTopSurfaceMaterial)
+			{
+				BrickSceneProxy->MaterialRelevance |= OverrideTopSurfaceMaterial->GetRelevance_Concurrent(SceneFeatureLevel);
 			}
+			ProxyMaterialIndices.Add(ProxyMaterialIndex);
+			TopProxyMaterialIndices.Add(OverrideTopSurfaceMaterial ? BrickSceneProxy->Materials.AddUnique(OverrideTopSurfaceMaterial) : ProxyMaterialIndex);
+		}
 
-			BrickSceneProxy->LocalBrickMaterials.Empty();
+		// Create mesh elements for each of the mesher's elements.
+		for(const BrickMesher::FElement& MesherElement : MesherOutput.Elements)
+		{
+			FBrickChunkSceneProxy::FElement& Element = *new(BrickSceneProxy->Elements)FBrickChunkSceneProxy::FElement;
+			Element.FirstIndex = MesherElement.FirstIndex;
+			Element.NumPrimitives = MesherElement.NumPrimitives;
+			Element.MaterialIndex = MesherElement.FaceIndex == 5 ? TopProxyMaterialIndices[MesherElement.MaterialIndex] : ProxyMaterialIndices[MesherElement.MaterialIndex];
+			Element.FaceIndex = MesherElement.FaceIndex;
+		}
 
-			UE_LOG(LogStats,Log,TEXT("Brick render component setup took %fms to create %u indices and %u vertices"),1000.0f * float(FPlatformTime::Seconds() - SetupStartTime),BrickSceneProxy->IndexBuffer.Indices.Num(),BrickSceneProxy->VertexBuffer.Vertices.Num());
+		// Only use 32-bit indices if some vertex can't be addressed by a 16-bit index.
+		BrickSceneProxy->IndexBuffer.Use32BitIndices = BrickSceneProxy->VertexBuffer.GetNumVertices() > 65536;
 
-		},TStatId(),NULL);
+		UE_LOG(LogStats,Log,TEXT("Brick render component setup took %fms to create %u indices and %u vertices"),1000.0f * float(FPlatformTime::Seconds() - SetupStartTime),BrickSceneProxy->IndexBuffer.Indices.Num(),BrickSceneProxy->VertexBuffer.GetNumVertices());
 
-		BrickSceneProxy->BeginInitResources();
-	}
+	},TStatId(),NULL);
+	PendingMeshBuild = MeshBuild;
+	PendingMeshBuildEvent = BrickSceneProxy->SetupCompletionEvent;
+
+	BrickSceneProxy->BeginInitResources();
 
 	UE_LOG(LogStats,Log,TEXT("UBrickRenderComponent::CreateSceneProxy took %fms"),1000.0f * float(FPlatformTime::Seconds() - StartTime));
 
 	return BrickSceneProxy;
 }
 
+FInt3 UBrickRenderComponent::GetBricksDim() const
+{
+	return FInt3::Exp2(Grid->BricksPerRenderChunkLog2 + MergedChunksLog2);
+}
+
+FInt3 UBrickRenderComponent::GetMinBrickCoordinates() const
+{
+	return Coordinates << (Grid->BricksPerRenderChunkLog2 + MergedChunksLog2);
+}
+
+void UBrickRenderComponent::UpdateAmbientOcclusion()
+{
+	HasLowPriorityUpdatePending = false;
+
+	#if !WITH_GFSDK_VXGI
+		FBrickChunkSceneProxy* BrickSceneProxy = (FBrickChunkSceneProxy*)SceneProxy;
+		if(BrickSceneProxy && !BrickSceneProxy->VertexBuffer.KeepCPUVertices)
+		{
+			// The proxy discarded its vertices after uploading them, so it must be rebuilt to change their ambient occlusion.
+			MarkRenderStateDirty();
+		}
+		else if(BrickSceneProxy && IsAmbientOcclusionUpdateInFlight())
+		{
+			// The ambient occlusion being computed may not include the latest changes, so update it again once it finishes.
+			HasLowPriorityUpdatePending = true;
+		}
+		else if(BrickSceneProxy)
+		{
+			// Recompute the ambient occlusion for the vertices in this chunk on a worker thread, like the chunk's mesh build.
+			const TSharedPtr<FBrickAmbientOcclusionUpdate,ESPMode::ThreadSafe> Update = MakeShareable(new FBrickAmbientOcclusionUpdate);
+			Update->SceneProxy = BrickSceneProxy;
+			Update->LocalVertexDim = GetBricksDim() + FInt3::Scalar(1);
+			UBrickGridComponent* LocalGrid = Grid;
+			const FInt3 MinBrickCoordinates = GetMinBrickCoordinates();
+			const FInt3 BricksDim = GetBricksDim();
+			PendingAmbientOcclusionUpdate = Update;
+			Grid->WorkScheduler.BeginWorkerTask(EBrickGridWork::AmbientOcclusionUpdate);
+			PendingAmbientOcclusionUpdateEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([=]()
+			{
+				FBrickGridScopedWorkerTask ScopedWorkerTask(LocalGrid->WorkScheduler,EBrickGridWork::AmbientOcclusionUpdate);
+				ComputeVertexAmbientOcclusion(LocalGrid,MinBrickCoordinates,BricksDim,Update->LocalVertexAmbientFactors);
+			},
+			TStatId(),NULL);
+		}
+	#endif
+}
+
+void UBrickRenderComponent::FinishAmbientOcclusionUpdate()
+{
+	if(PendingAmbientOcclusionUpdateEvent.IsValid() && PendingAmbientOcclusionUpdateEvent->IsComplete())
+	{
+		const TSharedPtr<FBrickAmbientOcclusionUpdate,ESPMode::ThreadSafe> Update = PendingAmbientOcclusionUpdate;
+		PendingAmbientOcclusionUpdate.Reset();
+		PendingAmbientOcclusionUpdateEvent = NULL;
+
+		// Upload only the ambient occlusion vertex stream; the proxy's geometry is unchanged.
+		FBrickChunkSceneProxy* BrickSceneProxy = (FBrickChunkSceneProxy*)SceneProxy;
+		if(BrickSceneProxy && BrickSceneProxy == Update->SceneProxy)
+		{
+			ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+				UpdateBrickChunkAmbientOcclusion,
+				FBrickChunkSceneProxy*,BrickSceneProxy,BrickSceneProxy,
+				TArray<uint8>,LocalVertexAmbientFactors,MoveTemp(Update->LocalVertexAmbientFactors),
+				FInt3,LocalVertexDim,Update->LocalVertexDim,
+			{
+				BrickSceneProxy->UpdateAmbientOcclusion_RenderThread(LocalVertexAmbientFactors,LocalVertexDim);
+			});
+		}
+	}
+}
+
+void UBrickRenderComponent::FinishMeshBuild()
+{
+	if(PendingMeshBuildEvent.IsValid() && PendingMeshBuildEvent->IsComplete())
+	{
+		FaceConnectivity = PendingMeshBuild->FaceConnectivity;
+		IsMeshBuilt = true;
+		PendingMeshBuild.Reset();
+		PendingMeshBuildEvent = NULL;
+	}
+	for(int32 EventIndex = SupersededMeshBuildEvents.Num() - 1;EventIndex >= 0;--EventIndex)
+	{
+		if(SupersededMeshBuildEvents[EventIndex]->IsComplete())
+		{
+			SupersededMeshBuildEvents.RemoveAtSwap(EventIndex);
+		}
+	}
+}
+
+void UBrickRenderComponent::SetCaveCulled(bool InIsCaveCulled)
+{
+	if(IsCaveCulled != InIsCaveCulled)
+	{
+		IsCaveCulled = InIsCaveCulled;
+
+		// Update the existing proxy's flag instead of recreating it.
+		FBrickChunkSceneProxy* BrickSceneProxy = (FBrickChunkSceneProxy*)SceneProxy;
+		if(BrickSceneProxy)
+		{
+			ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+				SetBrickChunkCaveCulled,
+				FBrickChunkSceneProxy*,BrickSceneProxy,BrickSceneProxy,
+				bool,IsCaveCulled,IsCaveCulled,
+			{
+				BrickSceneProxy->IsCaveCulled = IsCaveCulled;
+			});
+		}
+	}
+}
+
 void UBrickRenderComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMaterials,bool bGetDebugMaterials) const
 {
 	for (int32 MaterialIndex = 0; MaterialIndex < Grid->Parameters.Materials.Num(); ++MaterialIndex)
@@ -580,7 +1021,33 @@ void UBrickRenderComponent::GetUsedMaterials(TArray<UMaterialInterface*>& OutMat
 FBoxSphereBounds UBrickRenderComponent::CalcBounds(const FTransform & LocalToWorld) const
 {
 	FBoxSphereBounds NewBounds;
-	NewBounds.Origin = NewBounds.BoxExtent = Grid->BricksPerRenderChunk.ToFloat() / 2.0f;
+	NewBounds.Origin = NewBounds.BoxExtent = GetBricksDim().ToFloat() / 2.0f;
 	NewBounds.SphereRadius = NewBounds.BoxExtent.Size();
 	return NewBounds.TransformBy(LocalToWorld);
 }
+
+void UBrickRenderComponent::BeginDestroy()
+{
+	Super::BeginDestroy();
+
+	// Don't let a worker thread read the grid after it's destroyed.
+	if(PendingAmbientOcclusionUpdateEvent.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(PendingAmbientOcclusionUpdateEvent);
+		PendingAmbientOcclusionUpdateEvent = NULL;
+	}
+	PendingAmbientOcclusionUpdate.Reset();
+
+	// The mesh build tasks also read the grid, and report to its work scheduler when they finish.
+	if(PendingMeshBuildEvent.IsValid())
+	{
+		SupersededMeshBuildEvents.Add(PendingMeshBuildEvent);
+		PendingMeshBuildEvent = NULL;
+	}
+	if(SupersededMeshBuildEvents.Num())
+	{
+		FTaskGraphInterface::Get().WaitUntilTasksComplete(SupersededMeshBuildEvents);
+		SupersededMeshBuildEvents.Empty();
+	}
+	PendingMeshBuild.Reset();
+}
@@ -0,0 +1,97 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#pragma once
+
+// The kinds of work the grid schedules, each with its own cost estimate.
+enum class EBrickGridWork : uint8
+{
+	// Game thread work.
+	RegionInit,
+	RenderChunkCreation,
+	CollisionChunkCreation,
+
+	// Worker thread work.
+	AmbientOcclusionUpdate,
+	RenderChunkMeshBuild,
+	SuperChunkMeshBuild,
+	CollisionBuild,
+
+	Count
+};
+
+/**
+ * Admits the grid's work each update up to a budget for the game thread and a budget for the worker threads, using moving averages of the measured
+ * cost of each kind of work to predict what it will cost before it's started.
+ */
+class BRICKGRID_API FBrickGridWorkScheduler
+{
+public:
+
+	FBrickGridWorkScheduler();
+
+	// Starts a new update with the given budgets in seconds. The worker budget is reduced by the estimated cost of the worker tasks still in flight.
+	void BeginUpdate(float GameThreadBudget,float WorkerBudget);
+
+	// Returns whether there's enough budget left in this update for a piece of work, and if so charges its estimated cost to the budget.
+	// The first piece of work of each kind in an update is always admitted, so an estimate larger than the budget can't starve it.
+	// If OutChargedSeconds is given, it receives the estimate charged for admitted work, to be passed back to ReportGameThreadCost.
+	bool Admit(EBrickGridWork Work,double* OutChargedSeconds = NULL);
+
+	// Admits work that has a game thread part and a worker thread part, such as creating a render chunk and then meshing it. Only admits it if both parts fit.
+	// If OutGameThreadChargedSeconds is given, it receives the estimate charged for the game thread part.
+	bool Admit(EBrickGridWork GameThreadWork,EBrickGridWork WorkerWork,double* OutGameThreadChargedSeconds = NULL);
+
+	// Records the measured cost of a piece of game thread work to adapt its estimate. The measured cost replaces ChargedSeconds, the estimate Admit charged
+	// to the update's budget for it. Work done without being admitted, such as collision chunks that are needed immediately, passes zero.
+	void ReportGameThreadCost(EBrickGridWork Work,double ChargedSeconds,double Seconds);
+
+	// Tracks a worker task from when it's dispatched until it finishes, whether or not it was admitted. Safe to call from any thread.
+	void BeginWorkerTask(EBrickGridWork Work);
+	void EndWorkerTask(EBrickGridWork Work,double Seconds);
+
+	// Returns the current cost estimate for a kind of work in seconds.
+	double GetEstimatedCost(EBrickGridWork Work) const;
+
+private:
+
+	// Guards the estimates and in-flight counts, which worker threads update.
+	mutable FCriticalSection CriticalSection;
+
+	double EstimatedCosts[(int32)EBrickGridWork::Count];
+	int32 NumWorkerTasksInFlight[(int32)EBrickGridWork::Count];
+	bool HasAdmittedWork[(int32)EBrickGridWork::Count];
+
+	// The remaining budgets for the current update.
+	double GameThreadBudgetRemaining;
+	double WorkerBudgetRemaining;
+
+	static bool IsWorkerWork(EBrickGridWork Work) { return Work >= EBrickGridWork::AmbientOcclusionUpdate; }
+
+	// Blends a measured cost into a kind of work's estimate. Must be called with the critical section locked.
+	void AddCostSample(EBrickGridWork Work,double Seconds);
+
+	// Whether a piece of work fits in the remaining budget. Must be called with the critical section locked.
+	bool Fits(EBrickGridWork Work) const;
+
+	// Charges a piece of work's estimated cost to the budget, and returns the amount charged. Must be called with the critical section locked.
+	double Charge(EBrickGridWork Work);
+};
+
+// Tracks a worker task for a scheduler while it's in scope, and reports the time it took when it goes out of scope.
+class FBrickGridScopedWorkerTask
+{
+public:
+	FBrickGridScopedWorkerTask(FBrickGridWorkScheduler& InScheduler,EBrickGridWork InWork)
+	: Scheduler(InScheduler)
+	, Work(InWork)
+	, StartTime(FPlatformTime::Seconds())
+	{}
+	~FBrickGridScopedWorkerTask()
+	{
+		Scheduler.EndWorkerTask(Work,FPlatformTime::Seconds() - StartTime);
+	}
+private:
+	FBrickGridWorkScheduler& Scheduler;
+	const EBrickGridWork Work;
+	const double StartTime;
+};
@@ -0,0 +1,687 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved.
+
+#pragma once
+
+// The brick mesher, collision box merger, and ambient occlusion filter.
+// They only depend on the C++ standard library, so they can be tested and benchmarked outside of the engine.
+// Brick arrays are indexed by (Y * SizeX + X) * SizeZ + Z, the same as the brick grid's arrays.
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class EBrickClass
+{
+	Empty = 0,
+	Translucent = 1,
+	Opaque = 2,
+	Count = 3
+};
+
+namespace BrickMesher
+{
+	/** A 3D integer size or coordinates. */
+	struct FSize3
+	{
+		int32_t X;
+		int32_t Y;
+		int32_t Z;
+
+		FSize3() : X(0), Y(0), Z(0) {}
+		FSize3(int32_t InX,int32_t InY,int32_t InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		static FSize3 Scalar(int32_t I) { return FSize3(I,I,I); }
+
+		int32_t Volume() const { return X * Y * Z; }
+		int32_t Index(int32_t InX,int32_t InY,int32_t InZ) const { return (InY * X + InX) * Z + InZ; }
+
+		friend FSize3 operator+(const FSize3& A,const FSize3& B) { return FSize3(A.X + B.X,A.Y + B.Y,A.Z + B.Z); }
+		friend FSize3 operator-(const FSize3& A,const FSize3& B) { return FSize3(A.X - B.X,A.Y - B.Y,A.Z - B.Z); }
+		friend bool operator==(const FSize3& A,const FSize3& B) { return A.X == B.X && A.Y == B.Y && A.Z == B.Z; }
+	};
+
+	// Maps face index to normal.
+	static const int32_t FaceNormalOffsets[6][3] =
+	{
+		{ -1, 0, 0 },
+		{ +1, 0, 0 },
+		{ 0, -1, 0 },
+		{ 0, +1, 0 },
+		{ 0, 0, -1 },
+		{ 0, 0, +1 }
+	};
+
+	// Maps face index and face vertex index to brick corner indices.
+	static const uint8_t FaceVertices[6][4] =
+	{
+		{ 2, 3, 1, 0 },		// -X
+		{ 4, 5, 7, 6 },		// +X
+		{ 0, 1, 5, 4 },		// -Y
+		{ 6, 7, 3, 2 },		// +Y
+		{ 4, 6, 2, 0 },		// -Z
+		{ 1, 3, 7, 5 }		// +Z
+	};
+
+	// Returns the bit in a face connectivity mask that indicates a path between two different faces of a chunk.
+	inline uint32_t GetFacePairBit(uint32_t FaceA,uint32_t FaceB)
+	{
+		assert(FaceA != FaceB);
+		const uint32_t MinFace = FaceA < FaceB ? FaceA : FaceB;
+		const uint32_t MaxFace = FaceA < FaceB ? FaceB : FaceA;
+		return 1u << (MinFace * (11 - MinFace) / 2 + MaxFace - MinFace - 1);
+	}
+
+	// A face connectivity mask with all 15 pairs of faces connected.
+	static const uint32_t AllFacesConnected = 0x7fff;
+
+	// Maps brick corner indices to 3D coordinates.
+	inline FSize3 GetCornerVertexOffset(uint8_t BrickVertexIndex)
+	{
+		return FSize3((BrickVertexIndex >> 2) & 1,(BrickVertexIndex >> 1) & 1,BrickVertexIndex & 1);
+	}
+
+	/** A vertex of a meshed chunk, in full resolution brick units relative to the chunk's minimum corner. */
+	struct FVertex
+	{
+		uint16_t X;
+		uint16_t Y;
+		uint16_t Z;
+	};
+
+	/** A range of the output indices with a single brick material and face direction. */
+	struct FElement
+	{
+		uint32_t FirstIndex;
+		uint32_t NumPrimitives;
+		uint32_t MaterialIndex;
+		uint32_t FaceIndex;
+	};
+
+	/** The inputs for meshing a chunk. */
+	struct FChunkInput
+	{
+		// The materials of the chunk's bricks plus a border of one brick on each side, so BricksDim + 2 bricks along each axis.
+		const uint8_t* LocalBrickMaterials;
+
+		// The number of bricks along each axis of the chunk, not including the border.
+		FSize3 BricksDim;
+
+		// The class of each brick material.
+		const EBrickClass* BrickClassByMaterial;
+		uint32_t NumMaterials;
+		uint32_t EmptyMaterialIndex;
+
+		// The number of full resolution bricks covered by each input brick along each axis. The output vertices are scaled by it.
+		int32_t VertexScale;
+
+		FChunkInput()
+		: LocalBrickMaterials(nullptr)
+		, BrickClassByMaterial(nullptr)
+		, NumMaterials(0)
+		, EmptyMaterialIndex(0)
+		, VertexScale(1)
+		{}
+	};
+
+	/** The mesh for a chunk. */
+	struct FChunkOutput
+	{
+		std::vector<FVertex> Vertices;
+		std::vector<uint32_t> Indices;
+
+		// The elements are sorted by material, then by face, and cover all of the indices.
+		std::vector<FElement> Elements;
+
+		uint32_t GetNumFaces() const { return (uint32_t)Indices.size() / 6; }
+	};
+
+	// Returns whether any of the chunk's bricks, not including the border, are non-empty.
+	inline bool HasNonEmptyBricks(const FChunkInput& Input)
+	{
+		const FSize3 LocalBricksDim = Input.BricksDim + FSize3::Scalar(2);
+		for(int32_t LocalBrickY = 1;LocalBrickY <= Input.BricksDim.Y;++LocalBrickY)
+		{
+			for(int32_t LocalBrickX = 1;LocalBrickX <= Input.BricksDim.X;++LocalBrickX)
+			{
+				for(int32_t LocalBrickZ = 1;LocalBrickZ <= Input.BricksDim.Z;++LocalBrickZ)
+				{
+					if(Input.LocalBrickMaterials[LocalBricksDim.Index(LocalBrickX,LocalBrickY,LocalBrickZ)] != Input.EmptyMaterialIndex)
+					{
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	/** Creates the faces between bricks of different classes. Keeps its intermediate buffers between chunks to avoid reallocating them. */
+	class FChunkMesher
+	{
+	public:
+
+		void Mesh(const FChunkInput& Input,FChunkOutput& Output)
+		{
+			const FSize3 LocalBricksDim = Input.BricksDim + FSize3::Scalar(2);
+			const FSize3 LocalVertexDim = Input.BricksDim + FSize3::Scalar(1);
+			const uint8_t* LocalBrickMaterials = Input.LocalBrickMaterials;
+			const EBrickClass* BrickClassByMaterial = Input.BrickClassByMaterial;
+			Output.Vertices.clear();
+			Output.Indices.clear();
+			Output.Elements.clear();
+
+			// Create an array of the vertices needed to render this chunk, along with a map from 3D coordinates to indices.
+			VertexIndexMap.resize(LocalVertexDim.Volume());
+			for(int32_t LocalVertexY = 0;LocalVertexY < LocalVertexDim.Y;++LocalVertexY)
+			{
+				for(int32_t LocalVertexX = 0;LocalVertexX < LocalVertexDim.X;++LocalVertexX)
+				{
+					for(int32_t LocalVertexZ = 0;LocalVertexZ < LocalVertexDim.Z;++LocalVertexZ)
+					{
+						uint32_t HasAdjacentBrickOfClass[(int32_t)EBrickClass::Count] = { 0 };
+						for(uint8_t AdjacentBrickIndex = 0;AdjacentBrickIndex < 8;++AdjacentBrickIndex)
+						{
+							// The vertex at local coordinates V is the min corner of the local brick V + 1, so its adjacent bricks are V + offset.
+							const FSize3 CornerVertexOffset = GetCornerVertexOffset(AdjacentBrickIndex);
+							const uint8_t AdjacentBrickMaterial = LocalBrickMaterials[LocalBricksDim.Index(LocalVertexX + CornerVertexOffset.X,LocalVertexY + CornerVertexOffset.Y,LocalVertexZ + CornerVertexOffset.Z)];
+							HasAdjacentBrickOfClass[(uint32_t)BrickClassByMaterial[AdjacentBrickMaterial]] = 1;
+						}
+
+						const uint32_t LocalVertexIndex = LocalVertexDim.Index(LocalVertexX,LocalVertexY,LocalVertexZ);
+						if(	HasAdjacentBrickOfClass[(int32_t)EBrickClass::Opaque]
+						+	HasAdjacentBrickOfClass[(int32_t)EBrickClass::Translucent]
+						+	HasAdjacentBrickOfClass[(int32_t)EBrickClass::Empty] > 1)
+						{
+							VertexIndexMap[LocalVertexIndex] = (uint32_t)Output.Vertices.size();
+							const FVertex Vertex =
+							{
+								(uint16_t)(LocalVertexX * Input.VertexScale),
+								(uint16_t)(LocalVertexY * Input.VertexScale),
+								(uint16_t)(LocalVertexZ * Input.VertexScale)
+							};
+							Output.Vertices.push_back(Vertex);
+						}
+						else
+						{
+							VertexIndexMap[LocalVertexIndex] = 0;
+						}
+					}
+				}
+			}
+
+			// Reset the index batches for each material and face.
+			FaceBatchIndices.resize(Input.NumMaterials * 6);
+			for(std::vector<uint32_t>& Indices : FaceBatchIndices)
+			{
+				Indices.clear();
+			}
+
+			// Iterate over each brick in the chunk.
+			for(int32_t LocalBrickY = 1;LocalBrickY <= Input.BricksDim.Y;++LocalBrickY)
+			{
+				for(int32_t LocalBrickX = 1;LocalBrickX <= Input.BricksDim.X;++LocalBrickX)
+				{
+					for(int32_t LocalBrickZ = 1;LocalBrickZ <= Input.BricksDim.Z;++LocalBrickZ)
+					{
+						// Only draw faces of bricks that aren't empty.
+						const uint8_t BrickMaterial = LocalBrickMaterials[LocalBricksDim.Index(LocalBrickX,LocalBrickY,LocalBrickZ)];
+						if(BrickMaterial != Input.EmptyMaterialIndex)
+						{
+							for(uint32_t FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+							{
+								// Only draw faces that face bricks of a lower class.
+								const uint8_t FrontBrickMaterial = LocalBrickMaterials[LocalBricksDim.Index(
+									LocalBrickX + FaceNormalOffsets[FaceIndex][0],
+									LocalBrickY + FaceNormalOffsets[FaceIndex][1],
+									LocalBrickZ + FaceNormalOffsets[FaceIndex][2]
+									)];
+								if(BrickClassByMaterial[BrickMaterial] > BrickClassByMaterial[FrontBrickMaterial])
+								{
+									uint32_t FaceVertexIndices[4];
+									for(uint32_t FaceVertexIndex = 0;FaceVertexIndex < 4;++FaceVertexIndex)
+									{
+										const FSize3 CornerVertexOffset = GetCornerVertexOffset(FaceVertices[FaceIndex][FaceVertexIndex]);
+										FaceVertexIndices[FaceVertexIndex] = VertexIndexMap[LocalVertexDim.Index(
+											LocalBrickX - 1 + CornerVertexOffset.X,
+											LocalBrickY - 1 + CornerVertexOffset.Y,
+											LocalBrickZ - 1 + CornerVertexOffset.Z
+											)];
+									}
+
+									// Write the indices for the brick face.
+									std::vector<uint32_t>& Indices = FaceBatchIndices[BrickMaterial * 6 + FaceIndex];
+									Indices.push_back(FaceVertexIndices[0]);
+									Indices.push_back(FaceVertexIndices[1]);
+									Indices.push_back(FaceVertexIndices[2]);
+									Indices.push_back(FaceVertexIndices[0]);
+									Indices.push_back(FaceVertexIndices[2]);
+									Indices.push_back(FaceVertexIndices[3]);
+								}
+							}
+						}
+					}
+				}
+			}
+
+			// Concatenate the batches into a single index array, with an element for each non-empty batch.
+			std::size_t NumIndices = 0;
+			for(const std::vector<uint32_t>& Indices : FaceBatchIndices)
+			{
+				NumIndices += Indices.size();
+			}
+			Output.Indices.reserve(NumIndices);
+			for(uint32_t MaterialIndex = 0;MaterialIndex < Input.NumMaterials;++MaterialIndex)
+			{
+				for(uint32_t FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+				{
+					const std::vector<uint32_t>& Indices = FaceBatchIndices[MaterialIndex * 6 + FaceIndex];
+					if(Indices.size() > 0)
+					{
+						FElement Element;
+						Element.FirstIndex = (uint32_t)Output.Indices.size();
+						Element.NumPrimitives = (uint32_t)Indices.size() / 3;
+						Element.MaterialIndex = MaterialIndex;
+						Element.FaceIndex = FaceIndex;
+						Output.Elements.push_back(Element);
+						Output.Indices.insert(Output.Indices.end(),Indices.begin(),Indices.end());
+					}
+				}
+			}
+		}
+
+		// Computes which pairs of the chunk's faces are connected by a path through its non-opaque bricks, as a mask of GetFacePairBit bits.
+		uint32_t ComputeFaceConnectivity(const FChunkInput& Input)
+		{
+			const FSize3 LocalBricksDim = Input.BricksDim + FSize3::Scalar(2);
+			Visited.assign(Input.BricksDim.Volume(),0);
+			uint32_t Result = 0;
+			for(int32_t SeedBrickIndex = 0;SeedBrickIndex < Input.BricksDim.Volume();++SeedBrickIndex)
+			{
+				if(Visited[SeedBrickIndex] || IsOpaque(Input,LocalBricksDim,SeedBrickIndex))
+				{
+					continue;
+				}
+
+				// Flood fill the non-opaque bricks connected to the seed brick, accumulating the chunk faces they touch.
+				uint32_t TouchedFaceMask = 0;
+				Visited[SeedBrickIndex] = 1;
+				FloodStack.clear();
+				FloodStack.push_back(SeedBrickIndex);
+				while(FloodStack.size())
+				{
+					const int32_t BrickIndex = FloodStack.back();
+					FloodStack.pop_back();
+					const int32_t BrickZ = BrickIndex % Input.BricksDim.Z;
+					const int32_t BrickX = (BrickIndex / Input.BricksDim.Z) % Input.BricksDim.X;
+					const int32_t BrickY = BrickIndex / (Input.BricksDim.Z * Input.BricksDim.X);
+					const int32_t BrickCoordinates[3] = { BrickX, BrickY, BrickZ };
+					const int32_t BricksDim[3] = { Input.BricksDim.X, Input.BricksDim.Y, Input.BricksDim.Z };
+					for(uint32_t FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+					{
+						const uint32_t Axis = FaceIndex / 2;
+						const int32_t NeighborAxisCoordinate = BrickCoordinates[Axis] + FaceNormalOffsets[FaceIndex][Axis];
+						if(NeighborAxisCoordinate < 0 || NeighborAxisCoordinate >= BricksDim[Axis])
+						{
+							TouchedFaceMask |= 1 << FaceIndex;
+							continue;
+						}
+						const int32_t NeighborBrickIndex = Input.BricksDim.Index(
+							BrickX + FaceNormalOffsets[FaceIndex][0],
+							BrickY + FaceNormalOffsets[FaceIndex][1],
+							BrickZ + FaceNormalOffsets[FaceIndex][2]
+							);
+						if(!Visited[NeighborBrickIndex] && !IsOpaque(Input,LocalBricksDim,NeighborBrickIndex))
+						{
+							Visited[NeighborBrickIndex] = 1;
+							FloodStack.push_back(NeighborBrickIndex);
+						}
+					}
+				}
+
+				// Connect every pair of faces touched by the filled bricks.
+				for(uint32_t FaceA = 0;FaceA < 6;++FaceA)
+				{
+					for(uint32_t FaceB = FaceA + 1;FaceB < 6;++FaceB)
+					{
+						if((TouchedFaceMask >> FaceA) & (TouchedFaceMask >> FaceB) & 1)
+						{
+							Result |= GetFacePairBit(FaceA,FaceB);
+						}
+					}
+				}
+				if(Result == AllFacesConnected)
+				{
+					break;
+				}
+			}
+			return Result;
+		}
+
+	private:
+
+		std::vector<uint32_t> VertexIndexMap;
+		std::vector<std::vector<uint32_t>> FaceBatchIndices;
+		std::vector<uint8_t> Visited;
+		std::vector<int32_t> FloodStack;
+
+		static bool IsOpaque(const FChunkInput& Input,const FSize3 LocalBricksDim,int32_t BrickIndex)
+		{
+			const int32_t BrickZ = BrickIndex % Input.BricksDim.Z;
+			const int32_t BrickX = (BrickIndex / Input.BricksDim.Z) % Input.BricksDim.X;
+			const int32_t BrickY = BrickIndex / (Input.BricksDim.Z * Input.BricksDim.X);
+			const uint8_t BrickMaterial = Input.LocalBrickMaterials[LocalBricksDim.Index(BrickX + 1,BrickY + 1,BrickZ + 1)];
+			return Input.BrickClassByMaterial[BrickMaterial] == EBrickClass::Opaque;
+		}
+	};
+
+	// Returns the blurred sky visibility of a brick whose blur window only contains columns that are visible from it.
+	inline uint8_t GetFullBlurredSkyVisibility(const uint32_t BlurRadius)
+	{
+		const uint32_t BlurDiameter = BlurRadius * 2;
+		const uint32_t FixedBlurDenominator = (255u << 24) / ((BlurDiameter + 1) * (BlurDiameter + 1));
+		return (uint8_t)(((BlurDiameter + 1) * (BlurDiameter + 1) * FixedBlurDenominator) >> 24);
+	}
+
+	// Computes the fraction of the columns within BlurRadius of each brick along X and Y whose highest non-empty brick is below it.
+	// MaxNonEmptyBrickLocalZs contains LocalBricksDim.X * LocalBricksDim.Y heights relative to the bottom of the local bricks, with -1 meaning an empty column.
+	// The output covers the local bricks that are at least BlurRadius bricks from their X and Y sides: LocalBricksDim - (2 * BlurRadius,2 * BlurRadius,0).
+	inline void ComputeBlurredSkyVisibility(
+		const int16_t* MaxNonEmptyBrickLocalZs,
+		const FSize3 LocalBricksDim,
+		const uint32_t BlurRadius,
+		uint8_t* OutBlurredSkyVisibility
+		)
+	{
+		const uint32_t BlurDiameter = BlurRadius * 2;
+		const uint32_t FixedBlurDenominator = (255u << 24) / ((BlurDiameter + 1) * (BlurDiameter + 1));
+		const FSize3 LocalBrickAmbientFactorsDim = LocalBricksDim - FSize3(BlurDiameter,BlurDiameter,0);
+
+		// The blur is a box filter, so each half of it is computed from running sums, making its cost independent of the blur radius.
+		// The inner loops run along X over contiguous rows, so the compiler can vectorize them.
+		const int32_t BricksInHalfFilteredBufferX = LocalBricksDim.X - BlurDiameter;
+		std::vector<uint8_t> Visibility(LocalBricksDim.X);
+		std::vector<uint32_t> VisibilityPrefixSum(LocalBricksDim.X + 1);
+		std::vector<uint8_t> HalfFilteredVisibility(BricksInHalfFilteredBufferX * LocalBricksDim.Y);
+		std::vector<uint32_t> FilteredVisibilityRow(BricksInHalfFilteredBufferX);
+
+		for(int32_t AmbientBrickZ = 0;AmbientBrickZ < LocalBrickAmbientFactorsDim.Z;++AmbientBrickZ)
+		{
+			// Apply the X half of the separable blur to this Z slice: the sum of a window of a row is the difference of two of its prefix sums.
+			for(int32_t LocalBrickY = 0;LocalBrickY < LocalBricksDim.Y;++LocalBrickY)
+			{
+				const int16_t* MaxNonEmptyBrickRowZs = &MaxNonEmptyBrickLocalZs[LocalBrickY * LocalBricksDim.X];
+				for(int32_t LocalBrickX = 0;LocalBrickX < LocalBricksDim.X;++LocalBrickX)
+				{
+					Visibility[LocalBrickX] = (uint8_t)(MaxNonEmptyBrickRowZs[LocalBrickX] < AmbientBrickZ);
+				}
+				VisibilityPrefixSum[0] = 0;
+				for(int32_t LocalBrickX = 0;LocalBrickX < LocalBricksDim.X;++LocalBrickX)
+				{
+					VisibilityPrefixSum[LocalBrickX + 1] = VisibilityPrefixSum[LocalBrickX] + Visibility[LocalBrickX];
+				}
+				uint8_t* HalfFilteredRow = &HalfFilteredVisibility[LocalBrickY * BricksInHalfFilteredBufferX];
+				for(int32_t HalfFilteredX = 0;HalfFilteredX < BricksInHalfFilteredBufferX;++HalfFilteredX)
+				{
+					HalfFilteredRow[HalfFilteredX] = (uint8_t)(VisibilityPrefixSum[HalfFilteredX + BlurDiameter + 1] - VisibilityPrefixSum[HalfFilteredX]);
+				}
+			}
+
+			// Apply the Y half of the separable blur to this Z slice, sliding a window of summed rows along Y.
+			for(int32_t AmbientBrickX = 0;AmbientBrickX < LocalBrickAmbientFactorsDim.X;++AmbientBrickX)
+			{
+				FilteredVisibilityRow[AmbientBrickX] = 0;
+			}
+			for(uint32_t FilterY = 0;FilterY < BlurDiameter + 1;++FilterY)
+			{
+				const uint8_t* HalfFilteredRow = &HalfFilteredVisibility[FilterY * BricksInHalfFilteredBufferX];
+				for(int32_t AmbientBrickX = 0;AmbientBrickX < LocalBrickAmbientFactorsDim.X;++AmbientBrickX)
+				{
+					FilteredVisibilityRow[AmbientBrickX] += HalfFilteredRow[AmbientBrickX];
+				}
+			}
+			for(int32_t AmbientBrickY = 0;AmbientBrickY < LocalBrickAmbientFactorsDim.Y;++AmbientBrickY)
+			{
+				for(int32_t AmbientBrickX = 0;AmbientBrickX < LocalBrickAmbientFactorsDim.X;++AmbientBrickX)
+				{
+					OutBlurredSkyVisibility[LocalBrickAmbientFactorsDim.Index(AmbientBrickX,AmbientBrickY,AmbientBrickZ)] = (uint8_t)((FilteredVisibilityRow[AmbientBrickX] * FixedBlurDenominator) >> 24);
+				}
+				if(AmbientBrickY + 1 < LocalBrickAmbientFactorsDim.Y)
+				{
+					const uint8_t* LeavingRow = &HalfFilteredVisibility[AmbientBrickY * BricksInHalfFilteredBufferX];
+					const uint8_t* EnteringRow = &HalfFilteredVisibility[(AmbientBrickY + BlurDiameter + 1) * BricksInHalfFilteredBufferX];
+					for(int32_t AmbientBrickX = 0;AmbientBrickX < LocalBrickAmbientFactorsDim.X;++AmbientBrickX)
+					{
+						FilteredVisibilityRow[AmbientBrickX] += EnteringRow[AmbientBrickX] - LeavingRow[AmbientBrickX];
+					}
+				}
+			}
+		}
+	}
+
+	// Computes an ambient occlusion factor for each vertex in a box from the blurred sky visibility of the 8 bricks adjacent to it.
+	// BlurredSkyVisibility covers the bricks adjacent to the vertices: LocalVertexDim + (1,1,1).
+	inline void ComputeVertexAmbientOcclusion(
+		const uint8_t* BlurredSkyVisibility,
+		const FSize3 LocalVertexDim,
+		uint8_t* OutLocalVertexAmbientFactors
+		)
+	{
+		const FSize3 LocalBrickAmbientFactorsDim = LocalVertexDim + FSize3::Scalar(1);
+		for(int32_t LocalVertexY = 0;LocalVertexY < LocalVertexDim.Y;++LocalVertexY)
+		{
+			for(int32_t LocalVertexX = 0;LocalVertexX < LocalVertexDim.X;++LocalVertexX)
+			{
+				for(int32_t LocalVertexZ = 0;LocalVertexZ < LocalVertexDim.Z;++LocalVertexZ)
+				{
+					uint32_t AdjacentAmbientFactorSum = 0;
+					for(uint8_t AdjacentIndex = 0;AdjacentIndex < 8;++AdjacentIndex)
+					{
+						const uint32_t AmbientBrickX = LocalVertexX + ((AdjacentIndex >> 0) & 1);
+						const uint32_t AmbientBrickY = LocalVertexY + ((AdjacentIndex >> 1) & 1);
+						const uint32_t AmbientBrickZ = LocalVertexZ + (AdjacentIndex >> 2);
+						AdjacentAmbientFactorSum += BlurredSkyVisibility[LocalBrickAmbientFactorsDim.Index(AmbientBrickX,AmbientBrickY,AmbientBrickZ)];
+					}
+
+					// Average the ambient factor from all 8 bricks adjacent to the vertex.
+					// Normalize it with an implicit factor of 2 since we'll treat the result as a hemisphere percent.
+					const uint32_t AverageAdjacentAmbientFactor = AdjacentAmbientFactorSum / 4;
+					OutLocalVertexAmbientFactors[LocalVertexDim.Index(LocalVertexX,LocalVertexY,LocalVertexZ)] = (uint8_t)(AverageAdjacentAmbientFactor < 255 ? AverageAdjacentAmbientFactor : 255);
+				}
+			}
+		}
+	}
+
+	// Computes a light factor for each vertex in a box from the propagated light of the bricks adjacent to it.
+	// BrickLight and BrickMaterials cover the vertices' adjacent bricks, starting one brick below the first vertex, so they are LocalVertexDim + 1 bricks in size.
+	// Each brick's light has the sky light level in the low 4 bits and the block light level in the high 4 bits. Opaque bricks don't hold light, so they are left out of each vertex's average.
+	inline void ComputeVertexLight(
+		const uint8_t* BrickLight,
+		const uint8_t* BrickMaterials,
+		const EBrickClass* BrickClassByMaterial,
+		const FSize3 LocalVertexDim,
+		uint8_t* OutLocalVertexLightFactors
+		)
+	{
+		const FSize3 LocalBricksDim = LocalVertexDim + FSize3::Scalar(1);
+		for(int32_t LocalVertexY = 0;LocalVertexY < LocalVertexDim.Y;++LocalVertexY)
+		{
+			for(int32_t LocalVertexX = 0;LocalVertexX < LocalVertexDim.X;++LocalVertexX)
+			{
+				for(int32_t LocalVertexZ = 0;LocalVertexZ < LocalVertexDim.Z;++LocalVertexZ)
+				{
+					uint32_t AdjacentLightSum = 0;
+					uint32_t NumAdjacentLitBricks = 0;
+					for(uint8_t AdjacentIndex = 0;AdjacentIndex < 8;++AdjacentIndex)
+					{
+						const uint32_t AdjacentBrickIndex = LocalBricksDim.Index(
+							LocalVertexX + ((AdjacentIndex >> 0) & 1),
+							LocalVertexY + ((AdjacentIndex >> 1) & 1),
+							LocalVertexZ + (AdjacentIndex >> 2)
+							);
+						if(BrickClassByMaterial[BrickMaterials[AdjacentBrickIndex]] != EBrickClass::Opaque)
+						{
+							const uint32_t SkyLevel = BrickLight[AdjacentBrickIndex] & 15;
+							const uint32_t BlockLevel = BrickLight[AdjacentBrickIndex] >> 4;
+							AdjacentLightSum += (SkyLevel > BlockLevel ? SkyLevel : BlockLevel) * 17;
+							++NumAdjacentLitBricks;
+						}
+					}
+					OutLocalVertexLightFactors[LocalVertexDim.Index(LocalVertexX,LocalVertexY,LocalVertexZ)] = (uint8_t)(NumAdjacentLitBricks ? AdjacentLightSum / NumAdjacentLitBricks : 0);
+				}
+			}
+		}
+	}
+
+	// Computes an ambient occlusion factor for each vertex in a box from the highest non-empty brick in each column of bricks around it.
+	// MaxNonEmptyBrickLocalZs contains LocalBricksDim.X * LocalBricksDim.Y heights relative to the bottom of the local bricks, with -1 meaning an empty column.
+	// The local bricks must extend BlurRadius + 1 bricks beyond the vertices along X and Y, and 1 brick along Z.
+	inline void ComputeAmbientOcclusion(
+		const int16_t* MaxNonEmptyBrickLocalZs,
+		const FSize3 LocalBricksDim,
+		const uint32_t BlurRadius,
+		const FSize3 LocalVertexDim,
+		uint8_t* OutLocalVertexAmbientFactors
+		)
+	{
+		const uint32_t BlurDiameter = BlurRadius * 2;
+		assert(LocalVertexDim == LocalBricksDim - FSize3(BlurDiameter + 1,BlurDiameter + 1,1));
+
+		// Blur the sky visibility of each brick adjacent to the output vertices, then average it at the vertices.
+		std::vector<uint8_t> BlurredSkyVisibility((LocalVertexDim + FSize3::Scalar(1)).Volume());
+		ComputeBlurredSkyVisibility(MaxNonEmptyBrickLocalZs,LocalBricksDim,BlurRadius,BlurredSkyVisibility.data());
+		ComputeVertexAmbientOcclusion(BlurredSkyVisibility.data(),LocalVertexDim,OutLocalVertexAmbientFactors);
+	}
+
+	/** An axis-aligned box of bricks, from Min (inclusive) to Max (exclusive) in brick coordinates relative to the chunk's minimum corner. */
+	struct FBrickBox
+	{
+		FSize3 Min;
+		FSize3 Max;
+	};
+
+	/** Covers the non-empty bricks of a chunk that face an empty brick with a small number of boxes, for use as collision. */
+	class FCollisionBoxMerger
+	{
+	public:
+
+		// LocalBrickMaterials contains the chunk's bricks plus a border of one brick on each side, as for FChunkInput.
+		// Returns the number of surface bricks the boxes cover.
+		uint32_t Merge(const uint8_t* LocalBrickMaterials,const FSize3 BricksDim,uint32_t EmptyMaterialIndex,std::vector<FBrickBox>& OutBoxes)
+		{
+			const FSize3 LocalBricksDim = BricksDim + FSize3::Scalar(2);
+			OutBoxes.clear();
+
+			// Classify the chunk's bricks as empty, buried, or surface bricks that need to be covered.
+			uint32_t NumSurfaceBricks = 0;
+			BrickStates.resize(BricksDim.Volume());
+			for(int32_t BrickY = 0;BrickY < BricksDim.Y;++BrickY)
+			{
+				for(int32_t BrickX = 0;BrickX < BricksDim.X;++BrickX)
+				{
+					for(int32_t BrickZ = 0;BrickZ < BricksDim.Z;++BrickZ)
+					{
+						uint8_t State = Empty;
+						if(LocalBrickMaterials[LocalBricksDim.Index(BrickX + 1,BrickY + 1,BrickZ + 1)] != EmptyMaterialIndex)
+						{
+							State = Buried;
+							for(uint32_t FaceIndex = 0;FaceIndex < 6;++FaceIndex)
+							{
+								const int32_t FacingBrickIndex = LocalBricksDim.Index(
+									BrickX + 1 + FaceNormalOffsets[FaceIndex][0],
+									BrickY + 1 + FaceNormalOffsets[FaceIndex][1],
+									BrickZ + 1 + FaceNormalOffsets[FaceIndex][2]
+									);
+								if(LocalBrickMaterials[FacingBrickIndex] == EmptyMaterialIndex)
+								{
+									State = Surface;
+									++NumSurfaceBricks;
+									break;
+								}
+							}
+						}
+						BrickStates[BricksDim.Index(BrickX,BrickY,BrickZ)] = State;
+					}
+				}
+			}
+
+			// Start a box at each surface brick that isn't covered yet, and grow it greedily along Z, then X, then Y for as long as it only covers non-empty bricks.
+			// Growing through buried and already covered bricks lets a box span them instead of splitting, which usually produces fewer boxes at the cost of some overlap.
+			for(int32_t BrickY = 0;BrickY < BricksDim.Y;++BrickY)
+			{
+				for(int32_t BrickX = 0;BrickX < BricksDim.X;++BrickX)
+				{
+					for(int32_t BrickZ = 0;BrickZ < BricksDim.Z;++BrickZ)
+					{
+						if(BrickStates[BricksDim.Index(BrickX,BrickY,BrickZ)] != Surface)
+						{
+							continue;
+						}
+
+						FBrickBox Box;
+						Box.Min = FSize3(BrickX,BrickY,BrickZ);
+						Box.Max = FSize3(BrickX + 1,BrickY + 1,BrickZ + 1);
+						while(Box.Max.Z < BricksDim.Z && IsSolid(BricksDim,FSize3(Box.Min.X,Box.Min.Y,Box.Max.Z),FSize3(Box.Max.X,Box.Max.Y,Box.Max.Z + 1)))
+						{
+							++Box.Max.Z;
+						}
+						while(Box.Max.X < BricksDim.X && IsSolid(BricksDim,FSize3(Box.Max.X,Box.Min.Y,Box.Min.Z),FSize3(Box.Max.X + 1,Box.Max.Y,Box.Max.Z)))
+						{
+							++Box.Max.X;
+						}
+						while(Box.Max.Y < BricksDim.Y && IsSolid(BricksDim,FSize3(Box.Min.X,Box.Max.Y,Box.Min.Z),FSize3(Box.Max.X,Box.Max.Y + 1,Box.Max.Z)))
+						{
+							++Box.Max.Y;
+						}
+
+						// Mark the surface bricks in the box as covered, so they don't start or limit other boxes.
+						for(int32_t BoxY = Box.Min.Y;BoxY < Box.Max.Y;++BoxY)
+						{
+							for(int32_t BoxX = Box.Min.X;BoxX < Box.Max.X;++BoxX)
+							{
+								for(int32_t BoxZ = Box.Min.Z;BoxZ < Box.Max.Z;++BoxZ)
+								{
+									uint8_t& State = BrickStates[BricksDim.Index(BoxX,BoxY,BoxZ)];
+									State = State == Surface ? (uint8_t)Covered : State;
+								}
+							}
+						}
+						OutBoxes.push_back(Box);
+					}
+				}
+			}
+			return NumSurfaceBricks;
+		}
+
+	private:
+
+		enum EBrickState : uint8_t
+		{
+			Empty,
+			Buried,
+			Surface,
+			Covered
+		};
+
+		std::vector<uint8_t> BrickStates;
+
+		// Returns whether all the bricks in a box are non-empty.
+		bool IsSolid(const FSize3 BricksDim,const FSize3 Min,const FSize3 Max) const
+		{
+			for(int32_t BrickY = Min.Y;BrickY < Max.Y;++BrickY)
+			{
+				for(int32_t BrickX = Min.X;BrickX < Max.X;++BrickX)
+				{
+					for(int32_t BrickZ = Min.Z;BrickZ < Max.Z;++BrickZ)
+					{
+						if(BrickStates[BricksDim.Index(BrickX,BrickY,BrickZ)] == Empty)
+						{
+							return false;
+						}
+					}
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -52,6 +52,11 @@ struct FBrickTerrainGenerationParameters
 	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category="Terrain Generation")
 	float Scale;
 
+	// The number of bricks between samples of the terrain's noise along X and Y. The noise is interpolated between the samples.
+	// 1 samples the noise for every column of bricks; larger spacings generate terrain faster, but smooth out details smaller than the spacing.
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category="Terrain Generation",meta=(ClampMin=1))
+	int32 SampleSpacingXY;
+
 	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category="Terrain Generation")
 	FNoiseFunction UnerodedHeightFunction;
 
@@ -117,6 +122,7 @@ struct FBrickTerrainGenerationParameters
 
 	FBrickTerrainGenerationParameters()
 	: Scale(1.0f)
+	, SampleSpacingXY(1)
 	{}
 };
 
@@ -129,4 +135,9 @@ public:
 
 	UFUNCTION(BlueprintCallable,Category="Terrain Generation")
 	static BRICKTERRAINGENERATION_API void InitRegion(const FBrickTerrainGenerationParameters& Parameters,class UBrickGridComponent* Grid,const struct FInt3& RegionCoordinates);
+
+	// Generates several regions at once on the task graph's worker threads, which keeps more threads busy than generating them one at a time.
+	// The grid's streaming still creates regions one at a time through its InitRegion delegate, so this is only used by the benchmark commandlet for now.
+	UFUNCTION(BlueprintCallable,Category="Terrain Generation")
+	static BRICKTERRAINGENERATION_API void InitRegions(const FBrickTerrainGenerationParameters& Parameters,class UBrickGridComponent* Grid,const TArray<struct FInt3>& RegionCoordinates);
 };
@@ -3,192 +3,838 @@
 #include "BrickTerrainGenerationPluginPrivatePCH.h"
 #include "BrickTerrainGenerationLibrary.h"
 #include "BrickGridComponent.h"
-#include "SimplexNoise.h"
+#include "SimplexNoiseOctaves.h"
+#include "Async/ParallelFor.h"
 
 UBrickTerrainGenerationLibrary::UBrickTerrainGenerationLibrary( const FObjectInitializer& Initializer )
 : Super(Initializer)
 {}
 
-class FLocalNoiseFunction : public FNoiseFunction
+// A noise function that is sampled in the grid's local space, and is inlined into the terrain generator.
+class FLocalNoiseFunction : public FSimplexNoiseOctaves
 {
 public:
 
 	FLocalNoiseFunction(const FNoiseFunction& NoiseFunction,float LocalToWorldScale)
-	: FNoiseFunction(NoiseFunction)
-	, LocalToPeriodicScale(LocalToWorldScale / PeriodDistance)
-	{
-		SimplexNoiseModule = &ISimplexNoise::Get();
+	: FSimplexNoiseOctaves(
+		NoiseFunction.Ridged,
+		NoiseFunction.OctaveCount,
+		NoiseFunction.Lacunarity,
+		LocalToWorldScale / NoiseFunction.PeriodDistance,
+		GetValueScale(NoiseFunction),
+		(NoiseFunction.MaxValue + NoiseFunction.MinValue) / 2.0f
+		)
+	{}
+
+private:
 
+	static float GetValueScale(const FNoiseFunction& NoiseFunction)
+	{
 		// Compute the total denominator for all octaves of the noise.
 		// Sum[l^i,{i,0,n-1}] == (L^n - 1) / (L - 1)
-		const float ValueDenominator = (FMath::Pow(Lacunarity,OctaveCount) - 1.0f) / (Lacunarity - 1.0f);
+		const float ValueDenominator = (FMath::Pow(NoiseFunction.Lacunarity,NoiseFunction.OctaveCount) - 1.0f) / (NoiseFunction.Lacunarity - 1.0f);
+		return (NoiseFunction.MaxValue - NoiseFunction.MinValue) / (ValueDenominator * 2.0f);
+	}
+};
+
+// The fields of a column of terrain that don't depend on Z, which are the same for all the regions stacked along Z.
+struct FTerrainColumn
+{
+	int32 BrickRockHeight;
+	int32 BrickErodedRockHeight;
+	// The height of the ground, before it's clamped to the top of a region.
+	int32 BrickGroundHeight;
+	float Moisture;
+};
+
+// The columns of a stack of regions, indexed by LocalY * BricksPerRegion.X + LocalX.
+typedef TArray<FTerrainColumn> FTerrainColumns;
+
+// Caches the columns of each stack of regions along Z, so they're only computed once for all the regions in the stack.
+// A stack's columns are evicted once all its regions have been generated, or when the cache is full and they're the least recently used.
+class FTerrainColumnCache
+{
+public:
+
+	FTerrainColumnCache()
+	: NumUses(0)
+	{}
 
-		ValueScale = (MaxValue - MinValue) / (ValueDenominator * 2.0f);
-		ValueBias = (MaxValue + MinValue) / 2.0f;
+	// Returns the cached columns for a region's stack, or an invalid pointer if they aren't cached.
+	TSharedPtr<const FTerrainColumns,ESPMode::ThreadSafe> Find(UBrickGridComponent* Grid,const FInt3& RegionCoordinates,uint32 ParametersHash)
+	{
+		FScopeLock Lock(&CriticalSection);
+		FEntry* Entry = Entries.Find(FKey(Grid,RegionCoordinates));
+		if(Entry && Entry->ParametersHash == ParametersHash)
+		{
+			Entry->LastUseIndex = ++NumUses;
+			return Entry->Columns;
+		}
+		return TSharedPtr<const FTerrainColumns,ESPMode::ThreadSafe>();
 	}
 
-	float Sample2D(float X,float Y) const
+	// Records that a region has been generated from its stack's columns, and keeps the columns until the rest of the regions in the stack have been generated.
+	void AddGeneratedRegion(UBrickGridComponent* Grid,const FInt3& RegionCoordinates,uint32 ParametersHash,const TSharedPtr<const FTerrainColumns,ESPMode::ThreadSafe>& Columns)
 	{
-		float ScaledX = X * LocalToPeriodicScale;
-		float ScaledY = Y * LocalToPeriodicScale;
-		float Value = 0.0f;
-		for(int32 OctaveIndex = 0;OctaveIndex < OctaveCount;++OctaveIndex)
+		const int32 NumRegionsZ = Grid->Parameters.MaxRegionCoordinates.Z - Grid->Parameters.MinRegionCoordinates.Z + 1;
+		if(NumRegionsZ <= 1)
 		{
-			const float OctaveValue = SimplexNoiseModule->Sample2D(ScaledX,ScaledY);
-			Value *= Lacunarity;
-			Value += Ridged ? (-1.0f + 2.0f * (1.0f - FMath::Abs(OctaveValue))) : OctaveValue;
-			ScaledX *= Lacunarity;
-			ScaledY *= Lacunarity;
+			return;
+		}
+
+		FScopeLock Lock(&CriticalSection);
+		const FKey Key(Grid,RegionCoordinates);
+		FEntry* Entry = Entries.Find(Key);
+		if(!Entry || Entry->ParametersHash != ParametersHash)
+		{
+			if(!Entry && Entries.Num() >= MaxEntries)
+			{
+				EvictLeastRecentlyUsed();
+			}
+			Entry = &Entries.Add(Key,FEntry());
+			Entry->ParametersHash = ParametersHash;
+			Entry->Columns = Columns;
+		}
+		Entry->LastUseIndex = ++NumUses;
+		Entry->GeneratedRegionZs.Add(RegionCoordinates.Z);
+		if(Entry->GeneratedRegionZs.Num() >= NumRegionsZ)
+		{
+			Entries.Remove(Key);
 		}
-		return Value * ValueScale + ValueBias;
 	}
 
-	float Sample3D(float X,float Y,float Z) const
+private:
+
+	// The most stacks of regions to keep the columns for.
+	enum { MaxEntries = 64 };
+
+	struct FKey
+	{
+		TWeakObjectPtr<UBrickGridComponent> Grid;
+		int32 RegionX;
+		int32 RegionY;
+
+		FKey(UBrickGridComponent* InGrid,const FInt3& RegionCoordinates)
+		: Grid(InGrid)
+		, RegionX(RegionCoordinates.X)
+		, RegionY(RegionCoordinates.Y)
+		{}
+		friend bool operator==(const FKey& A,const FKey& B)
+		{
+			return A.Grid == B.Grid && A.RegionX == B.RegionX && A.RegionY == B.RegionY;
+		}
+		friend uint32 GetTypeHash(const FKey& Key)
+		{
+			return HashCombine(GetTypeHash(Key.Grid),GetTypeHash(FInt3(Key.RegionX,Key.RegionY,0)));
+		}
+	};
+
+	struct FEntry
+	{
+		uint32 ParametersHash;
+		TSharedPtr<const FTerrainColumns,ESPMode::ThreadSafe> Columns;
+		// The Z coordinates of the regions in the stack that have been generated.
+		TSet<int32> GeneratedRegionZs;
+		uint64 LastUseIndex;
+	};
+
+	FCriticalSection CriticalSection;
+	TMap<FKey,FEntry> Entries;
+	uint64 NumUses;
+
+	void EvictLeastRecentlyUsed()
 	{
-		float ScaledX = X * LocalToPeriodicScale;
-		float ScaledY = Y * LocalToPeriodicScale;
-		float ScaledZ = Z * LocalToPeriodicScale;
-		float Value = 0.0f;
-		for(int32 OctaveIndex = 0;OctaveIndex < OctaveCount;++OctaveIndex)
+		const FKey* LeastRecentlyUsedKey = NULL;
+		uint64 LeastRecentUseIndex = MAX_uint64;
+		for(const auto& Pair : Entries)
 		{
-			const float OctaveValue = SimplexNoiseModule->Sample3D(ScaledX,ScaledY,ScaledZ);
-			Value *= Lacunarity;
-			Value += Ridged ? (-1.0f + 2.0f * (1.0f - FMath::Abs(OctaveValue))) : OctaveValue;
-			ScaledX *= Lacunarity;
-			ScaledY *= Lacunarity;
-			ScaledZ *= Lacunarity;
+			if(Pair.Value.LastUseIndex < LeastRecentUseIndex)
+			{
+				LeastRecentlyUsedKey = &Pair.Key;
+				LeastRecentUseIndex = Pair.Value.LastUseIndex;
+			}
+		}
+		if(LeastRecentlyUsedKey)
+		{
+			const FKey Key = *LeastRecentlyUsedKey;
+			Entries.Remove(Key);
 		}
-		return Value * ValueScale + ValueBias;
+	}
+};
+static FTerrainColumnCache TerrainColumnCache;
+
+static uint32 HashNoiseFunction(uint32 Hash,const FNoiseFunction& NoiseFunction)
+{
+	Hash = HashCombine(Hash,GetTypeHash((uint32)NoiseFunction.Ridged));
+	Hash = HashCombine(Hash,GetTypeHash(NoiseFunction.PeriodDistance));
+	Hash = HashCombine(Hash,GetTypeHash(NoiseFunction.MinValue));
+	Hash = HashCombine(Hash,GetTypeHash(NoiseFunction.MaxValue));
+	Hash = HashCombine(Hash,GetTypeHash(NoiseFunction.OctaveCount));
+	return HashCombine(Hash,GetTypeHash(NoiseFunction.Lacunarity));
+}
+
+// Hashes everything the columns of a region depend on, so cached columns aren't used after the parameters change.
+static uint32 GetColumnParametersHash(const FBrickTerrainGenerationParameters& Parameters,float LocalToWorldScale,const FInt3& BricksPerRegion,int32 SampleSpacingXY)
+{
+	uint32 Hash = GetTypeHash(Parameters.Seed);
+	Hash = HashCombine(Hash,GetTypeHash(SampleSpacingXY));
+	Hash = HashCombine(Hash,GetTypeHash(Parameters.Scale));
+	Hash = HashCombine(Hash,GetTypeHash(LocalToWorldScale));
+	Hash = HashCombine(Hash,GetTypeHash(BricksPerRegion));
+	Hash = HashNoiseFunction(Hash,Parameters.ErosionFunction);
+	Hash = HashNoiseFunction(Hash,Parameters.UnerodedHeightFunction);
+	Hash = HashNoiseFunction(Hash,Parameters.ErodedHeightFunction);
+	Hash = HashNoiseFunction(Hash,Parameters.DirtThicknessFunction);
+	Hash = HashNoiseFunction(Hash,Parameters.MoistureFunction);
+	for(const FRichCurveKey& Key : Parameters.DirtThicknessFactorByHeight->FloatCurve.Keys)
+	{
+		Hash = HashCombine(Hash,GetTypeHash((uint32)Key.InterpMode));
+		Hash = HashCombine(Hash,GetTypeHash(Key.Time));
+		Hash = HashCombine(Hash,GetTypeHash(Key.Value));
+		Hash = HashCombine(Hash,GetTypeHash(Key.ArriveTangent));
+		Hash = HashCombine(Hash,GetTypeHash(Key.LeaveTangent));
+	}
+	return Hash;
+}
+
+// The values of the 2D noise functions that a column of terrain is computed from.
+struct FTerrainColumnNoise
+{
+	float Erosion;
+	float UnerodedHeight;
+	float ErodedHeight;
+	float DirtThickness;
+	float Moisture;
+
+	static FTerrainColumnNoise BiLerp(const FTerrainColumnNoise& P00,const FTerrainColumnNoise& P10,const FTerrainColumnNoise& P01,const FTerrainColumnNoise& P11,float FracX,float FracY)
+	{
+		FTerrainColumnNoise Result;
+		Result.Erosion = FMath::BiLerp(P00.Erosion,P10.Erosion,P01.Erosion,P11.Erosion,FracX,FracY);
+		Result.UnerodedHeight = FMath::BiLerp(P00.UnerodedHeight,P10.UnerodedHeight,P01.UnerodedHeight,P11.UnerodedHeight,FracX,FracY);
+		Result.ErodedHeight = FMath::BiLerp(P00.ErodedHeight,P10.ErodedHeight,P01.ErodedHeight,P11.ErodedHeight,FracX,FracY);
+		Result.DirtThickness = FMath::BiLerp(P00.DirtThickness,P10.DirtThickness,P01.DirtThickness,P11.DirtThickness,FracX,FracY);
+		Result.Moisture = FMath::BiLerp(P00.Moisture,P10.Moisture,P01.Moisture,P11.Moisture,FracX,FracY);
+		return Result;
+	}
+};
+
+// The terrain's noise functions, sampled in the grid's local space.
+class FTerrainNoiseFunctions
+{
+public:
+
+	// The most points SampleColumns or SampleCavernProbability can sample at once.
+	enum { MaxSamples = BrickGridConstants::MaxBricksPerRegionAxis + 1 };
+
+	FTerrainNoiseFunctions(const FBrickTerrainGenerationParameters& Parameters,float LocalToNoiseScale)
+	: BiasedSeed(Parameters.Seed + 3.14159265359f)
+	, ErosionFunction(Parameters.ErosionFunction,LocalToNoiseScale)
+	, UnerodedHeightFunction(Parameters.UnerodedHeightFunction,LocalToNoiseScale)
+	, ErodedHeightFunction(Parameters.ErodedHeightFunction,LocalToNoiseScale)
+	, DirtThicknessFunction(Parameters.DirtThicknessFunction,LocalToNoiseScale)
+	, MoistureFunction(Parameters.MoistureFunction,LocalToNoiseScale)
+	, CavernProbabilityFunction(Parameters.CavernProbabilityFunction,LocalToNoiseScale)
+	{}
+
+	// Samples the 2D noise functions at Count columns along X, StepX bricks apart, starting at MinX.
+	void SampleColumns(int32 MinX,int32 StepX,int32 Y,int32 Count,FTerrainColumnNoise* OutNoise) const
+	{
+		check(Count <= MaxSamples);
+		float Values[MaxSamples];
+		SampleColumnFunction(ErosionFunction,59,MinX,StepX,Y,Count,Values);
+		for(int32 Index = 0;Index < Count;++Index) { OutNoise[Index].Erosion = Values[Index]; }
+		SampleColumnFunction(UnerodedHeightFunction,67,MinX,StepX,Y,Count,Values);
+		for(int32 Index = 0;Index < Count;++Index) { OutNoise[Index].UnerodedHeight = Values[Index]; }
+		SampleColumnFunction(ErodedHeightFunction,71,MinX,StepX,Y,Count,Values);
+		for(int32 Index = 0;Index < Count;++Index) { OutNoise[Index].ErodedHeight = Values[Index]; }
+		SampleColumnFunction(DirtThicknessFunction,79,MinX,StepX,Y,Count,Values);
+		for(int32 Index = 0;Index < Count;++Index) { OutNoise[Index].DirtThickness = Values[Index]; }
+		SampleColumnFunction(MoistureFunction,61,MinX,StepX,Y,Count,Values);
+		for(int32 Index = 0;Index < Count;++Index) { OutNoise[Index].Moisture = Values[Index]; }
+	}
+
+	// Samples the cavern probability at Count points up a column, 4 bricks apart, starting at MinZ.
+	void SampleCavernProbability(int32 X,int32 Y,int32 MinZ,int32 Count,float* OutValues) const
+	{
+		check(Count <= MaxSamples);
+		float SampleX[MaxSamples];
+		float SampleY[MaxSamples];
+		float SampleZ[MaxSamples];
+		for(int32 Index = 0;Index < Count;++Index)
+		{
+			SampleX[Index] = BiasedSeed * 73 + X;
+			SampleY[Index] = Y;
+			SampleZ[Index] = MinZ + (Index << 2);
+		}
+		CavernProbabilityFunction.Sample3DBatch(SampleX,SampleY,SampleZ,OutValues,Count);
 	}
 
 private:
 
-	ISimplexNoise* SimplexNoiseModule;
+	const float BiasedSeed;
+	const FLocalNoiseFunction ErosionFunction;
+	const FLocalNoiseFunction UnerodedHeightFunction;
+	const FLocalNoiseFunction ErodedHeightFunction;
+	const FLocalNoiseFunction DirtThicknessFunction;
+	const FLocalNoiseFunction MoistureFunction;
+	const FLocalNoiseFunction CavernProbabilityFunction;
 
-	float LocalToPeriodicScale;
-	float ValueScale;
-	float ValueBias;
+	void SampleColumnFunction(const FLocalNoiseFunction& Function,int32 SeedFactor,int32 MinX,int32 StepX,int32 Y,int32 Count,float* OutValues) const
+	{
+		float SampleX[MaxSamples];
+		float SampleY[MaxSamples];
+		for(int32 Index = 0;Index < Count;++Index)
+		{
+			SampleX[Index] = BiasedSeed * SeedFactor + (MinX + Index * StepX);
+			SampleY[Index] = Y;
+		}
+		Function.Sample2DBatch(SampleX,SampleY,OutValues,Count);
+	}
 };
 
-void UBrickTerrainGenerationLibrary::InitRegion(const FBrickTerrainGenerationParameters& Parameters,class UBrickGridComponent* Grid,const FInt3& RegionCoordinates)
+// Divides, rounding toward negative infinity.
+static int32 FloorDivide(int32 Numerator,int32 Denominator)
 {
-	const double StartTime = FPlatformTime::Seconds();
+	return Numerator >= 0 ? Numerator / Denominator : (Numerator - Denominator + 1) / Denominator;
+}
+
+// Regions are generated in square tiles of columns, so the columns each task samples the noise for are close together.
+static const int32 TileSize = 8;
+
+static TAutoConsoleVariable<int32> CVarTerrainTilesPerTask(
+	TEXT("BrickTerrain.TilesPerTask"),
+	1,
+	TEXT("The number of 8x8 column tiles that a terrain generation thread claims at once."));
+
+static TAutoConsoleVariable<int32> CVarTerrainMaxThreads(
+	TEXT("BrickTerrain.MaxThreads"),
+	0,
+	TEXT("The most threads to generate terrain on at once, or 0 to use all the task graph's worker threads."));
+
+// Calls Function for each index in 0..Num-1 on up to BrickTerrain.MaxThreads threads, and waits for all of them to finish.
+// Each thread claims ChunkSize indices at a time from a shared counter, so threads that finish early take on the remaining work.
+static void ParallelForChunks(int32 Num,int32 ChunkSize,TFunctionRef<void(int32)> Function)
+{
+	ChunkSize = FMath::Max(1,ChunkSize);
+	const int32 NumChunks = FMath::DivideAndRoundUp(Num,ChunkSize);
+	const int32 MaxThreads = CVarTerrainMaxThreads.GetValueOnAnyThread();
+	const int32 NumThreads = FMath::Min(NumChunks,MaxThreads > 0 ? MaxThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+	FThreadSafeCounter NextChunkIndex;
+	ParallelFor(NumThreads,[&](int32 ThreadIndex)
+	{
+		for(int32 ChunkIndex = NextChunkIndex.Increment() - 1;ChunkIndex < NumChunks;ChunkIndex = NextChunkIndex.Increment() - 1)
+		{
+			const int32 EndIndex = FMath::Min(Num,(ChunkIndex + 1) * ChunkSize);
+			for(int32 Index = ChunkIndex * ChunkSize;Index < EndIndex;++Index)
+			{
+				Function(Index);
+			}
+		}
+	},NumThreads <= 1);
+}
+
+// Returns the material of every brick in a region if the region's columns show that they're all the same, or INDEX_NONE.
+static int32 GetUniformMaterialIndex(
+	const FBrickTerrainGenerationParameters& Parameters,
+	const UBrickGridComponent* Grid,
+	const FInt3& MinRegionBrickCoordinates,
+	const FInt3& MaxRegionBrickCoordinates,
+	const FTerrainColumns& Columns,
+	const float* RockCavernThresholds
+	)
+{
+	// The bottom of the grid is always the bottom material.
+	if(MinRegionBrickCoordinates.Z <= Grid->MinBrickCoordinates.Z)
+	{
+		return INDEX_NONE;
+	}
+
+	int32 MaxBrickGroundHeight = INT_MIN;
+	int32 MinBrickRockHeight = INT_MAX;
+	int32 MinBrickErodedRockHeight = INT_MAX;
+	int32 MaxBrickErodedRockHeight = INT_MIN;
+	float MinMoisture = FLT_MAX;
+	float MaxMoisture = -FLT_MAX;
+	for(const FTerrainColumn& Column : Columns)
+	{
+		MaxBrickGroundHeight = FMath::Max(MaxBrickGroundHeight,Column.BrickGroundHeight);
+		MinBrickRockHeight = FMath::Min(MinBrickRockHeight,Column.BrickRockHeight);
+		MinBrickErodedRockHeight = FMath::Min(MinBrickErodedRockHeight,Column.BrickErodedRockHeight);
+		MaxBrickErodedRockHeight = FMath::Max(MaxBrickErodedRockHeight,Column.BrickErodedRockHeight);
+		MinMoisture = FMath::Min(MinMoisture,Column.Moisture);
+		MaxMoisture = FMath::Max(MaxMoisture,Column.Moisture);
+	}
+
+	if(MaxBrickGroundHeight < MinRegionBrickCoordinates.Z)
+	{
+		return Grid->Parameters.EmptyMaterialIndex;
+	}
+
+	if(MinBrickRockHeight >= MaxRegionBrickCoordinates.Z)
+	{
+		// The cavern probability, including values interpolated between samples, is never less than the noise function's MinValue.
+		const int32 NumBricksZ = MaxRegionBrickCoordinates.Z - MinRegionBrickCoordinates.Z + 1;
+		for(int32 LocalZ = 0;LocalZ < NumBricksZ;++LocalZ)
+		{
+			if(Parameters.CavernProbabilityFunction.MinValue <= RockCavernThresholds[LocalZ])
+			{
+				return INDEX_NONE;
+			}
+		}
+
+		if(MinBrickErodedRockHeight >= MaxRegionBrickCoordinates.Z)
+		{
+			if(MaxMoisture < Parameters.SandstoneMoistureThreshold)
+			{
+				return Parameters.SandstoneMaterialIndex;
+			}
+			else if(MinMoisture >= Parameters.SandstoneMoistureThreshold)
+			{
+				return Parameters.ErodedRockMaterialIndex;
+			}
+		}
+		else if(MaxBrickErodedRockHeight < MinRegionBrickCoordinates.Z)
+		{
+			return Parameters.UnerodedRockMaterialIndex;
+		}
+	}
 
-	const float BiasedSeed = Parameters.Seed + 3.14159265359f;
+	return INDEX_NONE;
+}
+
+// The state of a region being generated by GenerateRegions.
+struct FTerrainRegionGeneration
+{
+	FInt3 RegionCoordinates;
+	FInt3 MinRegionBrickCoordinates;
+	FInt3 MaxRegionBrickCoordinates;
+
+	// The region's columns, and the same columns if this region computes them rather than finding them in the cache or sharing another region's.
+	TSharedPtr<const FTerrainColumns,ESPMode::ThreadSafe> Columns;
+	FTerrainColumns* NewColumns;
+
+	// The region's lattice of noise samples in sparse mode.
+	int32 MinLatticeX;
+	int32 MinLatticeY;
+	int32 NumLatticeX;
+	int32 NumLatticeY;
+	TArray<FTerrainColumnNoise> LatticeNoise;
+	TArray<float> LatticeCavernProbability;
+	int32 NumLatticeCavernProbabilitySamples;
+
+	// The cavern threshold curve evaluated for each brick Z in the region.
+	float RockCavernThresholds[BrickGridConstants::MaxBricksPerRegionAxis];
+	float DirtCavernThresholds[BrickGridConstants::MaxBricksPerRegionAxis];
+
+	int32 UniformMaterialIndex;
+	TArray<uint8>* BrickMaterials;
+};
+
+// Calls Function for each of the items GetNumItems returns for each region, with a single ParallelForChunks over the items of all the regions.
+static void ParallelForRegionItems(
+	TArray<FTerrainRegionGeneration>& Regions,
+	TFunctionRef<int32(const FTerrainRegionGeneration&)> GetNumItems,
+	int32 ChunkSize,
+	TFunctionRef<void(FTerrainRegionGeneration&,int32)> Function
+	)
+{
+	TArray<FIntPoint> RegionItems;
+	for(int32 RegionIndex = 0;RegionIndex < Regions.Num();++RegionIndex)
+	{
+		const int32 NumItems = GetNumItems(Regions[RegionIndex]);
+		for(int32 ItemIndex = 0;ItemIndex < NumItems;++ItemIndex)
+		{
+			RegionItems.Add(FIntPoint(RegionIndex,ItemIndex));
+		}
+	}
+	ParallelForChunks(RegionItems.Num(),ChunkSize,[&](int32 Index)
+	{
+		Function(Regions[RegionItems[Index].X],RegionItems[Index].Y);
+	});
+}
+
+// Generates the bricks of several regions without modifying the grid. Each step of the generation is a single parallel loop over the tiles or lattice rows
+// of all the regions, so a batch of regions keeps the threads busy without nesting parallel loops. For each region whose bricks all have the same material,
+// outputs the material without generating the bricks. Otherwise, outputs INDEX_NONE and the generated bricks.
+static void GenerateRegions(
+	const FBrickTerrainGenerationParameters& Parameters,
+	UBrickGridComponent* Grid,
+	const TArray<FInt3>& RegionCoordinates,
+	TArray<int32>& OutUniformMaterialIndices,
+	TArray<TArray<uint8>>& OutBrickMaterials
+	)
+{
 	const float LocalToWorldScale = Grid->GetComponentScale().GetAbs().GetMin();
-	const FLocalNoiseFunction LocalUnerodedHeightFunction(Parameters.UnerodedHeightFunction,LocalToWorldScale / Parameters.Scale);
-	const FLocalNoiseFunction LocalErodedHeightFunction(Parameters.ErodedHeightFunction,LocalToWorldScale / Parameters.Scale);
-	const FLocalNoiseFunction LocalErosionFunction(Parameters.ErosionFunction,LocalToWorldScale / Parameters.Scale);
-	const FLocalNoiseFunction LocalMoistureFunction(Parameters.MoistureFunction,LocalToWorldScale / Parameters.Scale);
-	const FLocalNoiseFunction LocalDirtThicknessFunction(Parameters.DirtThicknessFunction,LocalToWorldScale / Parameters.Scale);
-	const FLocalNoiseFunction LocalCavernProbabilityFunction(Parameters.CavernProbabilityFunction,LocalToWorldScale / Parameters.Scale);
+	const FTerrainNoiseFunctions NoiseFunctions(Parameters,LocalToWorldScale / Parameters.Scale);
 	const float NoiseToLocalScale = Parameters.Scale / LocalToWorldScale;
 
-	// Allocate a local array for the generated bricks.
 	const FInt3 BricksPerRegion = Grid->BricksPerRegion;
-	TArray<uint8> LocalBrickMaterials;
-	LocalBrickMaterials.SetNumUninitialized(BricksPerRegion.X * BricksPerRegion.Y * BricksPerRegion.Z);
 
-	const int32 XPerTask = 4;
+	// In sparse mode, the noise is only sampled on a lattice of columns SampleSpacingXY bricks apart, and interpolated between them.
+	// The lattice is aligned to the grid rather than the region, so neighboring regions interpolate between the same samples, and it
+	// has an extra row and column of samples past the max edges of the region to interpolate toward.
+	const int32 SampleSpacingXY = FMath::Clamp(Parameters.SampleSpacingXY,1,BrickGridConstants::MaxBricksPerRegionAxis);
+	const bool IsSparse = SampleSpacingXY > 1;
+	auto GetLatticeCell = [SampleSpacingXY](int32 BrickCoordinate,int32 MinLatticeCoordinate,int32& OutLatticeIndex,float& OutFraction)
+	{
+		const int32 LatticeCoordinate = FloorDivide(BrickCoordinate,SampleSpacingXY);
+		OutLatticeIndex = LatticeCoordinate - MinLatticeCoordinate;
+		OutFraction = float(BrickCoordinate - LatticeCoordinate * SampleSpacingXY) / float(SampleSpacingXY);
+	};
+
+	// Use the columns computed for another region in the same stack along Z if they're cached or being computed for this batch, or compute them.
+	const uint32 ColumnParametersHash = GetColumnParametersHash(Parameters,LocalToWorldScale,BricksPerRegion,SampleSpacingXY);
+	TArray<FTerrainRegionGeneration> Regions;
+	TMap<FIntPoint,int32> StackToRegionIndex;
+	Regions.SetNum(RegionCoordinates.Num());
+	OutUniformMaterialIndices.SetNum(RegionCoordinates.Num());
+	OutBrickMaterials.SetNum(RegionCoordinates.Num());
+	for(int32 RegionIndex = 0;RegionIndex < Regions.Num();++RegionIndex)
+	{
+		FTerrainRegionGeneration& Region = Regions[RegionIndex];
+		Region.RegionCoordinates = RegionCoordinates[RegionIndex];
+		Region.MinRegionBrickCoordinates = Region.RegionCoordinates * BricksPerRegion;
+		Region.MaxRegionBrickCoordinates = Region.MinRegionBrickCoordinates + BricksPerRegion - FInt3::Scalar(1);
+		Region.MinLatticeX = FloorDivide(Region.MinRegionBrickCoordinates.X,SampleSpacingXY);
+		Region.MinLatticeY = FloorDivide(Region.MinRegionBrickCoordinates.Y,SampleSpacingXY);
+		Region.NumLatticeX = FloorDivide(Region.MaxRegionBrickCoordinates.X,SampleSpacingXY) - Region.MinLatticeX + 2;
+		Region.NumLatticeY = FloorDivide(Region.MaxRegionBrickCoordinates.Y,SampleSpacingXY) - Region.MinLatticeY + 2;
+		Region.NumLatticeCavernProbabilitySamples = 0;
+		Region.UniformMaterialIndex = INDEX_NONE;
+		Region.BrickMaterials = &OutBrickMaterials[RegionIndex];
+		Region.NewColumns = NULL;
+
+		const FIntPoint StackCoordinates(Region.RegionCoordinates.X,Region.RegionCoordinates.Y);
+		const int32* const StackRegionIndex = StackToRegionIndex.Find(StackCoordinates);
+		if(StackRegionIndex)
+		{
+			Region.Columns = Regions[*StackRegionIndex].Columns;
+		}
+		else
+		{
+			Region.Columns = TerrainColumnCache.Find(Grid,Region.RegionCoordinates,ColumnParametersHash);
+			if(!Region.Columns.IsValid())
+			{
+				Region.NewColumns = new FTerrainColumns();
+				Region.NewColumns->SetNumUninitialized(BricksPerRegion.X * BricksPerRegion.Y);
+				Region.Columns = MakeShareable(Region.NewColumns);
+				if(IsSparse)
+				{
+					Region.LatticeNoise.SetNumUninitialized(Region.NumLatticeX * Region.NumLatticeY);
+				}
+			}
+			StackToRegionIndex.Add(StackCoordinates,RegionIndex);
+		}
+	}
+
+	// Calls TileFunction for each tile of the columns of each region that HasTiles returns true for, with the tile's min local XY and its size.
+	const int32 NumTilesX = FMath::DivideAndRoundUp(BricksPerRegion.X,TileSize);
+	const int32 NumTilesY = FMath::DivideAndRoundUp(BricksPerRegion.Y,TileSize);
+	const int32 TilesPerTask = CVarTerrainTilesPerTask.GetValueOnAnyThread();
+	auto ParallelForTiles = [&](TFunctionRef<bool(const FTerrainRegionGeneration&)> HasTiles,TFunctionRef<void(FTerrainRegionGeneration&,int32,int32,int32,int32)> TileFunction)
+	{
+		ParallelForRegionItems(Regions,[&](const FTerrainRegionGeneration& Region) { return HasTiles(Region) ? NumTilesX * NumTilesY : 0; },TilesPerTask,[&](FTerrainRegionGeneration& Region,int32 TileIndex)
+		{
+			const int32 MinLocalX = (TileIndex % NumTilesX) * TileSize;
+			const int32 MinLocalY = (TileIndex / NumTilesX) * TileSize;
+			TileFunction(Region,MinLocalX,MinLocalY,FMath::Min(TileSize,BricksPerRegion.X - MinLocalX),FMath::Min(TileSize,BricksPerRegion.Y - MinLocalY));
+		});
+	};
+	auto NeedsColumns = [](const FTerrainRegionGeneration& Region) { return Region.NewColumns != NULL; };
+	auto NeedsBricks = [](const FTerrainRegionGeneration& Region) { return Region.UniformMaterialIndex == INDEX_NONE; };
+
+	auto ComputeColumn = [&](const FTerrainColumnNoise& Noise,FTerrainColumn& OutColumn)
+	{
+		const float UnerodedRockHeight = Noise.UnerodedHeight * NoiseToLocalScale * (1-Noise.Erosion);
+		const float ErodedRockHeight = Noise.ErodedHeight * NoiseToLocalScale;
+		const float RockHeight = FMath::Max(UnerodedRockHeight,ErodedRockHeight);
+		const float BaseDirtThickness = Noise.DirtThickness * NoiseToLocalScale;
+		const float DirtThicknessFactor = Parameters.DirtThicknessFactorByHeight->FloatCurve.Eval(RockHeight * LocalToWorldScale);
+		const float DirtThickness = FMath::Max(0.0f,BaseDirtThickness * DirtThicknessFactor);
+		const float GroundHeight = RockHeight + DirtThickness;
+		OutColumn.BrickRockHeight = FMath::CeilToInt(RockHeight);
+		OutColumn.BrickErodedRockHeight = FPlatformMath::CeilToInt(ErodedRockHeight);
+		OutColumn.BrickGroundHeight = FPlatformMath::CeilToInt(GroundHeight);
+		OutColumn.Moisture = Noise.Moisture;
+	};
+
+	if(IsSparse)
+	{
+		// Sample the 2D noise functions on the lattice, and interpolate them for each column.
+		ParallelForRegionItems(Regions,[&](const FTerrainRegionGeneration& Region) { return NeedsColumns(Region) ? Region.NumLatticeY : 0; },1,[&](FTerrainRegionGeneration& Region,int32 LatticeY)
+		{
+			NoiseFunctions.SampleColumns(
+				Region.MinLatticeX * SampleSpacingXY,
+				SampleSpacingXY,
+				(Region.MinLatticeY + LatticeY) * SampleSpacingXY,
+				Region.NumLatticeX,
+				&Region.LatticeNoise[LatticeY * Region.NumLatticeX]
+				);
+		});
+		ParallelForTiles(NeedsColumns,[&](FTerrainRegionGeneration& Region,int32 MinLocalX,int32 MinLocalY,int32 SizeX,int32 SizeY)
+		{
+			for(int32 LocalY = MinLocalY;LocalY < MinLocalY + SizeY;++LocalY)
+			{
+				int32 LatticeY;
+				float FracY;
+				GetLatticeCell(Region.MinRegionBrickCoordinates.Y + LocalY,Region.MinLatticeY,LatticeY,FracY);
+				for(int32 LocalX = MinLocalX;LocalX < MinLocalX + SizeX;++LocalX)
+				{
+					int32 LatticeX;
+					float FracX;
+					GetLatticeCell(Region.MinRegionBrickCoordinates.X + LocalX,Region.MinLatticeX,LatticeX,FracX);
+					const int32 LatticeIndex = LatticeY * Region.NumLatticeX + LatticeX;
+					const FTerrainColumnNoise Noise = FTerrainColumnNoise::BiLerp(
+						Region.LatticeNoise[LatticeIndex],
+						Region.LatticeNoise[LatticeIndex + 1],
+						Region.LatticeNoise[LatticeIndex + Region.NumLatticeX],
+						Region.LatticeNoise[LatticeIndex + Region.NumLatticeX + 1],
+						FracX,
+						FracY
+						);
+					ComputeColumn(Noise,(*Region.NewColumns)[LocalY * BricksPerRegion.X + LocalX]);
+				}
+			}
+		});
+	}
+	else
+	{
+		// Sample the 2D noise functions for each row of a tile's columns at once.
+		ParallelForTiles(NeedsColumns,[&](FTerrainRegionGeneration& Region,int32 MinLocalX,int32 MinLocalY,int32 SizeX,int32 SizeY)
+		{
+			for(int32 LocalY = MinLocalY;LocalY < MinLocalY + SizeY;++LocalY)
+			{
+				FTerrainColumnNoise RowNoise[TileSize];
+				NoiseFunctions.SampleColumns(Region.MinRegionBrickCoordinates.X + MinLocalX,1,Region.MinRegionBrickCoordinates.Y + LocalY,SizeX,RowNoise);
+				for(int32 TileX = 0;TileX < SizeX;++TileX)
+				{
+					ComputeColumn(RowNoise[TileX],(*Region.NewColumns)[LocalY * BricksPerRegion.X + MinLocalX + TileX]);
+				}
+			}
+		});
+	}
+
+	// Only sample the cavern probability up to the ground in each column, which is the highest brick that uses it.
+	auto GetNumCavernProbabilitySamples = [&](const FTerrainRegionGeneration& Region,int32 BrickGroundHeight) -> int32
+	{
+		return FMath::Clamp((BrickGroundHeight - Region.MinRegionBrickCoordinates.Z + 3) >> 2,0,BrickGridConstants::MaxBricksPerRegionAxis >> 2) + 1;
+	};
+
+	for(FTerrainRegionGeneration& Region : Regions)
+	{
+		// Evaluate the cavern threshold curve once for each brick Z in the region, so the per-brick loop only reads it from a table.
+		for(int32 LocalZ = 0;LocalZ < BricksPerRegion.Z;++LocalZ)
+		{
+			const int32 Z = Region.MinRegionBrickCoordinates.Z + LocalZ;
+			Region.RockCavernThresholds[LocalZ] = Parameters.CavernThresholdByHeight->FloatCurve.Eval(Z * LocalToWorldScale);
+			Region.DirtCavernThresholds[LocalZ] = Region.RockCavernThresholds[LocalZ] + Parameters.DirtCavernThresholdBias;
+		}
+
+		// Check whether the region is uniform before generating its bricks: all air if it's above the ground in every column, or all one kind of rock
+		// if it's below the rock in every column, caverns can't open anywhere in it, and every column has the same rock material.
+		Region.UniformMaterialIndex = GetUniformMaterialIndex(
+			Parameters,
+			Grid,
+			Region.MinRegionBrickCoordinates,
+			Region.MaxRegionBrickCoordinates,
+			*Region.Columns,
+			Region.RockCavernThresholds
+			);
+		if(Region.UniformMaterialIndex != INDEX_NONE)
+		{
+			continue;
+		}
+		Region.BrickMaterials->SetNumUninitialized(BricksPerRegion.X * BricksPerRegion.Y * BricksPerRegion.Z);
+
+		// In sparse mode, the cavern probability is sampled for the lattice columns up to the highest ground in the region.
+		if(IsSparse)
+		{
+			int32 MaxBrickGroundHeight = Region.MinRegionBrickCoordinates.Z;
+			for(const FTerrainColumn& Column : *Region.Columns)
+			{
+				MaxBrickGroundHeight = FMath::Max(MaxBrickGroundHeight,FMath::Min(Region.MaxRegionBrickCoordinates.Z,Column.BrickGroundHeight));
+			}
+			Region.NumLatticeCavernProbabilitySamples = GetNumCavernProbabilitySamples(Region,MaxBrickGroundHeight);
+			Region.LatticeCavernProbability.SetNumUninitialized(Region.NumLatticeX * Region.NumLatticeY * Region.NumLatticeCavernProbabilitySamples);
+		}
+	}
 
-	const FInt3 MinRegionBrickCoordinates = RegionCoordinates * BricksPerRegion;
-	const FInt3 MaxRegionBrickCoordinates = MinRegionBrickCoordinates + BricksPerRegion - FInt3::Scalar(1);
-	FGraphEventArray XYStackCompletionEvents;
-	for(int32 LocalY = 0;LocalY < BricksPerRegion.Y;++LocalY)
+	if(IsSparse)
 	{
-		for(int32 TaskX = 0;TaskX < BricksPerRegion.X;TaskX += XPerTask)
+		ParallelForRegionItems(Regions,[&](const FTerrainRegionGeneration& Region) { return NeedsBricks(Region) ? Region.NumLatticeY : 0; },1,[&](FTerrainRegionGeneration& Region,int32 LatticeY)
 		{
-			// Create a task for each stack of constant XY.
-			XYStackCompletionEvents.Add(FFunctionGraphTask::CreateAndDispatchWhenReady([&,TaskX,LocalY]()
+			for(int32 LatticeX = 0;LatticeX < Region.NumLatticeX;++LatticeX)
 			{
-				for(int32 LocalX = TaskX;LocalX < BricksPerRegion.X && LocalX < TaskX + XPerTask;++LocalX)
+				NoiseFunctions.SampleCavernProbability(
+					(Region.MinLatticeX + LatticeX) * SampleSpacingXY,
+					(Region.MinLatticeY + LatticeY) * SampleSpacingXY,
+					Region.MinRegionBrickCoordinates.Z,
+					Region.NumLatticeCavernProbabilitySamples,
+					&Region.LatticeCavernProbability[(LatticeY * Region.NumLatticeX + LatticeX) * Region.NumLatticeCavernProbabilitySamples]
+					);
+			}
+		});
+	}
+
+	ParallelForTiles(NeedsBricks,[&](FTerrainRegionGeneration& Region,int32 MinLocalX,int32 MinLocalY,int32 SizeX,int32 SizeY)
+	{
+		const FInt3 MinRegionBrickCoordinates = Region.MinRegionBrickCoordinates;
+		const FInt3 MaxRegionBrickCoordinates = Region.MaxRegionBrickCoordinates;
+		TArray<uint8>& OutBrickMaterials = *Region.BrickMaterials;
+		for(int32 LocalY = MinLocalY;LocalY < MinLocalY + SizeY;++LocalY)
+		{
+			const int32 Y = MinRegionBrickCoordinates.Y + LocalY;
+			for(int32 LocalX = MinLocalX;LocalX < MinLocalX + SizeX;++LocalX)
+			{
+				const int32 X = MinRegionBrickCoordinates.X + LocalX;
+				const FTerrainColumn& Column = (*Region.Columns)[LocalY * BricksPerRegion.X + LocalX];
+				const int32 BrickRockHeight = Column.BrickRockHeight;
+				const int32 BrickErodedRockHeight = Column.BrickErodedRockHeight;
+				const int32 BrickGroundHeight = FMath::Min(MaxRegionBrickCoordinates.Z,Column.BrickGroundHeight);
+				const float Moisture = Column.Moisture;
+
+				// Sample the cavern probability every 4 bricks up the column, or interpolate it from the lattice in sparse mode.
+				const int32 NumCavernProbabilitySamples = GetNumCavernProbabilitySamples(Region,BrickGroundHeight);
+				float CavernSampleValues[(BrickGridConstants::MaxBricksPerRegionAxis >> 2) + 1];
+				if(IsSparse)
 				{
-					const int32 X = MinRegionBrickCoordinates.X + LocalX;
-					const int32 Y = MinRegionBrickCoordinates.Y + LocalY;
-					const float Erosion = LocalErosionFunction.Sample2D(BiasedSeed * 59 + X,Y);
-					const float UnerodedRockHeight = LocalUnerodedHeightFunction.Sample2D(BiasedSeed * 67 + X,Y) * NoiseToLocalScale * (1-Erosion);
-					const float ErodedRockHeight = LocalErodedHeightFunction.Sample2D(BiasedSeed * 71 + X,Y) * NoiseToLocalScale;
-					const float RockHeight = FMath::Max(UnerodedRockHeight,ErodedRockHeight);
-					const float BaseDirtThickness = LocalDirtThicknessFunction.Sample2D(BiasedSeed * 79 + X,Y) * NoiseToLocalScale;
-					const float DirtThicknessFactor = Parameters.DirtThicknessFactorByHeight->FloatCurve.Eval(RockHeight * LocalToWorldScale);
-					const float DirtThickness = FMath::Max(0.0f,BaseDirtThickness * DirtThicknessFactor);
-					const float GroundHeight = RockHeight + DirtThickness;
-					const float Moisture = LocalMoistureFunction.Sample2D(BiasedSeed * 61 + X,Y);
-
-					const int32 BrickUnerodedRocakHeight = FPlatformMath::CeilToInt(RockHeight);
-					const int32 BrickErodedRockHeight = FPlatformMath::CeilToInt(ErodedRockHeight);
-					const int32 BrickRockHeight = FMath::CeilToInt(RockHeight);
-					const int32 BrickGroundHeight = FMath::Min(MaxRegionBrickCoordinates.Z,FPlatformMath::CeilToInt(GroundHeight));
-
-					float CavernProbabilitySamples[BrickGridConstants::MaxBricksPerRegionAxis+1];
-					const uint32 NumCavernProbabilitySamples = FMath::Min(BrickGridConstants::MaxBricksPerRegionAxis >> 2,(BrickGroundHeight + 3) >> 2);
-					CavernProbabilitySamples[0] = LocalCavernProbabilityFunction.Sample3D(BiasedSeed * 73 + X,Y,MinRegionBrickCoordinates.Z);
-					for(uint32 CavernSampleIndex = 0;CavernSampleIndex < NumCavernProbabilitySamples;++CavernSampleIndex)
+					int32 LatticeX;
+					int32 LatticeY;
+					float FracX;
+					float FracY;
+					GetLatticeCell(X,Region.MinLatticeX,LatticeX,FracX);
+					GetLatticeCell(Y,Region.MinLatticeY,LatticeY,FracY);
+					const int32 NumLatticeCavernProbabilitySamples = Region.NumLatticeCavernProbabilitySamples;
+					const float* Samples00 = &Region.LatticeCavernProbability[(LatticeY * Region.NumLatticeX + LatticeX) * NumLatticeCavernProbabilitySamples];
+					const float* Samples10 = Samples00 + NumLatticeCavernProbabilitySamples;
+					const float* Samples01 = Samples00 + Region.NumLatticeX * NumLatticeCavernProbabilitySamples;
+					const float* Samples11 = Samples01 + NumLatticeCavernProbabilitySamples;
+					for(int32 CavernSampleIndex = 0;CavernSampleIndex < NumCavernProbabilitySamples;++CavernSampleIndex)
 					{
-						const uint32 LocalZ = CavernSampleIndex << 2;
-						const float PreviousCavernProbabilitySample = CavernProbabilitySamples[LocalZ + 0];
-						const float NextCavernProbabilitySample = LocalCavernProbabilityFunction.Sample3D(BiasedSeed * 73 + X,Y,MinRegionBrickCoordinates.Z + LocalZ + 4);
-						CavernProbabilitySamples[LocalZ + 1] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,1.0f / 4.0f);
-						CavernProbabilitySamples[LocalZ + 2] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,2.0f / 4.0f);
-						CavernProbabilitySamples[LocalZ + 3] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,3.0f / 4.0f);
-						CavernProbabilitySamples[LocalZ + 4] = NextCavernProbabilitySample;
+						CavernSampleValues[CavernSampleIndex] = FMath::BiLerp(
+							Samples00[CavernSampleIndex],
+							Samples10[CavernSampleIndex],
+							Samples01[CavernSampleIndex],
+							Samples11[CavernSampleIndex],
+							FracX,
+							FracY
+							);
 					}
+				}
+				else
+				{
+					NoiseFunctions.SampleCavernProbability(X,Y,MinRegionBrickCoordinates.Z,NumCavernProbabilitySamples,CavernSampleValues);
+				}
+				// Interpolate between the cavern probability samples for each brick.
+				float CavernProbabilitySamples[BrickGridConstants::MaxBricksPerRegionAxis+1];
+				CavernProbabilitySamples[0] = CavernSampleValues[0];
+				for(int32 CavernSampleIndex = 0;CavernSampleIndex + 1 < NumCavernProbabilitySamples;++CavernSampleIndex)
+				{
+					const int32 LocalZ = CavernSampleIndex << 2;
+					const float PreviousCavernProbabilitySample = CavernProbabilitySamples[LocalZ + 0];
+					const float NextCavernProbabilitySample = CavernSampleValues[CavernSampleIndex + 1];
+					CavernProbabilitySamples[LocalZ + 1] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,1.0f / 4.0f);
+					CavernProbabilitySamples[LocalZ + 2] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,2.0f / 4.0f);
+					CavernProbabilitySamples[LocalZ + 3] = FMath::Lerp(PreviousCavernProbabilitySample,NextCavernProbabilitySample,3.0f / 4.0f);
+					CavernProbabilitySamples[LocalZ + 4] = NextCavernProbabilitySample;
+				}
 
-					for(int32 LocalZ = 0;LocalZ < BricksPerRegion.Z;++LocalZ)
+				for(int32 LocalZ = 0;LocalZ < BricksPerRegion.Z;++LocalZ)
+				{
+					const int32 Z = MinRegionBrickCoordinates.Z + LocalZ;
+					const FInt3 BrickCoordinates(X,Y,Z);
+					int32 MaterialIndex = Grid->Parameters.EmptyMaterialIndex;
+					if(Z == Grid->MinBrickCoordinates.Z)
 					{
-						const int32 Z = MinRegionBrickCoordinates.Z + LocalZ;
-						const FInt3 BrickCoordinates(X,Y,Z);
-						int32 MaterialIndex = Grid->Parameters.EmptyMaterialIndex;
-						if(Z == Grid->MinBrickCoordinates.Z)
-						{
-							MaterialIndex = Parameters.BottomMaterialIndex;
-						}
-						else if(Z <= BrickGroundHeight)
+						MaterialIndex = Parameters.BottomMaterialIndex;
+					}
+					else if(Z <= BrickGroundHeight)
+					{
+						const float CavernProbability = CavernProbabilitySamples[LocalZ];
+						if(Z <= BrickRockHeight)
 						{
-							const float CavernProbability = CavernProbabilitySamples[LocalZ];
-							const float RockCavernThreshold = Parameters.CavernThresholdByHeight->FloatCurve.Eval(Z * LocalToWorldScale);
-							if(Z <= BrickRockHeight)
+							if(CavernProbability > Region.RockCavernThresholds[LocalZ])
 							{
-								if(CavernProbability > RockCavernThreshold)
+								if(Z <= BrickErodedRockHeight)
 								{
-									if(Z <= BrickErodedRockHeight)
+									if(Moisture < Parameters.SandstoneMoistureThreshold)
 									{
-										if(Moisture < Parameters.SandstoneMoistureThreshold)
-										{
-											MaterialIndex = Parameters.SandstoneMaterialIndex;
-										}
-										else
-										{
-											MaterialIndex = Parameters.ErodedRockMaterialIndex;
-										}
+										MaterialIndex = Parameters.SandstoneMaterialIndex;
 									}
 									else
 									{
-										MaterialIndex = Parameters.UnerodedRockMaterialIndex;
+										MaterialIndex = Parameters.ErodedRockMaterialIndex;
 									}
 								}
-							}
-							else
-							{
-								if(CavernProbability > RockCavernThreshold + Parameters.DirtCavernThresholdBias)
+								else
 								{
-									MaterialIndex = Z == BrickGroundHeight && Moisture > Parameters.GrassMoistureThreshold
-										? Parameters.GrassMaterialIndex
-										: Parameters.DirtMaterialIndex;
+									MaterialIndex = Parameters.UnerodedRockMaterialIndex;
 								}
 							}
 						}
-						LocalBrickMaterials[((LocalY * BricksPerRegion.X) + LocalX) * BricksPerRegion.Z + LocalZ] = MaterialIndex;
+						else
+						{
+							if(CavernProbability > Region.DirtCavernThresholds[LocalZ])
+							{
+								MaterialIndex = Z == BrickGroundHeight && Moisture > Parameters.GrassMoistureThreshold
+									? Parameters.GrassMaterialIndex
+									: Parameters.DirtMaterialIndex;
+							}
+						}
 					}
+					OutBrickMaterials[((LocalY * BricksPerRegion.X) + LocalX) * BricksPerRegion.Z + LocalZ] = MaterialIndex;
 				}
-			}, TStatId(), NULL));
+			}
+		}
+	});
+
+	for(int32 RegionIndex = 0;RegionIndex < Regions.Num();++RegionIndex)
+	{
+		TerrainColumnCache.AddGeneratedRegion(Grid,Regions[RegionIndex].RegionCoordinates,ColumnParametersHash,Regions[RegionIndex].Columns);
+		OutUniformMaterialIndices[RegionIndex] = Regions[RegionIndex].UniformMaterialIndex;
+	}
+}
+
+// Copies the regions generated by GenerateRegions into the grid.
+static void SetGeneratedRegions(UBrickGridComponent* Grid,const TArray<FInt3>& RegionCoordinates,const TArray<int32>& UniformMaterialIndices,const TArray<TArray<uint8>>& BrickMaterials)
+{
+	for(int32 RegionIndex = 0;RegionIndex < RegionCoordinates.Num();++RegionIndex)
+	{
+		if(UniformMaterialIndices[RegionIndex] != INDEX_NONE)
+		{
+			Grid->FillRegion(RegionCoordinates[RegionIndex],(uint8)UniformMaterialIndices[RegionIndex]);
+		}
+		else
+		{
+			const FInt3 MinRegionBrickCoordinates = RegionCoordinates[RegionIndex] * Grid->BricksPerRegion;
+			Grid->SetBrickMaterialArray(MinRegionBrickCoordinates,MinRegionBrickCoordinates + Grid->BricksPerRegion - FInt3::Scalar(1),BrickMaterials[RegionIndex]);
 		}
 	}
+}
 
-	// Wait for all the XYSlice tasks to complete.
-	FTaskGraphInterface::Get().WaitUntilTasksComplete(XYStackCompletionEvents,ENamedThreads::GameThread);
+void UBrickTerrainGenerationLibrary::InitRegion(const FBrickTerrainGenerationParameters& Parameters,class UBrickGridComponent* Grid,const FInt3& RegionCoordinates)
+{
+	const double StartTime = FPlatformTime::Seconds();
 
-	Grid->SetBrickMaterialArray(MinRegionBrickCoordinates,MaxRegionBrickCoordinates,LocalBrickMaterials);
+	TArray<FInt3> SingleRegionCoordinates;
+	SingleRegionCoordinates.Add(RegionCoordinates);
+	TArray<int32> UniformMaterialIndices;
+	TArray<TArray<uint8>> BrickMaterials;
+	GenerateRegions(Parameters,Grid,SingleRegionCoordinates,UniformMaterialIndices,BrickMaterials);
+	SetGeneratedRegions(Grid,SingleRegionCoordinates,UniformMaterialIndices,BrickMaterials);
 
 	UE_LOG(LogStats,Log,TEXT("UBrickTerrainGenerationLibrary::InitRegion took %fms"),1000.0f * float(FPlatformTime::Seconds() - StartTime));
 }
+
+void UBrickTerrainGenerationLibrary::InitRegions(const FBrickTerrainGenerationParameters& Parameters,class UBrickGridComponent* Grid,const TArray<FInt3>& RegionCoordinates)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Generate the regions in parallel, then copy them into the grid on this thread.
+	TArray<int32> UniformMaterialIndices;
+	TArray<TArray<uint8>> BrickMaterials;
+	GenerateRegions(Parameters,Grid,RegionCoordinates,UniformMaterialIndices,BrickMaterials);
+	SetGeneratedRegions(Grid,RegionCoordinates,UniformMaterialIndices,BrickMaterials);
+
+	UE_LOG(LogStats,Log,TEXT("UBrickTerrainGenerationLibrary::InitRegions took %fms for %d regions"),1000.0f * float(FPlatformTime::Seconds() - StartTime),RegionCoordinates.Num());
+}
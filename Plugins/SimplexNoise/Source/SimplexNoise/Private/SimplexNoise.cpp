@@ -21,6 +21,14 @@ class FSimplexNoise : public ISimplexNoise
 	{
 		return Implementation.Generate(X,Y,Z);
 	}
+	virtual void Sample2DBatch(const float* X,const float* Y,float* OutValues,int32 Count) override
+	{
+		Implementation.Generate(X,Y,OutValues,Count);
+	}
+	virtual void Sample3DBatch(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count) override
+	{
+		Implementation.Generate(X,Y,Z,OutValues,Count);
+	}
 };
 IMPLEMENT_MODULE( FSimplexNoise, SimplexNoise )
 
@@ -54,4 +62,12 @@ namespace SimplexNoise
 	{
 		return Implementation.Generate(X,Y,Z);
 	}
+	void Sample2DBatch(const float* X,const float* Y,float* OutValues,int32 Count)
+	{
+		Implementation.Generate(X,Y,OutValues,Count);
+	}
+	void Sample3DBatch(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count)
+	{
+		Implementation.Generate(X,Y,Z,OutValues,Count);
+	}
 };
@@ -27,6 +27,16 @@
 
 //For more information, please refer to <http://unlicense.org/>
 
+#pragma once
+
+// The batched samplers evaluate 4 samples at a time with SSE2 where it's available.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIMPLEXNOISE_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define SIMPLEXNOISE_SSE2 0
+#endif
+
 class FPublicDomainSimplexNoiseImplementation
 {
 public:
@@ -36,9 +46,9 @@ public:
     /// </summary>
     /// <param name="x"></param>
     /// <returns></returns>
-    float Generate(float x)
+    float Generate(float x) const
     {
-        int32 i0 = FMath::FloorToInt(x);
+        int32 i0 = fastfloor(x);
         int32 i1 = i0 + 1;
         float x0 = x - i0;
         float x1 = x0 - 1.0f;
@@ -63,7 +73,7 @@ public:
     /// <param name="x"></param>
     /// <param name="y"></param>
     /// <returns></returns>
-    float Generate(float x, float y)
+    float Generate(float x, float y) const
     {
         const float F2 = 0.366025403f; // F2 = 0.5*(sqrt(3.0)-1.0)
         const float G2 = 0.211324865f; // G2 = (3.0-Math.sqrt(3.0))/6.0
@@ -74,8 +84,8 @@ public:
         float s = (x+y)*F2; // Hairy factor for 2D
         float xs = x + s;
         float ys = y + s;
-        int32 i = FMath::FloorToInt(xs);
-        int32 j = FMath::FloorToInt(ys);
+        int32 i = fastfloor(xs);
+        int32 j = fastfloor(ys);
 
         float t = (float)(i+j)*G2;
         float X0 = i-t; // Unskew the cell origin back to (x,y) space
@@ -130,7 +140,7 @@ public:
     }
 
 
-    float Generate(float x, float y, float z)
+    float Generate(float x, float y, float z) const
     {
         // Simple skewing factors for the 3D case
         const float F3 = 0.333333333f;
@@ -143,9 +153,9 @@ public:
         float xs = x+s;
         float ys = y+s;
         float zs = z+s;
-        int32 i = FMath::FloorToInt(xs);
-        int32 j = FMath::FloorToInt(ys);
-        int32 k = FMath::FloorToInt(zs);
+        int32 i = fastfloor(xs);
+        int32 j = fastfloor(ys);
+        int32 k = fastfloor(zs);
 
         float t = (float)(i+j+k)*G3; 
         float X0 = i-t; // Unskew the cell origin back to (x,y,z) space
@@ -227,6 +237,42 @@ public:
         return 32.0f * (n0 + n1 + n2 + n3); // TODO: The scale factor is preliminary!
     }
 
+    /// <summary>
+    /// Batched 2D simplex noise. Each result is bit-identical to the scalar Generate(x,y).
+    /// </summary>
+    void Generate(const float* x, const float* y, float* result, int32 count) const
+    {
+        int32 index = 0;
+#if SIMPLEXNOISE_SSE2
+        for(; index + 4 <= count; index += 4)
+        {
+            _mm_storeu_ps(result + index, Generate4(_mm_loadu_ps(x + index), _mm_loadu_ps(y + index)));
+        }
+#endif
+        for(; index < count; ++index)
+        {
+            result[index] = Generate(x[index], y[index]);
+        }
+    }
+
+    /// <summary>
+    /// Batched 3D simplex noise. Each result is bit-identical to the scalar Generate(x,y,z).
+    /// </summary>
+    void Generate(const float* x, const float* y, const float* z, float* result, int32 count) const
+    {
+        int32 index = 0;
+#if SIMPLEXNOISE_SSE2
+        for(; index + 4 <= count; index += 4)
+        {
+            _mm_storeu_ps(result + index, Generate4(_mm_loadu_ps(x + index), _mm_loadu_ps(y + index), _mm_loadu_ps(z + index)));
+        }
+#endif
+        for(; index < count; ++index)
+        {
+            result[index] = Generate(x[index], y[index], z[index]);
+        }
+    }
+
     FPublicDomainSimplexNoiseImplementation()
     {
         static const uint8 localPerm[512] = { 151,160,137,91,90,15,
@@ -261,7 +307,183 @@ public:
 
 private:
 
-    float grad( int32 hash, float x )
+    // Rounds toward negative infinity. Unlike FMath::FloorToInt, this is exact for any float that fits in an int32 on every platform,
+    // which the batched samplers depend on to match the scalar samplers.
+    // The SSE FMath::FloorToInt rounds 2x - 0.5 to nearest and halves it, which is only exact while 2x - 0.5 is, so the noise is only
+    // bit-identical to what the samplers produced with FloorToInt while every sample coordinate, after skewing, is within +/-2^22.
+    // Beyond that, FloorToInt could return the wrong lattice cell, and this returns the right one, so the noise there differs.
+    static int32 fastfloor( float x )
+    {
+        int32 truncated = (int32)x;
+        return x < truncated ? truncated - 1 : truncated;
+    }
+
+#if SIMPLEXNOISE_SSE2
+    // The SIMD versions of the scalar samplers do the same floating-point operations in the same order, so each lane gets exactly the
+    // same result as the scalar sampler. Only the permutation table lookups are done a lane at a time.
+
+    static __m128i fastfloor4( __m128 x )
+    {
+        __m128i truncated = _mm_cvttps_epi32(x);
+        // Truncation rounds negative values up, so subtract one from the lanes where it did.
+        return _mm_add_epi32(truncated, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(truncated))));
+    }
+
+    // Selects a where the mask is set, and b elsewhere.
+    static __m128 select4( __m128 mask, __m128 a, __m128 b )
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // Flips the sign of the lanes where the given bit of the hash is set, like negating them.
+    static __m128 negateIf4( __m128i hash, int32 bit, __m128 x )
+    {
+        __m128i bitMask = _mm_set1_epi32(bit);
+        return _mm_xor_ps(x, _mm_castsi128_ps(_mm_slli_epi32(_mm_cmpeq_epi32(_mm_and_si128(hash, bitMask), bitMask), 31)));
+    }
+
+    // Computes t^4 * gradient, or zero where t is negative.
+    static __m128 contribution4( __m128 t, __m128 gradient )
+    {
+        __m128 t2 = _mm_mul_ps(t, t);
+        return _mm_andnot_ps(_mm_cmplt_ps(t, _mm_setzero_ps()), _mm_mul_ps(_mm_mul_ps(t2, t2), gradient));
+    }
+
+    static __m128i load4( const int32* values )
+    {
+        return _mm_setr_epi32(values[0], values[1], values[2], values[3]);
+    }
+
+public:
+
+    // Samples 4 points at once. Callers that keep their own state in SSE registers, such as summing octaves of noise, can use these directly.
+
+    __m128 Generate4(__m128 x, __m128 y) const
+    {
+        const float F2 = 0.366025403f;
+        const float G2 = 0.211324865f;
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        __m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+        __m128i i = fastfloor4(_mm_add_ps(x, s));
+        __m128i j = fastfloor4(_mm_add_ps(y, s));
+
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), _mm_set1_ps(G2));
+        __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+        __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+        __m128 lower = _mm_cmpgt_ps(x0, y0);
+        __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(lower, one)), _mm_set1_ps(G2));
+        __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_andnot_ps(lower, one)), _mm_set1_ps(G2));
+        __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(2.0f * G2));
+        __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(2.0f * G2));
+
+        // Look up the corners' hashes a lane at a time.
+        int32 ii[4], jj[4], h0[4], h1[4], h2[4];
+        _mm_storeu_si128((__m128i*)ii, _mm_and_si128(i, _mm_set1_epi32(255)));
+        _mm_storeu_si128((__m128i*)jj, _mm_and_si128(j, _mm_set1_epi32(255)));
+        int32 lowerBits = _mm_movemask_ps(lower);
+        for(int32 lane = 0; lane < 4; ++lane)
+        {
+            int32 i1 = (lowerBits >> lane) & 1;
+            int32 j1 = 1 - i1;
+            h0[lane] = perm[ii[lane]+perm[jj[lane]]];
+            h1[lane] = perm[ii[lane]+i1+perm[jj[lane]+j1]];
+            h2[lane] = perm[ii[lane]+1+perm[jj[lane]+1]];
+        }
+
+        const __m128 half = _mm_set1_ps(0.5f);
+        __m128 n0 = contribution4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), grad4(load4(h0), x0, y0));
+        __m128 n1 = contribution4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), grad4(load4(h1), x1, y1));
+        __m128 n2 = contribution4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), grad4(load4(h2), x2, y2));
+        return _mm_mul_ps(_mm_set1_ps(40.0f), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+    }
+
+    __m128 Generate4(__m128 x, __m128 y, __m128 z) const
+    {
+        const float F3 = 0.333333333f;
+        const float G3 = 0.166666667f;
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+        __m128i i = fastfloor4(_mm_add_ps(x, s));
+        __m128i j = fastfloor4(_mm_add_ps(y, s));
+        __m128i k = fastfloor4(_mm_add_ps(z, s));
+
+        __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), _mm_set1_ps(G3));
+        __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+        __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+        __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+        // The same simplex selection as the scalar sampler's branches, expressed as the order of x0, y0 and z0.
+        __m128 xy = _mm_cmpge_ps(x0, y0);
+        __m128 yz = _mm_cmpge_ps(y0, z0);
+        __m128 xz = _mm_cmpge_ps(x0, z0);
+        __m128 i1 = _mm_and_ps(xy, xz);
+        __m128 j1 = _mm_andnot_ps(xy, yz);
+        __m128 k1 = _mm_andnot_ps(_mm_or_ps(xz, yz), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+        __m128 i2 = _mm_or_ps(xy, xz);
+        __m128 j2 = _mm_or_ps(_mm_andnot_ps(xy, _mm_castsi128_ps(_mm_set1_epi32(-1))), yz);
+        __m128 k2 = _mm_andnot_ps(_mm_and_ps(xz, yz), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+        __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i1, one)), _mm_set1_ps(G3));
+        __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j1, one)), _mm_set1_ps(G3));
+        __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k1, one)), _mm_set1_ps(G3));
+        __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(i2, one)), _mm_set1_ps(2.0f*G3));
+        __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(j2, one)), _mm_set1_ps(2.0f*G3));
+        __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(k2, one)), _mm_set1_ps(2.0f*G3));
+        __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(3.0f*G3));
+        __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(3.0f*G3));
+        __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, one), _mm_set1_ps(3.0f*G3));
+
+        // Look up the corners' hashes a lane at a time.
+        int32 ii[4], jj[4], kk[4], h0[4], h1[4], h2[4], h3[4];
+        _mm_storeu_si128((__m128i*)ii, _mm_and_si128(i, _mm_set1_epi32(255)));
+        _mm_storeu_si128((__m128i*)jj, _mm_and_si128(j, _mm_set1_epi32(255)));
+        _mm_storeu_si128((__m128i*)kk, _mm_and_si128(k, _mm_set1_epi32(255)));
+        int32 i1Bits = _mm_movemask_ps(i1), j1Bits = _mm_movemask_ps(j1), k1Bits = _mm_movemask_ps(k1);
+        int32 i2Bits = _mm_movemask_ps(i2), j2Bits = _mm_movemask_ps(j2), k2Bits = _mm_movemask_ps(k2);
+        for(int32 lane = 0; lane < 4; ++lane)
+        {
+            int32 a = ii[lane], b = jj[lane], c = kk[lane];
+            int32 ai1 = (i1Bits >> lane) & 1, bj1 = (j1Bits >> lane) & 1, ck1 = (k1Bits >> lane) & 1;
+            int32 ai2 = (i2Bits >> lane) & 1, bj2 = (j2Bits >> lane) & 1, ck2 = (k2Bits >> lane) & 1;
+            h0[lane] = perm[a+perm[b+perm[c]]];
+            h1[lane] = perm[a+ai1+perm[b+bj1+perm[c+ck1]]];
+            h2[lane] = perm[a+ai2+perm[b+bj2+perm[c+ck2]]];
+            h3[lane] = perm[a+1+perm[b+1+perm[c+1]]];
+        }
+
+        const __m128 c0 = _mm_set1_ps(0.6f);
+        __m128 n0 = contribution4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(c0, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), _mm_mul_ps(z0, z0)), grad4(load4(h0), x0, y0, z0));
+        __m128 n1 = contribution4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(c0, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), _mm_mul_ps(z1, z1)), grad4(load4(h1), x1, y1, z1));
+        __m128 n2 = contribution4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(c0, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), _mm_mul_ps(z2, z2)), grad4(load4(h2), x2, y2, z2));
+        __m128 n3 = contribution4(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(c0, _mm_mul_ps(x3, x3)), _mm_mul_ps(y3, y3)), _mm_mul_ps(z3, z3)), grad4(load4(h3), x3, y3, z3));
+        return _mm_mul_ps(_mm_set1_ps(32.0f), _mm_add_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), n3));
+    }
+
+private:
+
+    static __m128 grad4( __m128i hash, __m128 x, __m128 y )
+    {
+        __m128i h = _mm_and_si128(hash, _mm_set1_epi32(7));
+        __m128 hLessThan4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+        __m128 u = select4(hLessThan4, x, y);
+        __m128 v = select4(hLessThan4, y, x);
+        return _mm_add_ps(negateIf4(h, 1, u), negateIf4(h, 2, _mm_mul_ps(_mm_set1_ps(2.0f), v)));
+    }
+
+    static __m128 grad4( __m128i hash, __m128 x, __m128 y, __m128 z )
+    {
+        __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+        __m128 u = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8))), x, y);
+        __m128 hIs12Or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+        __m128 v = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4))), y, select4(hIs12Or14, x, z));
+        return _mm_add_ps(negateIf4(h, 1, u), negateIf4(h, 2, v));
+    }
+#endif
+
+    float grad( int32 hash, float x ) const
     {
         int32 h = hash & 15;
         float grad = 1.0f + (h & 7);   // Gradient value 1.0, 2.0, ..., 8.0
@@ -269,7 +491,7 @@ private:
         return ( grad * x );           // Multiply the gradient with the distance
     }
 
-    float grad( int32 hash, float x, float y )
+    float grad( int32 hash, float x, float y ) const
     {
         int32 h = hash & 7;      // Convert low 3 bits of hash code
         float u = h<4 ? x : y;  // into 8 simple gradient directions,
@@ -277,14 +499,14 @@ private:
         return ((h&1) != 0 ? -u : u) + ((h&2) != 0 ? -2.0f*v : 2.0f*v);
     }
 
-    float grad( int32 hash, float x, float y , float z ) {
+    float grad( int32 hash, float x, float y , float z ) const {
         int32 h = hash & 15;     // Convert low 4 bits of hash code into 12 simple
         float u = h<8 ? x : y; // gradient directions, and compute dot product.
         float v = h<4 ? y : h==12||h==14 ? x : z; // Fix repeats at h = 12 to 15
         return ((h&1) != 0 ? -u : u) + ((h&2) != 0 ? -v : v);
     }
 
-    float grad( int32 hash, float x, float y, float z, float t ) {
+    float grad( int32 hash, float x, float y, float z, float t ) const {
         int32 h = hash & 31;      // Convert low 5 bits of hash code into 32 simple
         float u = h<24 ? x : y; // gradient directions, and compute dot product.
         float v = h<16 ? y : z;
@@ -24,6 +24,12 @@ public:
 	virtual float Sample2D(float X,float Y) = 0;
 	// Samples a 3D simplex noise function, returning a value between 0-1.
 	virtual float Sample3D(float X,float Y,float Z) = 0;
+
+	// Samples the 2D simplex noise function at Count points, writing the results to OutValues. Several samples are computed
+	// at once with SIMD instructions where they're available, but each result is bit-identical to the result of Sample2D.
+	virtual void Sample2DBatch(const float* X,const float* Y,float* OutValues,int32 Count) = 0;
+	// Samples the 3D simplex noise function at Count points, writing the results to OutValues. Each result is bit-identical to the result of Sample3D.
+	virtual void Sample3DBatch(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count) = 0;
 };
 
 /** The statically-loaded module interface. */
@@ -35,4 +41,8 @@ namespace SimplexNoise
 	SIMPLEXNOISE_API float Sample2D(float X,float Y);
 	// Samples a 3D simplex noise function, returning a value between 0-1.
 	SIMPLEXNOISE_API float Sample3D(float X,float Y,float Z);
+	// Samples the 2D simplex noise function at Count points. Each result is bit-identical to the result of Sample2D.
+	SIMPLEXNOISE_API void Sample2DBatch(const float* X,const float* Y,float* OutValues,int32 Count);
+	// Samples the 3D simplex noise function at Count points. Each result is bit-identical to the result of Sample3D.
+	SIMPLEXNOISE_API void Sample3DBatch(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count);
 }
@@ -0,0 +1,201 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#pragma once
+
+#include "PublicDomainSimplexNoise.inl"
+
+/**
+ * Sums octaves of simplex noise. Each octave samples the noise at Lacunarity times the frequency of the previous octave, and the sum of the
+ * previous octaves is multiplied by Lacunarity before the octave is added to it. Ridged noise folds each octave's value around zero.
+ * This is header-only, so the noise is inlined into the octave loop instead of being called through the ISimplexNoise module interface.
+ * The octave loop is unrolled for common octave counts, and the unrolled loop is chosen when the noise is constructed rather than per sample.
+ */
+class FSimplexNoiseOctaves
+{
+public:
+
+	// InputScale is applied to the coordinates of the first octave, and OutputScale and OutputBias are applied to the sum of the octaves.
+	FSimplexNoiseOctaves(bool Ridged,int32 InOctaveCount,float InLacunarity,float InInputScale,float InOutputScale,float InOutputBias)
+	: OctaveCount(InOctaveCount)
+	, Lacunarity(InLacunarity)
+	, InputScale(InInputScale)
+	, OutputScale(InOutputScale)
+	, OutputBias(InOutputBias)
+	, Sample2DFunction(Ridged ? GetSample2DFunction<true>(InOctaveCount) : GetSample2DFunction<false>(InOctaveCount))
+	, Sample3DFunction(Ridged ? GetSample3DFunction<true>(InOctaveCount) : GetSample3DFunction<false>(InOctaveCount))
+	{}
+
+	// Samples the noise at Count points, writing the results to OutValues.
+	void Sample2DBatch(const float* X,const float* Y,float* OutValues,int32 Count) const
+	{
+		(this->*Sample2DFunction)(X,Y,OutValues,Count);
+	}
+	void Sample3DBatch(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count) const
+	{
+		(this->*Sample3DFunction)(X,Y,Z,OutValues,Count);
+	}
+
+	float Sample2D(float X,float Y) const
+	{
+		float Result;
+		Sample2DBatch(&X,&Y,&Result,1);
+		return Result;
+	}
+	float Sample3D(float X,float Y,float Z) const
+	{
+		float Result;
+		Sample3DBatch(&X,&Y,&Z,&Result,1);
+		return Result;
+	}
+
+private:
+
+	typedef void (FSimplexNoiseOctaves::*FSample2DFunction)(const float*,const float*,float*,int32) const;
+	typedef void (FSimplexNoiseOctaves::*FSample3DFunction)(const float*,const float*,const float*,float*,int32) const;
+
+	FPublicDomainSimplexNoiseImplementation Noise;
+
+	int32 OctaveCount;
+	float Lacunarity;
+	float InputScale;
+	float OutputScale;
+	float OutputBias;
+
+	FSample2DFunction Sample2DFunction;
+	FSample3DFunction Sample3DFunction;
+
+	// Adds an octave's value to the sum of the previous octaves, scaled by the lacunarity.
+	template<bool Ridged>
+	static FORCEINLINE float AccumulateOctave(float Sum,float OctaveValue,float SumScale)
+	{
+		Sum *= SumScale;
+		Sum += Ridged ? (-1.0f + 2.0f * (1.0f - FMath::Abs(OctaveValue))) : OctaveValue;
+		return Sum;
+	}
+
+#if SIMPLEXNOISE_SSE2
+	// Adds 4 octave values to 4 sums, with the same floating-point operations as AccumulateOctave.
+	template<bool Ridged>
+	static FORCEINLINE __m128 AccumulateOctave4(__m128 Sum,__m128 OctaveValue,__m128 SumScale)
+	{
+		Sum = _mm_mul_ps(Sum,SumScale);
+		if(Ridged)
+		{
+			const __m128 AbsOctaveValue = _mm_andnot_ps(_mm_set1_ps(-0.0f),OctaveValue);
+			OctaveValue = _mm_add_ps(_mm_set1_ps(-1.0f),_mm_mul_ps(_mm_set1_ps(2.0f),_mm_sub_ps(_mm_set1_ps(1.0f),AbsOctaveValue)));
+		}
+		return _mm_add_ps(Sum,OctaveValue);
+	}
+#endif
+
+	// Samples the octaves of 2D noise. StaticOctaveCount is the octave count the loop is unrolled for, or 0 to loop over OctaveCount.
+	// The SIMD loop keeps 4 points' coordinates and sums in registers across all the octaves.
+	template<bool Ridged,int32 StaticOctaveCount>
+	void Sample2DOctaves(const float* X,const float* Y,float* OutValues,int32 Count) const
+	{
+		const int32 NumOctaves = StaticOctaveCount ? StaticOctaveCount : OctaveCount;
+		int32 Index = 0;
+#if SIMPLEXNOISE_SSE2
+		const __m128 Lacunarity4 = _mm_set1_ps(Lacunarity);
+		const __m128 InputScale4 = _mm_set1_ps(InputScale);
+		const __m128 OutputScale4 = _mm_set1_ps(OutputScale);
+		const __m128 OutputBias4 = _mm_set1_ps(OutputBias);
+		for(;Index + 4 <= Count;Index += 4)
+		{
+			__m128 ScaledX = _mm_mul_ps(_mm_loadu_ps(X + Index),InputScale4);
+			__m128 ScaledY = _mm_mul_ps(_mm_loadu_ps(Y + Index),InputScale4);
+			__m128 Sum = _mm_setzero_ps();
+			for(int32 OctaveIndex = 0;OctaveIndex < NumOctaves;++OctaveIndex)
+			{
+				Sum = AccumulateOctave4<Ridged>(Sum,Noise.Generate4(ScaledX,ScaledY),Lacunarity4);
+				ScaledX = _mm_mul_ps(ScaledX,Lacunarity4);
+				ScaledY = _mm_mul_ps(ScaledY,Lacunarity4);
+			}
+			_mm_storeu_ps(OutValues + Index,_mm_add_ps(_mm_mul_ps(Sum,OutputScale4),OutputBias4));
+		}
+#endif
+		for(;Index < Count;++Index)
+		{
+			float ScaledX = X[Index] * InputScale;
+			float ScaledY = Y[Index] * InputScale;
+			float Sum = 0.0f;
+			for(int32 OctaveIndex = 0;OctaveIndex < NumOctaves;++OctaveIndex)
+			{
+				Sum = AccumulateOctave<Ridged>(Sum,Noise.Generate(ScaledX,ScaledY),Lacunarity);
+				ScaledX *= Lacunarity;
+				ScaledY *= Lacunarity;
+			}
+			OutValues[Index] = Sum * OutputScale + OutputBias;
+		}
+	}
+
+	// Samples the octaves of 3D noise. StaticOctaveCount is the octave count the loop is unrolled for, or 0 to loop over OctaveCount.
+	template<bool Ridged,int32 StaticOctaveCount>
+	void Sample3DOctaves(const float* X,const float* Y,const float* Z,float* OutValues,int32 Count) const
+	{
+		const int32 NumOctaves = StaticOctaveCount ? StaticOctaveCount : OctaveCount;
+		int32 Index = 0;
+#if SIMPLEXNOISE_SSE2
+		const __m128 Lacunarity4 = _mm_set1_ps(Lacunarity);
+		const __m128 InputScale4 = _mm_set1_ps(InputScale);
+		const __m128 OutputScale4 = _mm_set1_ps(OutputScale);
+		const __m128 OutputBias4 = _mm_set1_ps(OutputBias);
+		for(;Index + 4 <= Count;Index += 4)
+		{
+			__m128 ScaledX = _mm_mul_ps(_mm_loadu_ps(X + Index),InputScale4);
+			__m128 ScaledY = _mm_mul_ps(_mm_loadu_ps(Y + Index),InputScale4);
+			__m128 ScaledZ = _mm_mul_ps(_mm_loadu_ps(Z + Index),InputScale4);
+			__m128 Sum = _mm_setzero_ps();
+			for(int32 OctaveIndex = 0;OctaveIndex < NumOctaves;++OctaveIndex)
+			{
+				Sum = AccumulateOctave4<Ridged>(Sum,Noise.Generate4(ScaledX,ScaledY,ScaledZ),Lacunarity4);
+				ScaledX = _mm_mul_ps(ScaledX,Lacunarity4);
+				ScaledY = _mm_mul_ps(ScaledY,Lacunarity4);
+				ScaledZ = _mm_mul_ps(ScaledZ,Lacunarity4);
+			}
+			_mm_storeu_ps(OutValues + Index,_mm_add_ps(_mm_mul_ps(Sum,OutputScale4),OutputBias4));
+		}
+#endif
+		for(;Index < Count;++Index)
+		{
+			float ScaledX = X[Index] * InputScale;
+			float ScaledY = Y[Index] * InputScale;
+			float ScaledZ = Z[Index] * InputScale;
+			float Sum = 0.0f;
+			for(int32 OctaveIndex = 0;OctaveIndex < NumOctaves;++OctaveIndex)
+			{
+				Sum = AccumulateOctave<Ridged>(Sum,Noise.Generate(ScaledX,ScaledY,ScaledZ),Lacunarity);
+				ScaledX *= Lacunarity;
+				ScaledY *= Lacunarity;
+				ScaledZ *= Lacunarity;
+			}
+			OutValues[Index] = Sum * OutputScale + OutputBias;
+		}
+	}
+
+	// Chooses the sampler that is unrolled for an octave count, or the sampler that loops over OctaveCount for uncommon octave counts.
+	template<bool Ridged>
+	static FSample2DFunction GetSample2DFunction(int32 NumOctaves)
+	{
+		switch(NumOctaves)
+		{
+		case 1: return &FSimplexNoiseOctaves::Sample2DOctaves<Ridged,1>;
+		case 2: return &FSimplexNoiseOctaves::Sample2DOctaves<Ridged,2>;
+		case 3: return &FSimplexNoiseOctaves::Sample2DOctaves<Ridged,3>;
+		case 4: return &FSimplexNoiseOctaves::Sample2DOctaves<Ridged,4>;
+		default: return &FSimplexNoiseOctaves::Sample2DOctaves<Ridged,0>;
+		}
+	}
+	template<bool Ridged>
+	static FSample3DFunction GetSample3DFunction(int32 NumOctaves)
+	{
+		switch(NumOctaves)
+		{
+		case 1: return &FSimplexNoiseOctaves::Sample3DOctaves<Ridged,1>;
+		case 2: return &FSimplexNoiseOctaves::Sample3DOctaves<Ridged,2>;
+		case 3: return &FSimplexNoiseOctaves::Sample3DOctaves<Ridged,3>;
+		case 4: return &FSimplexNoiseOctaves::Sample3DOctaves<Ridged,4>;
+		default: return &FSimplexNoiseOctaves::Sample3DOctaves<Ridged,0>;
+		}
+	}
+};
@@ -0,0 +1,897 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+
+#include "BrickGame.h"
+#include "BrickBenchmarkCommandlet.h"
+#include "BrickGridComponent.h"
+#include "BrickTerrainGenerationLibrary.h"
+#include "BrickMesher.h"
+#include "SimplexNoise.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogBrickBenchmark,Log,All);
+
+// The material indices used by the benchmark grid.
+namespace BenchmarkMaterials
+{
+	enum
+	{
+		Empty,
+		Bottom,
+		Sandstone,
+		ErodedRock,
+		UnerodedRock,
+		Dirt,
+		Grass,
+		Water,
+		Lamp,
+		Count
+	};
+};
+
+UBrickBenchmarkCommandlet::UBrickBenchmarkCommandlet(const class FObjectInitializer& Initializer)
+	: Super(Initializer)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+// Creates a noise function with the given range.
+static FNoiseFunction MakeNoiseFunction(bool Ridged,float PeriodDistance,float MinValue,float MaxValue,int32 OctaveCount)
+{
+	FNoiseFunction Result;
+	Result.Ridged = Ridged;
+	Result.PeriodDistance = PeriodDistance;
+	Result.MinValue = MinValue;
+	Result.MaxValue = MaxValue;
+	Result.OctaveCount = OctaveCount;
+	Result.Lacunarity = 2.0f;
+	return Result;
+}
+
+// Creates a fixed set of terrain generation parameters, so the generated terrain is the same for every run of the benchmark.
+static FBrickTerrainGenerationParameters CreateBenchmarkTerrainParameters()
+{
+	FBrickTerrainGenerationParameters Result;
+	Result.Seed = 0;
+	Result.Scale = 1.0f;
+	Result.UnerodedHeightFunction = MakeNoiseFunction(false,2000.0f,0.0f,96.0f,4);
+	Result.ErodedHeightFunction = MakeNoiseFunction(false,1000.0f,8.0f,48.0f,4);
+	Result.UnerodedRockHeightFunction = MakeNoiseFunction(false,1000.0f,0.0f,64.0f,4);
+	Result.ErodedRockHeightFunction = MakeNoiseFunction(false,1000.0f,0.0f,32.0f,4);
+	Result.MoistureFunction = MakeNoiseFunction(false,2000.0f,-1.0f,1.0f,2);
+	Result.ErosionFunction = MakeNoiseFunction(false,1500.0f,0.0f,1.0f,2);
+	Result.DirtThicknessFunction = MakeNoiseFunction(false,200.0f,0.0f,6.0f,2);
+	Result.CavernProbabilityFunction = MakeNoiseFunction(true,100.0f,0.0f,1.0f,2);
+
+	Result.DirtThicknessFactorByHeight = NewObject<UCurveFloat>(GetTransientPackage());
+	Result.DirtThicknessFactorByHeight->AddToRoot();
+	Result.DirtThicknessFactorByHeight->FloatCurve.AddKey(0.0f,1.0f);
+	Result.DirtThicknessFactorByHeight->FloatCurve.AddKey(96.0f,0.0f);
+
+	Result.CavernThresholdByHeight = NewObject<UCurveFloat>(GetTransientPackage());
+	Result.CavernThresholdByHeight->AddToRoot();
+	Result.CavernThresholdByHeight->FloatCurve.AddKey(0.0f,0.15f);
+	Result.CavernThresholdByHeight->FloatCurve.AddKey(96.0f,0.3f);
+
+	Result.DirtCavernThresholdBias = 0.05f;
+	Result.GrassMoistureThreshold = 0.0f;
+	Result.SandstoneMoistureThreshold = -0.5f;
+	Result.SandstoneMaterialIndex = BenchmarkMaterials::Sandstone;
+	Result.ErodedRockMaterialIndex = BenchmarkMaterials::ErodedRock;
+	Result.UnerodedRockMaterialIndex = BenchmarkMaterials::UnerodedRock;
+	Result.DirtMaterialIndex = BenchmarkMaterials::Dirt;
+	Result.GrassMaterialIndex = BenchmarkMaterials::Grass;
+	Result.BottomMaterialIndex = BenchmarkMaterials::Bottom;
+	return Result;
+}
+
+// Creates a grid with NumRegionsXY x NumRegionsXY regions of generated terrain, starting at region 0,0,0.
+// If an owner is given, the grid is registered as its root component, so it can create chunk components in the owner's world.
+static UBrickGridComponent* CreateBenchmarkGrid(int32 NumRegionsXY,bool EnableLightPropagation,bool Headless = false,AActor* Owner = NULL)
+{
+	FBrickGridParameters GridParameters;
+	GridParameters.Materials.SetNum(BenchmarkMaterials::Count);
+	GridParameters.Materials[BenchmarkMaterials::Lamp].LightEmission = 14;
+	GridParameters.EmptyMaterialIndex = BenchmarkMaterials::Empty;
+	GridParameters.BricksPerRegionLog2 = FInt3(7,7,7);
+	GridParameters.RenderChunksPerRegionLog2 = FInt3(2,2,2);
+	GridParameters.MinRegionCoordinates = FInt3(0,0,0);
+	GridParameters.MaxRegionCoordinates = FInt3(NumRegionsXY - 1,NumRegionsXY - 1,0);
+	GridParameters.Headless = Headless;
+
+	UBrickGridComponent* Grid = NewObject<UBrickGridComponent>(Owner ? (UObject*)Owner : GetTransientPackage());
+	Grid->AddToRoot();
+	if(Owner)
+	{
+		Owner->SetRootComponent(Grid);
+		Grid->RegisterComponent();
+	}
+	Grid->Init(GridParameters);
+
+	// Create the regions filled with empty bricks, then generate their terrain.
+	FBrickGridData GridData;
+	for(int32 RegionY = 0;RegionY < NumRegionsXY;++RegionY)
+	{
+		for(int32 RegionX = 0;RegionX < NumRegionsXY;++RegionX)
+		{
+			FBrickRegion& Region = *new(GridData.Regions) FBrickRegion;
+			Region.Coordinates = FInt3(RegionX,RegionY,0);
+			Region.BrickContents.Init(GridParameters.EmptyMaterialIndex,Grid->BricksPerRegion.X * Grid->BricksPerRegion.Y * Grid->BricksPerRegion.Z);
+		}
+	}
+	Grid->SetData(GridData);
+
+	const FBrickTerrainGenerationParameters TerrainParameters = CreateBenchmarkTerrainParameters();
+	for(const FBrickRegion& Region : GridData.Regions)
+	{
+		UBrickTerrainGenerationLibrary::InitRegion(TerrainParameters,Grid,Region.Coordinates);
+	}
+
+	// Light the generated terrain all at once, rather than relighting each region as its terrain is generated.
+	if(EnableLightPropagation)
+	{
+		const FBrickGridData LitGridData = Grid->GetData();
+		Grid->Parameters.EnableLightPropagation = true;
+		Grid->SetData(LitGridData);
+	}
+	return Grid;
+}
+
+// Returns the class of each of the benchmark materials.
+static TArray<EBrickClass> GetBenchmarkBrickClasses()
+{
+	TArray<EBrickClass> Result;
+	Result.Init(EBrickClass::Opaque,BenchmarkMaterials::Count);
+	Result[BenchmarkMaterials::Empty] = EBrickClass::Empty;
+	Result[BenchmarkMaterials::Water] = EBrickClass::Translucent;
+	return Result;
+}
+
+// A set of chunks to mesh, each with its bricks plus a border of one brick on each side.
+struct FMesherBenchmarkCase
+{
+	FString Name;
+	BrickMesher::FSize3 BricksDim;
+	TArray<TArray<uint8>> ChunkLocalBrickMaterials;
+};
+
+// Creates a synthetic chunk by evaluating a function for the material of each brick, including the border.
+template<typename MaterialFunctionType>
+static void AddSyntheticChunk(FMesherBenchmarkCase& Case,MaterialFunctionType MaterialFunction)
+{
+	const BrickMesher::FSize3 LocalBricksDim = Case.BricksDim + BrickMesher::FSize3::Scalar(2);
+	TArray<uint8>& LocalBrickMaterials = Case.ChunkLocalBrickMaterials[Case.ChunkLocalBrickMaterials.AddDefaulted()];
+	LocalBrickMaterials.SetNumUninitialized(LocalBricksDim.Volume());
+	for(int32 LocalBrickY = 0;LocalBrickY < LocalBricksDim.Y;++LocalBrickY)
+	{
+		for(int32 LocalBrickX = 0;LocalBrickX < LocalBricksDim.X;++LocalBrickX)
+		{
+			for(int32 LocalBrickZ = 0;LocalBrickZ < LocalBricksDim.Z;++LocalBrickZ)
+			{
+				LocalBrickMaterials[LocalBricksDim.Index(LocalBrickX,LocalBrickY,LocalBrickZ)] = MaterialFunction(LocalBrickX,LocalBrickY,LocalBrickZ);
+			}
+		}
+	}
+}
+
+// Meshes each chunk of a benchmark case repeatedly, and logs the throughput.
+static void RunMesherBenchmarkCase(const FMesherBenchmarkCase& Case,const TArray<EBrickClass>& BrickClassByMaterial,int32 Iterations)
+{
+	BrickMesher::FChunkMesher Mesher;
+	BrickMesher::FChunkOutput Output;
+	BrickMesher::FChunkInput Input;
+	Input.BricksDim = Case.BricksDim;
+	Input.BrickClassByMaterial = BrickClassByMaterial.GetData();
+	Input.NumMaterials = BrickClassByMaterial.Num();
+	Input.EmptyMaterialIndex = BenchmarkMaterials::Empty;
+
+	uint64 NumFaces = 0;
+	uint64 NumVertices = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		for(const TArray<uint8>& LocalBrickMaterials : Case.ChunkLocalBrickMaterials)
+		{
+			Input.LocalBrickMaterials = LocalBrickMaterials.GetData();
+			Mesher.Mesh(Input,Output);
+			NumFaces += Output.GetNumFaces();
+			NumVertices += Output.Vertices.size();
+		}
+	}
+	const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime,1.0e-9);
+
+	const uint64 NumChunks = (uint64)Iterations * Case.ChunkLocalBrickMaterials.Num();
+	const uint64 NumBricks = NumChunks * Case.BricksDim.Volume();
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Mesher %-16s %6llu chunks %8.3fms/chunk %10.2f Mbricks/s %9.2f Mfaces/s %8.1f faces/chunk %8.1f vertices/chunk"),
+		*Case.Name,
+		NumChunks,
+		1000.0 * Seconds / NumChunks,
+		NumBricks / Seconds / 1.0e6,
+		NumFaces / Seconds / 1.0e6,
+		double(NumFaces) / NumChunks,
+		double(NumVertices) / NumChunks
+		);
+}
+
+// Benchmarks the mesher on synthetic chunks and chunks of generated terrain, and the collision box merger and ambient occlusion filter on the generated terrain.
+static void RunMesherBenchmark(int32 Iterations)
+{
+	const TArray<EBrickClass> BrickClassByMaterial = GetBenchmarkBrickClasses();
+	const BrickMesher::FSize3 SyntheticBricksDim = BrickMesher::FSize3::Scalar(32);
+	const int32 NumSyntheticChunks = 16;
+	// Reserve space for all the cases up front, so references to them stay valid while they're being added.
+	TArray<FMesherBenchmarkCase> Cases;
+	Cases.Reserve(7);
+
+	FRandomStream RandomStream(0);
+	FMesherBenchmarkCase& EmptyCase = Cases[Cases.AddDefaulted()];
+	EmptyCase.Name = TEXT("Empty");
+	EmptyCase.BricksDim = SyntheticBricksDim;
+	AddSyntheticChunk(EmptyCase,[](int32,int32,int32) { return (uint8)BenchmarkMaterials::Empty; });
+
+	FMesherBenchmarkCase& SolidCase = Cases[Cases.AddDefaulted()];
+	SolidCase.Name = TEXT("Solid");
+	SolidCase.BricksDim = SyntheticBricksDim;
+	AddSyntheticChunk(SolidCase,[](int32,int32,int32) { return (uint8)BenchmarkMaterials::UnerodedRock; });
+
+	// The worst case for the mesher: every brick face is visible.
+	FMesherBenchmarkCase& CheckerboardCase = Cases[Cases.AddDefaulted()];
+	CheckerboardCase.Name = TEXT("Checkerboard");
+	CheckerboardCase.BricksDim = SyntheticBricksDim;
+	AddSyntheticChunk(CheckerboardCase,[](int32 X,int32 Y,int32 Z) { return (uint8)(((X + Y + Z) & 1) ? BenchmarkMaterials::Dirt : BenchmarkMaterials::Empty); });
+
+	FMesherBenchmarkCase& RandomCase = Cases[Cases.AddDefaulted()];
+	RandomCase.Name = TEXT("Random");
+	RandomCase.BricksDim = SyntheticBricksDim;
+	FMesherBenchmarkCase& TranslucentCase = Cases[Cases.AddDefaulted()];
+	TranslucentCase.Name = TEXT("RandomWater");
+	TranslucentCase.BricksDim = SyntheticBricksDim;
+	FMesherBenchmarkCase& HeightfieldCase = Cases[Cases.AddDefaulted()];
+	HeightfieldCase.Name = TEXT("Heightfield");
+	HeightfieldCase.BricksDim = SyntheticBricksDim;
+	for(int32 ChunkIndex = 0;ChunkIndex < NumSyntheticChunks;++ChunkIndex)
+	{
+		AddSyntheticChunk(RandomCase,[&](int32,int32,int32) { return (uint8)(RandomStream.FRand() < 0.5f ? BenchmarkMaterials::ErodedRock : BenchmarkMaterials::Empty); });
+		AddSyntheticChunk(TranslucentCase,[&](int32,int32,int32)
+		{
+			const float Value = RandomStream.FRand();
+			return (uint8)(Value < 0.33f ? BenchmarkMaterials::Sandstone : Value < 0.67f ? BenchmarkMaterials::Water : BenchmarkMaterials::Empty);
+		});
+		const float PhaseX = RandomStream.FRand() * 2.0f * PI;
+		const float PhaseY = RandomStream.FRand() * 2.0f * PI;
+		AddSyntheticChunk(HeightfieldCase,[&](int32 X,int32 Y,int32 Z)
+		{
+			const float Height = SyntheticBricksDim.Z * (0.5f + 0.25f * FMath::Sin(X * 0.3f + PhaseX) * FMath::Cos(Y * 0.2f + PhaseY));
+			return (uint8)(Z < Height ? (Z + 1 < Height ? BenchmarkMaterials::Dirt : BenchmarkMaterials::Grass) : BenchmarkMaterials::Empty);
+		});
+	}
+
+	// Read the bricks of each render chunk from a grid of generated terrain.
+	const double TerrainStartTime = FPlatformTime::Seconds();
+	UBrickGridComponent* Grid = CreateBenchmarkGrid(2,false);
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Generated the benchmark terrain in %fms"),1000.0f * float(FPlatformTime::Seconds() - TerrainStartTime));
+
+	FMesherBenchmarkCase& TerrainCase = Cases[Cases.AddDefaulted()];
+	TerrainCase.Name = TEXT("Terrain");
+	TerrainCase.BricksDim = BrickMesher::FSize3(Grid->BricksPerRenderChunk.X,Grid->BricksPerRenderChunk.Y,Grid->BricksPerRenderChunk.Z);
+	const FInt3 MinRenderChunkCoordinates = Grid->BrickToRenderChunkCoordinates(Grid->MinBrickCoordinates);
+	const FInt3 MaxRenderChunkCoordinates = Grid->BrickToRenderChunkCoordinates(Grid->MaxBrickCoordinates);
+	TArray<FInt3> TerrainChunkCoordinates;
+	for(int32 ChunkY = MinRenderChunkCoordinates.Y;ChunkY <= MaxRenderChunkCoordinates.Y;++ChunkY)
+	{
+		for(int32 ChunkX = MinRenderChunkCoordinates.X;ChunkX <= MaxRenderChunkCoordinates.X;++ChunkX)
+		{
+			for(int32 ChunkZ = MinRenderChunkCoordinates.Z;ChunkZ <= MaxRenderChunkCoordinates.Z;++ChunkZ)
+			{
+				const FInt3 MinChunkBrickCoordinates = FInt3(ChunkX,ChunkY,ChunkZ) * Grid->BricksPerRenderChunk;
+				TArray<uint8>& LocalBrickMaterials = TerrainCase.ChunkLocalBrickMaterials[TerrainCase.ChunkLocalBrickMaterials.AddDefaulted()];
+				LocalBrickMaterials.SetNumUninitialized((TerrainCase.BricksDim + BrickMesher::FSize3::Scalar(2)).Volume());
+				Grid->GetBrickMaterialArray(MinChunkBrickCoordinates - FInt3::Scalar(1),MinChunkBrickCoordinates + Grid->BricksPerRenderChunk,LocalBrickMaterials);
+				TerrainChunkCoordinates.Add(FInt3(ChunkX,ChunkY,ChunkZ));
+			}
+		}
+	}
+
+	for(const FMesherBenchmarkCase& Case : Cases)
+	{
+		RunMesherBenchmarkCase(Case,BrickClassByMaterial,Iterations);
+	}
+
+	// Time merging the collision boxes of the terrain chunks, and compare the number of boxes to the one box per surface brick it replaced.
+	BrickMesher::FCollisionBoxMerger BoxMerger;
+	std::vector<BrickMesher::FBrickBox> Boxes;
+	uint64 NumSurfaceBricks = 0;
+	uint64 NumBoxes = 0;
+	const double CollisionStartTime = FPlatformTime::Seconds();
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		for(const TArray<uint8>& LocalBrickMaterials : TerrainCase.ChunkLocalBrickMaterials)
+		{
+			NumSurfaceBricks += BoxMerger.Merge(LocalBrickMaterials.GetData(),TerrainCase.BricksDim,BenchmarkMaterials::Empty,Boxes);
+			NumBoxes += Boxes.size();
+		}
+	}
+	const double CollisionSeconds = FMath::Max(FPlatformTime::Seconds() - CollisionStartTime,1.0e-9);
+	const uint64 NumCollisionChunks = (uint64)Iterations * TerrainCase.ChunkLocalBrickMaterials.Num();
+	UE_LOG(LogBrickBenchmark,Display,TEXT("CollisionBoxes %-6s %6llu chunks %8.3fms/chunk %8.1f surface bricks/chunk %8.1f boxes/chunk %6.1fx fewer boxes"),
+		TEXT("Terrain"),
+		NumCollisionChunks,
+		1000.0 * CollisionSeconds / NumCollisionChunks,
+		double(NumSurfaceBricks) / NumCollisionChunks,
+		double(NumBoxes) / NumCollisionChunks,
+		double(NumSurfaceBricks) / FMath::Max<uint64>(NumBoxes,1)
+		);
+
+	// Read the height maps needed to compute the ambient occlusion of each terrain chunk, and time the ambient occlusion filter.
+	const uint32 BlurRadius = Grid->Parameters.AmbientOcclusionBlurRadius;
+	const FInt3 LocalBrickExpansion(BlurRadius + 1,BlurRadius + 1,1);
+	const FInt3 LocalBricksDim = Grid->BricksPerRenderChunk + LocalBrickExpansion * FInt3::Scalar(2);
+	const FInt3 LocalVertexDim = Grid->BricksPerRenderChunk + FInt3::Scalar(1);
+	TArray<TArray<int16>> ChunkHeightMaps;
+	for(const FInt3& ChunkCoordinates : TerrainChunkCoordinates)
+	{
+		const FInt3 MinLocalBrickCoordinates = ChunkCoordinates * Grid->BricksPerRenderChunk - LocalBrickExpansion;
+		TArray<int16>& HeightMap = ChunkHeightMaps[ChunkHeightMaps.AddDefaulted()];
+		HeightMap.SetNumUninitialized(LocalBricksDim.X * LocalBricksDim.Y);
+		Grid->GetMaxNonEmptyBrickZ(MinLocalBrickCoordinates,MinLocalBrickCoordinates + LocalBricksDim - FInt3::Scalar(1),HeightMap);
+	}
+	TArray<uint8> LocalVertexAmbientFactors;
+	LocalVertexAmbientFactors.SetNumUninitialized(LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z);
+	const double AmbientOcclusionStartTime = FPlatformTime::Seconds();
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		for(const TArray<int16>& HeightMap : ChunkHeightMaps)
+		{
+			BrickMesher::ComputeAmbientOcclusion(
+				HeightMap.GetData(),
+				BrickMesher::FSize3(LocalBricksDim.X,LocalBricksDim.Y,LocalBricksDim.Z),
+				BlurRadius,
+				BrickMesher::FSize3(LocalVertexDim.X,LocalVertexDim.Y,LocalVertexDim.Z),
+				LocalVertexAmbientFactors.GetData()
+				);
+		}
+	}
+	const double AmbientOcclusionSeconds = FMath::Max(FPlatformTime::Seconds() - AmbientOcclusionStartTime,1.0e-9);
+	const uint64 NumAmbientOcclusionChunks = (uint64)Iterations * ChunkHeightMaps.Num();
+	UE_LOG(LogBrickBenchmark,Display,TEXT("AmbientOcclusion %-6s %6llu chunks %8.3fms/chunk %10.2f Mvertices/s"),
+		TEXT("Terrain"),
+		NumAmbientOcclusionChunks,
+		1000.0 * AmbientOcclusionSeconds / NumAmbientOcclusionChunks,
+		NumAmbientOcclusionChunks * LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z / AmbientOcclusionSeconds / 1.0e6
+		);
+
+	// Time sampling the grid's persistent blurred sky visibility instead, which is what render chunks do when all their adjacent regions exist.
+	const FInt3 AdjacentBricksDim = LocalVertexDim + FInt3::Scalar(1);
+	TArray<uint8> BlurredSkyVisibility;
+	BlurredSkyVisibility.SetNumUninitialized(AdjacentBricksDim.X * AdjacentBricksDim.Y * AdjacentBricksDim.Z);
+	const double SampledStartTime = FPlatformTime::Seconds();
+	uint64 NumSampledChunks = 0;
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		for(const FInt3& ChunkCoordinates : TerrainChunkCoordinates)
+		{
+			const FInt3 MinChunkBrickCoordinates = ChunkCoordinates * Grid->BricksPerRenderChunk;
+			if(Grid->GetBlurredSkyVisibility(MinChunkBrickCoordinates - FInt3::Scalar(1),MinChunkBrickCoordinates + Grid->BricksPerRenderChunk,BlurredSkyVisibility))
+			{
+				BrickMesher::ComputeVertexAmbientOcclusion(
+					BlurredSkyVisibility.GetData(),
+					BrickMesher::FSize3(LocalVertexDim.X,LocalVertexDim.Y,LocalVertexDim.Z),
+					LocalVertexAmbientFactors.GetData()
+					);
+				++NumSampledChunks;
+			}
+		}
+	}
+	const double SampledSeconds = FMath::Max(FPlatformTime::Seconds() - SampledStartTime,1.0e-9);
+	UE_LOG(LogBrickBenchmark,Display,TEXT("AmbientOcclusion %-6s %6llu chunks %8.3fms/chunk %10.2f Mvertices/s"),
+		TEXT("Sampled"),
+		NumSampledChunks,
+		1000.0 * SampledSeconds / FMath::Max<uint64>(NumSampledChunks,1),
+		NumSampledChunks * LocalVertexDim.X * LocalVertexDim.Y * LocalVertexDim.Z / SampledSeconds / 1.0e6
+		);
+
+	Grid->RemoveFromRoot();
+}
+
+// Places and removes a lamp brick on top of random columns of a grid, and logs the average and worst time taken by each edit.
+static void RunBrickEditBenchmark(UBrickGridComponent* Grid,const TCHAR* Name,int32 Iterations)
+{
+	FRandomStream RandomStream(0);
+	const int32 NumEditSites = 100 * Iterations;
+	int32 NumEdits = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+	for(int32 EditSiteIndex = 0;EditSiteIndex < NumEditSites;++EditSiteIndex)
+	{
+		const FInt3 ColumnBrickCoordinates(
+			RandomStream.RandRange(Grid->MinBrickCoordinates.X,Grid->MaxBrickCoordinates.X),
+			RandomStream.RandRange(Grid->MinBrickCoordinates.Y,Grid->MaxBrickCoordinates.Y),
+			Grid->MinBrickCoordinates.Z
+			);
+		TArray<int16> ColumnHeight;
+		ColumnHeight.SetNumUninitialized(1);
+		Grid->GetMaxNonEmptyBrickZ(ColumnBrickCoordinates,ColumnBrickCoordinates,ColumnHeight);
+		const FInt3 BrickCoordinates(ColumnBrickCoordinates.X,ColumnBrickCoordinates.Y,Grid->MinBrickCoordinates.Z + ColumnHeight[0] + 1);
+		if(BrickCoordinates.Z > Grid->MaxBrickCoordinates.Z)
+		{
+			continue;
+		}
+
+		const int32 EditMaterials[2] = { BenchmarkMaterials::Lamp,BenchmarkMaterials::Empty };
+		for(int32 EditMaterial : EditMaterials)
+		{
+			const double EditStartTime = FPlatformTime::Seconds();
+			Grid->SetBrick(BrickCoordinates,EditMaterial);
+			const double EditSeconds = FPlatformTime::Seconds() - EditStartTime;
+			TotalSeconds += EditSeconds;
+			MaxSeconds = FMath::Max(MaxSeconds,EditSeconds);
+			++NumEdits;
+		}
+	}
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Lighting Edit%-6s %6d edits %8.3fms/edit %8.3fms max"),
+		Name,
+		NumEdits,
+		1000.0 * TotalSeconds / FMath::Max(NumEdits,1),
+		1000.0 * MaxSeconds
+		);
+}
+
+// Benchmarks relighting whole regions of generated terrain, and the latency of editing a brick with and without light propagation.
+static void RunLightingBenchmark(int32 Iterations)
+{
+	const double TerrainStartTime = FPlatformTime::Seconds();
+	UBrickGridComponent* LitGrid = CreateBenchmarkGrid(2,true);
+	UBrickGridComponent* UnlitGrid = CreateBenchmarkGrid(2,false);
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Generated the benchmark terrain in %fms"),1000.0f * float(FPlatformTime::Seconds() - TerrainStartTime));
+
+	const FInt3 MinRegionCoordinates = LitGrid->Parameters.MinRegionCoordinates;
+	const FInt3 MaxRegionCoordinates = LitGrid->Parameters.MaxRegionCoordinates;
+	TArray<FInt3> RegionCoordinates;
+	for(int32 RegionY = MinRegionCoordinates.Y;RegionY <= MaxRegionCoordinates.Y;++RegionY)
+	{
+		for(int32 RegionX = MinRegionCoordinates.X;RegionX <= MaxRegionCoordinates.X;++RegionX)
+		{
+			for(int32 RegionZ = MinRegionCoordinates.Z;RegionZ <= MaxRegionCoordinates.Z;++RegionZ)
+			{
+				RegionCoordinates.Add(FInt3(RegionX,RegionY,RegionZ));
+			}
+		}
+	}
+
+	// Time relighting all the regions from scratch, which computes the regions in parallel.
+	const double RelightStartTime = FPlatformTime::Seconds();
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		LitGrid->RelightRegions(RegionCoordinates);
+	}
+	const double RelightSeconds = FMath::Max(FPlatformTime::Seconds() - RelightStartTime,1.0e-9);
+	const uint64 NumRelitRegions = (uint64)Iterations * RegionCoordinates.Num();
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Lighting Relight %6llu regions %8.3fms/region %10.2f Mbricks/s"),
+		NumRelitRegions,
+		1000.0 * RelightSeconds / NumRelitRegions,
+		NumRelitRegions * LitGrid->BricksPerRegion.X * LitGrid->BricksPerRegion.Y * LitGrid->BricksPerRegion.Z / RelightSeconds / 1.0e6
+		);
+
+	RunBrickEditBenchmark(LitGrid,TEXT("Lit"),Iterations);
+	RunBrickEditBenchmark(UnlitGrid,TEXT("Unlit"),Iterations);
+
+	LitGrid->RemoveFromRoot();
+	UnlitGrid->RemoveFromRoot();
+}
+
+// Returns the Z of the first empty brick above the highest non-empty brick in a column.
+static int32 GetSurfaceBrickZ(const UBrickGridComponent* Grid,int32 BrickX,int32 BrickY)
+{
+	const FInt3 ColumnBrickCoordinates(BrickX,BrickY,Grid->MinBrickCoordinates.Z);
+	TArray<int16> ColumnHeight;
+	ColumnHeight.SetNumUninitialized(1);
+	Grid->GetMaxNonEmptyBrickZ(ColumnBrickCoordinates,ColumnBrickCoordinates,ColumnHeight);
+	return Grid->MinBrickCoordinates.Z + ColumnHeight[0] + 1;
+}
+
+// Simulates players walking around and digging on a headless grid, as on a dedicated server, and logs the grid's game thread tick cost per player.
+static void RunServerBenchmark(int32 Iterations)
+{
+	// Collision chunks are components, so they need a world with a physics scene to be registered in.
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game,false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+
+	// The grid isn't scaled, so distances are in bricks.
+	const int32 NumRegionsXY = 4;
+	const float MaxCollisionDistance = 64.0f;
+	const float WalkDistancePerTick = 0.5f;
+	const float MaxDesiredUpdateTime = 0.005f;
+	const int32 TicksPerDig = 10;
+	const int32 NumTicks = 30 * Iterations;
+	const int32 PlayerCounts[] = { 1,2,4,8,16 };
+	for(int32 NumPlayers : PlayerCounts)
+	{
+		AActor* GridActor = World->SpawnActor<AActor>();
+		UBrickGridComponent* Grid = CreateBenchmarkGrid(NumRegionsXY,false,true,GridActor);
+
+		// Place the players on the terrain at random positions, walking in random directions.
+		struct FPlayer
+		{
+			int32 ViewerId;
+			FVector Position;
+			FVector Direction;
+		};
+		FRandomStream RandomStream(0);
+		const FVector MinPosition = (Grid->MinBrickCoordinates + FInt3::Scalar(1)).ToFloat();
+		const FVector MaxPosition = (Grid->MaxBrickCoordinates - FInt3::Scalar(1)).ToFloat();
+		TArray<FPlayer> Players;
+		for(int32 PlayerIndex = 0;PlayerIndex < NumPlayers;++PlayerIndex)
+		{
+			FPlayer Player;
+			Player.Position = FVector(RandomStream.FRandRange(MinPosition.X,MaxPosition.X),RandomStream.FRandRange(MinPosition.Y,MaxPosition.Y),0.0f);
+			Player.Position.Z = GetSurfaceBrickZ(Grid,FMath::FloorToInt(Player.Position.X),FMath::FloorToInt(Player.Position.Y)) + 1.0f;
+			const float Angle = RandomStream.FRand() * 2.0f * PI;
+			Player.Direction = FVector(FMath::Cos(Angle),FMath::Sin(Angle),0.0f);
+			Player.ViewerId = Grid->RegisterViewer(Player.Position,0.0f,MaxCollisionDistance);
+			Players.Add(Player);
+		}
+
+		// The players are all registered viewers, so the view position passed to Update doesn't need any regions or chunks.
+		// All the regions already exist, so Update never needs to call the InitRegion delegate.
+		const FBrickGrid_InitRegion InitRegion;
+		Grid->Update(Players[0].Position,0.0f,0.0f,MaxDesiredUpdateTime,InitRegion);
+
+		double TotalSeconds = 0.0;
+		double MaxSeconds = 0.0;
+		for(int32 TickIndex = 0;TickIndex < NumTicks;++TickIndex)
+		{
+			const double TickStartTime = FPlatformTime::Seconds();
+			for(FPlayer& Player : Players)
+			{
+				// Walk along the terrain surface, turning around at the edges of the grid.
+				FVector NewPosition = Player.Position + Player.Direction * WalkDistancePerTick;
+				if(NewPosition.X < MinPosition.X || NewPosition.X > MaxPosition.X || NewPosition.Y < MinPosition.Y || NewPosition.Y > MaxPosition.Y)
+				{
+					Player.Direction = -Player.Direction;
+					NewPosition = Player.Position;
+				}
+				const int32 BrickX = FMath::FloorToInt(NewPosition.X);
+				const int32 BrickY = FMath::FloorToInt(NewPosition.Y);
+				const int32 SurfaceBrickZ = GetSurfaceBrickZ(Grid,BrickX,BrickY);
+				NewPosition.Z = SurfaceBrickZ + 1.0f;
+				Player.Position = NewPosition;
+				Grid->UpdateViewer(Player.ViewerId,Player.Position);
+
+				// Periodically dig out the brick under the player.
+				if((TickIndex % TicksPerDig) == 0 && SurfaceBrickZ > Grid->MinBrickCoordinates.Z + 1)
+				{
+					Grid->SetBrick(FInt3(BrickX,BrickY,SurfaceBrickZ - 1),BenchmarkMaterials::Empty);
+				}
+			}
+			Grid->Update(Players[0].Position,0.0f,0.0f,MaxDesiredUpdateTime,InitRegion);
+			const double TickSeconds = FPlatformTime::Seconds() - TickStartTime;
+			TotalSeconds += TickSeconds;
+			MaxSeconds = FMath::Max(MaxSeconds,TickSeconds);
+		}
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Server %2d players %6d ticks %8.3fms/tick %8.3fms/tick/player %8.3fms max"),
+			NumPlayers,
+			NumTicks,
+			1000.0 * TotalSeconds / NumTicks,
+			1000.0 * TotalSeconds / NumTicks / NumPlayers,
+			1000.0 * MaxSeconds
+			);
+
+		Grid->RemoveFromRoot();
+		GridActor->Destroy();
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+}
+
+// Compares sampling simplex noise a point at a time with sampling it in batches, and checks that the batched samples are bit-identical.
+static void RunNoiseBenchmark(int32 Iterations)
+{
+	ISimplexNoise& SimplexNoiseModule = ISimplexNoise::Get();
+
+	// Sample points spread over a few thousand noise periods, with negative coordinates to exercise the rounding toward negative infinity.
+	const int32 NumSamples = 65536;
+	FRandomStream RandomStream(0);
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+	for(int32 SampleIndex = 0;SampleIndex < NumSamples;++SampleIndex)
+	{
+		X.Add(RandomStream.FRandRange(-1000.0f,1000.0f));
+		Y.Add(RandomStream.FRandRange(-1000.0f,1000.0f));
+		Z.Add(RandomStream.FRandRange(-1000.0f,1000.0f));
+	}
+	TArray<float> ScalarValues;
+	TArray<float> BatchValues;
+	ScalarValues.SetNumUninitialized(NumSamples);
+	BatchValues.SetNumUninitialized(NumSamples);
+
+	for(int32 NumDimensions = 2;NumDimensions <= 3;++NumDimensions)
+	{
+		const double ScalarStartTime = FPlatformTime::Seconds();
+		for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+		{
+			for(int32 SampleIndex = 0;SampleIndex < NumSamples;++SampleIndex)
+			{
+				ScalarValues[SampleIndex] = NumDimensions == 2
+					? SimplexNoiseModule.Sample2D(X[SampleIndex],Y[SampleIndex])
+					: SimplexNoiseModule.Sample3D(X[SampleIndex],Y[SampleIndex],Z[SampleIndex]);
+			}
+		}
+		const double ScalarSeconds = FMath::Max(FPlatformTime::Seconds() - ScalarStartTime,1.0e-9);
+
+		const double BatchStartTime = FPlatformTime::Seconds();
+		for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+		{
+			if(NumDimensions == 2)
+			{
+				SimplexNoiseModule.Sample2DBatch(X.GetData(),Y.GetData(),BatchValues.GetData(),NumSamples);
+			}
+			else
+			{
+				SimplexNoiseModule.Sample3DBatch(X.GetData(),Y.GetData(),Z.GetData(),BatchValues.GetData(),NumSamples);
+			}
+		}
+		const double BatchSeconds = FMath::Max(FPlatformTime::Seconds() - BatchStartTime,1.0e-9);
+
+		int32 NumMismatches = 0;
+		for(int32 SampleIndex = 0;SampleIndex < NumSamples;++SampleIndex)
+		{
+			NumMismatches += FMemory::Memcmp(&ScalarValues[SampleIndex],&BatchValues[SampleIndex],sizeof(float)) != 0;
+		}
+
+		const uint64 NumTotalSamples = (uint64)Iterations * NumSamples;
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Noise %dD %10llu samples scalar %8.2f Msamples/s batch %8.2f Msamples/s %5.2fx %d mismatches"),
+			NumDimensions,
+			NumTotalSamples,
+			NumTotalSamples / ScalarSeconds / 1.0e6,
+			NumTotalSamples / BatchSeconds / 1.0e6,
+			ScalarSeconds / BatchSeconds,
+			NumMismatches
+			);
+		if(NumMismatches)
+		{
+			UE_LOG(LogBrickBenchmark,Error,TEXT("The batched %dD noise doesn't match the scalar noise"),NumDimensions);
+		}
+	}
+}
+
+// Times generating the terrain for a region with the benchmark's terrain parameters.
+// Times generating a grid of regions one at a time and all at once, limited to each power of two threads up to the number of worker threads,
+// and then with all the threads while varying how many tiles of columns each thread claims at once.
+static void RunTerrainScalingBenchmark(int32 Iterations)
+{
+	const int32 NumRegionsXY = 4;
+	UBrickGridComponent* Grid = CreateBenchmarkGrid(NumRegionsXY,false);
+	const FBrickTerrainGenerationParameters TerrainParameters = CreateBenchmarkTerrainParameters();
+	TArray<FInt3> RegionCoordinates;
+	for(int32 RegionY = 0;RegionY < NumRegionsXY;++RegionY)
+	{
+		for(int32 RegionX = 0;RegionX < NumRegionsXY;++RegionX)
+		{
+			RegionCoordinates.Add(FInt3(RegionX,RegionY,0));
+		}
+	}
+
+	IConsoleVariable* MaxThreadsVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("BrickTerrain.MaxThreads"));
+	IConsoleVariable* TilesPerTaskVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("BrickTerrain.TilesPerTask"));
+	const int32 DefaultMaxThreads = MaxThreadsVariable->GetInt();
+	const int32 DefaultTilesPerTask = TilesPerTaskVariable->GetInt();
+
+	// Returns the seconds it takes to generate all the regions, either one at a time or all at once.
+	auto TimeRegions = [&](bool Concurrent) -> double
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+		{
+			if(Concurrent)
+			{
+				UBrickTerrainGenerationLibrary::InitRegions(TerrainParameters,Grid,RegionCoordinates);
+			}
+			else
+			{
+				for(const FInt3& Coordinates : RegionCoordinates)
+				{
+					UBrickTerrainGenerationLibrary::InitRegion(TerrainParameters,Grid,Coordinates);
+				}
+			}
+		}
+		return FMath::Max(FPlatformTime::Seconds() - StartTime,1.0e-9);
+	};
+	const int32 NumRegions = Iterations * RegionCoordinates.Num();
+
+	const int32 MaxThreads = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	double SingleThreadSeconds = 0.0;
+	for(int32 NumThreads = 1;NumThreads < MaxThreads * 2;NumThreads *= 2)
+	{
+		MaxThreadsVariable->Set(FMath::Min(NumThreads,MaxThreads));
+		const double SequentialSeconds = TimeRegions(false);
+		const double ConcurrentSeconds = TimeRegions(true);
+		SingleThreadSeconds = NumThreads == 1 ? SequentialSeconds : SingleThreadSeconds;
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain Threads %2d %6d regions %8.3fms/region one at a time %5.2fx %8.3fms/region at once %5.2fx"),
+			FMath::Min(NumThreads,MaxThreads),
+			NumRegions,
+			1000.0 * SequentialSeconds / NumRegions,
+			SingleThreadSeconds / SequentialSeconds,
+			1000.0 * ConcurrentSeconds / NumRegions,
+			SingleThreadSeconds / ConcurrentSeconds
+			);
+	}
+	MaxThreadsVariable->Set(DefaultMaxThreads);
+
+	const int32 TilesPerTaskCounts[] = { 1,4,16,64 };
+	for(int32 TilesPerTask : TilesPerTaskCounts)
+	{
+		TilesPerTaskVariable->Set(TilesPerTask);
+		const double SequentialSeconds = TimeRegions(false);
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain TilesPerTask %2d %6d regions %8.3fms/region"),
+			TilesPerTask,
+			NumRegions,
+			1000.0 * SequentialSeconds / NumRegions
+			);
+	}
+	TilesPerTaskVariable->Set(DefaultTilesPerTask);
+
+	Grid->RemoveFromRoot();
+}
+
+static void RunTerrainBenchmark(int32 Iterations)
+{
+	// Creating the grid generates its region once, which also warms up the task graph's worker threads.
+	UBrickGridComponent* Grid = CreateBenchmarkGrid(1,false);
+	const FBrickTerrainGenerationParameters TerrainParameters = CreateBenchmarkTerrainParameters();
+	const FInt3 RegionCoordinates(0,0,0);
+
+	double TotalSeconds = 0.0;
+	double MinSeconds = DBL_MAX;
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		UBrickTerrainGenerationLibrary::InitRegion(TerrainParameters,Grid,RegionCoordinates);
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		TotalSeconds += Seconds;
+		MinSeconds = FMath::Min(MinSeconds,Seconds);
+	}
+	TotalSeconds = FMath::Max(TotalSeconds,1.0e-9);
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain InitRegion %6d regions %8.3fms/region %8.3fms min %10.2f Mbricks/s"),
+		Iterations,
+		1000.0 * TotalSeconds / Iterations,
+		1000.0 * MinSeconds,
+		(double)Iterations * Grid->BricksPerRegion.X * Grid->BricksPerRegion.Y * Grid->BricksPerRegion.Z / TotalSeconds / 1.0e6
+		);
+
+	// Compare generating the region with sparse noise sampling to sampling the noise for every column.
+	const TArray<uint8> ReferenceBricks = Grid->GetData().Regions[0].BrickContents;
+	const int32 SampleSpacings[] = { 2,4,8 };
+	for(int32 SampleSpacing : SampleSpacings)
+	{
+		FBrickTerrainGenerationParameters SparseTerrainParameters = TerrainParameters;
+		SparseTerrainParameters.SampleSpacingXY = SampleSpacing;
+		const double SparseStartTime = FPlatformTime::Seconds();
+		for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+		{
+			UBrickTerrainGenerationLibrary::InitRegion(SparseTerrainParameters,Grid,RegionCoordinates);
+		}
+		const double SparseSeconds = FMath::Max(FPlatformTime::Seconds() - SparseStartTime,1.0e-9);
+
+		// Count the bricks that differ from full sampling, and the error in the height of the top of each column.
+		const TArray<uint8> SparseBricks = Grid->GetData().Regions[0].BrickContents;
+		const FInt3 BricksPerRegion = Grid->BricksPerRegion;
+		int64 NumDifferentBricks = 0;
+		int64 TotalHeightError = 0;
+		int32 MaxHeightError = 0;
+		for(int32 ColumnIndex = 0;ColumnIndex < BricksPerRegion.X * BricksPerRegion.Y;++ColumnIndex)
+		{
+			int32 ReferenceHeight = -1;
+			int32 SparseHeight = -1;
+			for(int32 LocalZ = 0;LocalZ < BricksPerRegion.Z;++LocalZ)
+			{
+				const int32 BrickIndex = ColumnIndex * BricksPerRegion.Z + LocalZ;
+				NumDifferentBricks += ReferenceBricks[BrickIndex] != SparseBricks[BrickIndex];
+				ReferenceHeight = ReferenceBricks[BrickIndex] != BenchmarkMaterials::Empty ? LocalZ : ReferenceHeight;
+				SparseHeight = SparseBricks[BrickIndex] != BenchmarkMaterials::Empty ? LocalZ : SparseHeight;
+			}
+			TotalHeightError += FMath::Abs(SparseHeight - ReferenceHeight);
+			MaxHeightError = FMath::Max(MaxHeightError,FMath::Abs(SparseHeight - ReferenceHeight));
+		}
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain Sparse %d %6d regions %8.3fms/region %5.2fx faster %6.2f%% bricks differ %6.2f mean height error %3d max height error"),
+			SampleSpacing,
+			Iterations,
+			1000.0 * SparseSeconds / Iterations,
+			TotalSeconds / SparseSeconds,
+			100.0 * NumDifferentBricks / ReferenceBricks.Num(),
+			(double)TotalHeightError / (BricksPerRegion.X * BricksPerRegion.Y),
+			MaxHeightError
+			);
+	}
+
+	// Time generating a stack of regions along Z. The regions in the stack share the columns computed for the first of them,
+	// and the regions above the ground don't sample the cavern noise, so the stack should cost little more than its bottom region.
+	const int32 NumStackRegionsZ = 4;
+	FBrickGridParameters StackGridParameters = Grid->Parameters;
+	StackGridParameters.MaxRegionCoordinates.Z = StackGridParameters.MinRegionCoordinates.Z + NumStackRegionsZ - 1;
+	Grid->Init(StackGridParameters);
+
+	// Init clears the regions, so create the stack's regions before generating their terrain.
+	FBrickGridData StackGridData;
+	for(int32 RegionZ = StackGridParameters.MinRegionCoordinates.Z;RegionZ <= StackGridParameters.MaxRegionCoordinates.Z;++RegionZ)
+	{
+		FBrickRegion& Region = *new(StackGridData.Regions) FBrickRegion;
+		Region.Coordinates = FInt3(0,0,RegionZ);
+		Region.BrickContents.Init(StackGridParameters.EmptyMaterialIndex,Grid->BricksPerRegion.X * Grid->BricksPerRegion.Y * Grid->BricksPerRegion.Z);
+	}
+	Grid->SetData(StackGridData);
+	double RegionZSeconds[NumStackRegionsZ] = { 0.0 };
+	for(int32 Iteration = 0;Iteration < Iterations;++Iteration)
+	{
+		for(int32 RegionZ = StackGridParameters.MinRegionCoordinates.Z;RegionZ <= StackGridParameters.MaxRegionCoordinates.Z;++RegionZ)
+		{
+			const double RegionStartTime = FPlatformTime::Seconds();
+			UBrickTerrainGenerationLibrary::InitRegion(TerrainParameters,Grid,FInt3(0,0,RegionZ));
+			RegionZSeconds[RegionZ - StackGridParameters.MinRegionCoordinates.Z] += FPlatformTime::Seconds() - RegionStartTime;
+		}
+	}
+	double StackSeconds = 1.0e-9;
+	for(int32 StackRegionIndex = 0;StackRegionIndex < NumStackRegionsZ;++StackRegionIndex)
+	{
+		StackSeconds += RegionZSeconds[StackRegionIndex];
+	}
+	UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain Stack %d regions %6d stacks %8.3fms/stack %8.3fms/region"),
+		NumStackRegionsZ,
+		Iterations,
+		1000.0 * StackSeconds / Iterations,
+		1000.0 * StackSeconds / Iterations / NumStackRegionsZ
+		);
+
+	// Regions that are entirely air or rock are filled with a single material instead of generating their bricks, so they should be much cheaper.
+	for(int32 StackRegionIndex = 0;StackRegionIndex < NumStackRegionsZ;++StackRegionIndex)
+	{
+		UE_LOG(LogBrickBenchmark,Display,TEXT("Terrain Stack Z=%d %8.3fms/region"),
+			StackGridParameters.MinRegionCoordinates.Z + StackRegionIndex,
+			1000.0 * RegionZSeconds[StackRegionIndex] / Iterations
+			);
+	}
+
+	Grid->RemoveFromRoot();
+
+	RunTerrainScalingBenchmark(Iterations);
+}
+
+int32 UBrickBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString Mode = TEXT("Mesher");
+	FParse::Value(*Params,TEXT("Mode="),Mode);
+	int32 Iterations = 10;
+	FParse::Value(*Params,TEXT("Iterations="),Iterations);
+	Iterations = FMath::Max(1,Iterations);
+
+	if(Mode == TEXT("Mesher"))
+	{
+		RunMesherBenchmark(Iterations);
+	}
+	else if(Mode == TEXT("Lighting"))
+	{
+		RunLightingBenchmark(Iterations);
+	}
+	else if(Mode == TEXT("Server"))
+	{
+		RunServerBenchmark(Iterations);
+	}
+	else if(Mode == TEXT("Noise"))
+	{
+		RunNoiseBenchmark(Iterations);
+	}
+	else if(Mode == TEXT("Terrain"))
+	{
+		RunTerrainBenchmark(Iterations);
+	}
+	else
+	{
+		UE_LOG(LogBrickBenchmark,Error,TEXT("Unknown benchmark mode: %s"),*Mode);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,20 @@
+// Copyright 2014, Andrew Scheidecker. All Rights Reserved. 
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "BrickBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs headless benchmarks of the brick grid's algorithms, and logs their throughput.
+ * Usage: BrickGame -run=BrickBenchmark [-Mode=Mesher|Lighting|Server|Noise|Terrain] [-Iterations=N]
+ */
+UCLASS()
+class UBrickBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	// UCommandlet interface.
+	virtual int32 Main(const FString& Params) override;
+};
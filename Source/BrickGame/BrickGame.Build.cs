@@ -7,5 +7,6 @@ public class BrickGame : ModuleRules
 	public BrickGame(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "BrickGrid", "BrickTerrainGeneration", "SimplexNoise" });
 	}
 }